@@ -0,0 +1,41 @@
+#!/usr/bin/bash
+#
+# Compare the Hessian factorization kernels (config.factorizationMode) on the
+# testdata_jointcal cfht and hsc datasets, using the constrained models, which
+# couple chips across visits and give the densest Hessians.
+# Reports the time of each factorization and the peak memory of each run.
+# Requires the following be setup before being run:
+#     obs_cfht
+#     obs_subaru
+#     jointcal
+#     testdata_jointcal
+#
+# No timings are recorded here yet: run it on the target machine before
+# choosing a non-default setting, since the outcome depends on the data,
+# the BLAS and the cholmod build.
+
+OUTPUT="benchmark_factorization_output"
+CLOBBER="--clobber-versions --clobber-config"
+
+CFHT_ARGS="$TESTDATA_JOINTCAL_DIR/cfht --id visit=849375^850587 --configfile $JOINTCAL_DIR/tests/config/config.py"
+HSC_ARGS="$TESTDATA_JOINTCAL_DIR/hsc --id visit=903334^903336^903338^903342^903344^903346^903986^903988^903990^904010^904014 --configfile $JOINTCAL_DIR/tests/config/hsc-config.py"
+
+for DATASET in cfht hsc; do
+    if [ "$DATASET" == "cfht" ]; then
+        ARGS=$CFHT_ARGS
+    else
+        ARGS=$HSC_ARGS
+    fi
+    for MODE in simplicialLDLT supernodalLLT; do
+        LOG="$OUTPUT/$DATASET-$MODE.log"
+        mkdir -p $OUTPUT
+        echo "=== $DATASET $MODE"
+        /usr/bin/time -v jointcal.py $ARGS --output $OUTPUT/$DATASET-$MODE $CLOBBER \
+            --config astrometryModel=constrained photometryModel=constrainedMagnitude factorizationMode=$MODE \
+            --loglevel jointcal=DEBUG > $LOG 2>&1
+        grep "Hessian factorized in" $LOG | \
+            awk '{for (i = 1; i <= NF; i++) if ($i == "in") {total += $(i+1); n++}}
+                 END {printf "factorizations: %d, total time: %.3f s\n", n, total}'
+        grep "Maximum resident set size" $LOG
+    done
+done
@@ -0,0 +1,39 @@
+#!/usr/bin/bash
+#
+# Compare the Hessian assembly and factorization with and without sorting the
+# stars along a Hilbert curve (config.sortStarsSpatially) on the
+# testdata_jointcal hsc dataset, with the constrained models.
+# Reports the total assembly and factorization times, and the size of the
+# factors, of each run.
+# Requires the following be setup before being run:
+#     obs_subaru
+#     jointcal
+#     testdata_jointcal
+#
+# No timings are recorded here yet: run it on the target machine before
+# choosing a non-default setting, since the outcome depends on the data,
+# the BLAS and the cholmod build.
+
+OUTPUT="benchmark_star_ordering_output"
+CLOBBER="--clobber-versions --clobber-config"
+
+HSC_ARGS="$TESTDATA_JOINTCAL_DIR/hsc --id visit=903334^903336^903338^903342^903344^903346^903986^903988^903990^904010^904014 --configfile $JOINTCAL_DIR/tests/config/hsc-config.py"
+
+for SORT in False True; do
+    LOG="$OUTPUT/hsc-sort$SORT.log"
+    mkdir -p $OUTPUT
+    echo "=== hsc sortStarsSpatially=$SORT"
+    /usr/bin/time -v jointcal.py $HSC_ARGS --output $OUTPUT/hsc-sort$SORT $CLOBBER \
+        --config astrometryModel=constrained photometryModel=constrainedMagnitude sortStarsSpatially=$SORT \
+        --loglevel jointcal=DEBUG > $LOG 2>&1
+    grep "Hessian assembled in" $LOG | \
+        awk '{for (i = 1; i <= NF; i++) if ($i == "in") {total += $(i+1); n++}}
+             END {printf "assemblies: %d, total time: %.3f s\n", n, total}'
+    grep "Hessian factorized in" $LOG | \
+        awk '{for (i = 1; i <= NF; i++) {
+                  if ($i == "in") {total += $(i+1); n++}
+                  if ($i ~ /^non-zeros=/) {split($i, a, "="); nnz += a[2]}
+              }}
+             END {printf "factorizations: %d, total time: %.3f s, mean nnz(L): %.0f\n", n, total, nnz/n}'
+    grep "Maximum resident set size" $LOG
+done
@@ -41,6 +41,7 @@
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/Point.h"
 #include "lsst/jointcal/JointcalControl.h"
+#include "lsst/jointcal/StageMetrics.h"
 
 #include "lsst/afw/table/SortedCatalog.h"
 
@@ -128,6 +129,23 @@ public:
     void associateCatalogs(const double matchCutInArcsec = 0, const bool useFittedList = false,
                            const bool enlargeFittedList = true);
 
+    /**
+     * Associate the catalogs of the ccdImages with the fittedStarList of a previous fit, to fit new
+     * visits without refitting the saved ones.
+     *
+     * Call it in place of associateCatalogs(), collectRefStars() and prepareFittedStars(), once the saved
+     * fittedStars are restored (with their measurement counts) and ccdImageList only holds the new
+     * ccdImages. The refStars are replaced by priors on the saved fittedStars that the new catalogs
+     * match: each prior is the saved solution, with the error of a single measurement divided by the number
+     * of measurements it was fit to, so that the new visits are anchored by the previous fit. The saved
+     * fittedStars that no new measurement matches are dropped, and the unmatched measurements make new
+     * fittedStars, kept if they have at least minMeasurements measurements and started from their average.
+     *
+     * @param[in]  matchCutInArcsec  Separation radius to match measured and fitted stars.
+     * @param[in]  minMeasurements  The minimum number of measuredStars for a new FittedStar to be included.
+     */
+    void associateNewCatalogs(double matchCutInArcsec, int minMeasurements);
+
     /**
      * @brief      Collect stars from an external reference catalog and associate them with fittedStars.
      *
@@ -159,6 +177,17 @@ public:
      */
     void prepareFittedStars(int minMeasurements);
 
+    /**
+     * Sort the fittedStarList, and the catalogForFit of each ccdImage, along a Hilbert curve on the
+     * common tangent plane.
+     *
+     * Stars that are close on the sky then get close indices in the fit, which shortens the distance
+     * between the Hessian entries of the stars of a CcdImage, for the cache locality of its assembly.
+     * The gain has not been measured; see examples/benchmark_star_ordering.sh. Call it after
+     * prepareFittedStars(), since the fit assigns its parameter indices in list order.
+     */
+    void sortStarsSpatially();
+
     CcdImageList const &getCcdImageList() const { return ccdImageList; }
 
     //! Number of different bands in the input image list. Not implemented so far
@@ -177,7 +206,19 @@ public:
      */
     size_t nFittedStarsWithAssociatedRefStar() const;
 
+    /// Time spent loading the input catalogs, by createCcdImage().
+    StageMetrics const &getLoadCatalogMetrics() const { return _loadCatalogMetrics; }
+
+    /// Time spent matching the catalogs, by associateCatalogs() and associateNewCatalogs().
+    StageMetrics const &getAssociateCatalogsMetrics() const { return _associateCatalogsMetrics; }
+
+    /// Time spent matching the reference catalogs, by collectRefStars().
+    StageMetrics const &getCollectRefStarsMetrics() const { return _collectRefStarsMetrics; }
+
 private:
+    /// Match the catalog of ccdImage with fittedStarList, and add the unmatched stars if enlargeFittedList.
+    void associateCatalog(CcdImage &ccdImage, double matchCutInArcSec, bool enlargeFittedList);
+
     void associateRefStars(double matchCutInArcsec, const AstrometryTransform *transform);
 
     void assignMags();
@@ -198,6 +239,10 @@ private:
     void normalizeFittedStars() const;
 
     Point _commonTangentPoint;
+
+    StageMetrics _loadCatalogMetrics;
+    StageMetrics _associateCatalogsMetrics;
+    StageMetrics _collectRefStarsMetrics;
 };
 
 }  // namespace jointcal
@@ -118,6 +118,12 @@ public:
 
     void offsetParams(Eigen::VectorXd const &delta) override;
 
+    /// @copydoc FitterBase::getParameters
+    Eigen::VectorXd getParameters() const override;
+
+    /// @copydoc FitterBase::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /// Return the model being fit.
     std::shared_ptr<AstrometryModel> getModel() const { return _astrometryModel; }
 
@@ -149,19 +155,33 @@ private:
     double _posError;  // constant term on error on position (in pixel unit)
 
     void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
-                                           Eigen::VectorXd &grad,
+                                           Eigen::VectorXd *grad,
                                            MeasuredStarList const *msList = nullptr) const override;
 
     void leastSquareDerivativesReference(FittedStarList const &fittedStarList, TripletList &tripletList,
-                                         Eigen::VectorXd &grad) const override;
+                                         Eigen::VectorXd *grad) const override;
 
     void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const override;
 
     void accumulateStatRefStars(Chi2Accumulator &accum) const override;
 
+    unsigned getNParFittedStar(FittedStar const &fittedStar) const override;
+
+    /// Positions enter non-linearly through the tangent plane projection.
+    bool isLinear() const override;
+
+    std::vector<unsigned> getDenseBorderCandidates() const override;
+
+    void countDerivativesMeasurement(CcdImage const &ccdImage, DerivativesCount &count) const override;
+
+    void countDerivativesReference(DerivativesCount &count) const override;
+
     void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                   std::vector<unsigned> &indices) const override;
 
+    void splitWhatToFit(std::string const &whatToFit, std::string &starWhatToFit,
+                        std::string &modelWhatToFit) const override;
+
     Point transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const &sky2TP,
                               Point const &refractionVector, double refractionCoeff, double mjd) const;
 
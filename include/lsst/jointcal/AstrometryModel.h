@@ -26,6 +26,7 @@
 #define LSST_JOINTCAL_ASTROMETRY_MODEL_H
 
 #include "memory"
+#include <vector>
 
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/AstrometryTransform.h"
@@ -63,6 +64,22 @@ public:
      */
     virtual void offsetParams(Eigen::VectorXd const &delta) = 0;
 
+    /**
+     * Copy the values of the fitted parameters, at the indices given in assignIndices.
+     *
+     * @param[out] parameters  vector of the size of the fit, in which to store the values
+     */
+    virtual void getParameters(Eigen::VectorXd &parameters) const = 0;
+
+    /**
+     * Set the fitted parameters to the provided values, e.g. those saved by getParameters().
+     *
+     * The values are read according to the indices given in assignIndices.
+     *
+     * @param[in]  parameters  vector of values to set
+     */
+    virtual void setParameters(Eigen::VectorXd const &parameters) = 0;
+
     //! The transformation used to project the positions of FittedStars.
     /*! This defines the coordinate system into which the Mapping of
         this Ccdimage maps the pixel coordinates. */
@@ -81,9 +98,22 @@ public:
     //!
     virtual void freezeErrorTransform() = 0;
 
+    /**
+     * Return whether the transformed positions are linear in the parameters of this model, with
+     * derivatives and errors that do not depend on them: a fit of this model alone then has a constant
+     * Hessian.
+     */
+    virtual bool isLinear() const { return false; }
+
     /// Return the total number of parameters in this model.
     virtual int getTotalParameters() const = 0;
 
+    /**
+     * Return the indices of the fitted parameters that are shared by all the visits, e.g. those of the
+     * chips of a constrained model, as assigned by the last assignIndices().
+     */
+    virtual std::vector<unsigned> getChipParameterIndices() const { return {}; }
+
     virtual ~AstrometryModel(){};
 
     /**
@@ -158,6 +158,9 @@ public:
     //! params should be at least Npar() long
     void getParams(double *params) const;
 
+    //! params should be at least Npar() long, in the same order as getParams()
+    void setParams(double const *params);
+
     //!
     void offsetParams(Eigen::VectorXd const &delta);
 
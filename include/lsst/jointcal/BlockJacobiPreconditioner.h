@@ -0,0 +1,132 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
+#define LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
+
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Block-Jacobi preconditioner for the normal equations H * delta = grad, with H = J * J^T.
+ *
+ * The diagonal blocks of H are accumulated from the Jacobian, one chunk of Jacobian columns at a time, so
+ * that H itself never has to be stored. Each block is then Cholesky-factorized, and the preconditioner
+ * applies the inverse of the block-diagonal part of H.
+ */
+class BlockJacobiPreconditioner {
+public:
+    BlockJacobiPreconditioner() : _nParTot(0) {}
+
+    /// No copy: the blocks can be large.
+    BlockJacobiPreconditioner(BlockJacobiPreconditioner const &) = delete;
+    BlockJacobiPreconditioner(BlockJacobiPreconditioner &&) = delete;
+    BlockJacobiPreconditioner &operator=(BlockJacobiPreconditioner const &) = delete;
+    BlockJacobiPreconditioner &operator=(BlockJacobiPreconditioner &&) = delete;
+
+    /**
+     * Define the blocks.
+     *
+     * @param nParTot  Total number of parameters.
+     * @param blocks  The parameter indices of each block; each parameter must be in exactly one block.
+     */
+    void setBlocks(unsigned nParTot, std::vector<std::vector<unsigned>> const &blocks);
+
+    /// Number of blocks.
+    std::size_t getNBlocks() const { return _blocks.size(); }
+
+    /// Size of the largest block.
+    unsigned getMaxBlockSize() const;
+
+    /**
+     * Start accumulating the blocks, from nSlots independent streams of Jacobian columns.
+     *
+     * add() may then be called concurrently for different slots.
+     */
+    void start(std::size_t nSlots);
+
+    /**
+     * Accumulate the diagonal blocks of J * J^T for the Jacobian columns in tripletList.
+     *
+     * @param tripletList  Jacobian triplets (parameter, column, value); the columns must start at 0.
+     * @param slot  The accumulation slot, in [0, nSlots) as given to start().
+     */
+    void add(TripletList const &tripletList, std::size_t slot);
+
+    /**
+     * Sum the slots and factorize each block.
+     *
+     * A block that is not positive definite falls back to the inverse of its positive diagonal
+     * elements (and 0 elsewhere).
+     *
+     * @return The number of blocks that fell back to their diagonal.
+     */
+    std::size_t finish();
+
+    /// Return M^-1 * residual, where M is the block-diagonal part of H.
+    Eigen::VectorXd apply(Eigen::VectorXd const &residual) const;
+
+private:
+    struct Block {
+        unsigned size;
+        std::size_t indexStart;  // into _indices
+        std::size_t valueStart;  // into the values of each slot, and _factors
+        bool factorized;         // false: _factors holds the inverse diagonal
+    };
+
+    // One Jacobian entry, located in its block.
+    struct Entry {
+        int block;
+        unsigned position;
+        double value;
+        bool operator<(Entry const &other) const {
+            return (block < other.block) || (block == other.block && position < other.position);
+        }
+    };
+
+    // Accumulation state of one stream of Jacobian columns.
+    struct Slot {
+        std::vector<double> values;  // column-major dense blocks
+        std::vector<std::size_t> columnStart;
+        std::vector<Entry> entries;  // grouped by Jacobian column
+    };
+
+    unsigned _nParTot;
+    std::vector<Block> _blocks;
+    std::vector<unsigned> _indices;   // parameter indices of each block
+    std::vector<int> _blockOf;        // block of each parameter
+    std::vector<unsigned> _position;  // position of each parameter in its block
+    std::vector<Slot> _slots;
+    std::vector<double> _factors;  // lower Cholesky factor (or inverse diagonal) of each block
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_BLOCK_JACOBI_PRECONDITIONER_H
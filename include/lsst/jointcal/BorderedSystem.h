@@ -0,0 +1,146 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_BORDERED_SYSTEM_H
+#define LSST_JOINTCAL_BORDERED_SYSTEM_H
+
+#include <vector>
+
+#include "Eigen/Cholesky"
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Solve normal equations H * delta = grad whose few densest rows and columns (the "border", e.g. the
+ * refraction coefficients, coupled to every measurement) are handled apart from the sparse rest.
+ *
+ * Writing the border parameters as "B" and the others (the "interior") as "I", only H_II, which has
+ * no dense rows, is factorized by cholmod; the border is then solved with the small dense matrix
+ * @f[
+ *     S = H_{BB} - H_{BI} H_{II}^{-1} H_{IB},
+ * @f]
+ * i.e. @f$ \delta_B = S^{-1} (g_B - H_{BI} H_{II}^{-1} g_I) @f$ and
+ * @f$ \delta_I = H_{II}^{-1} (g_I - H_{IB} \delta_B) @f$.
+ * Forming S costs one solve with the interior factor per border parameter, and each solution two
+ * solves; neither the fill-in of the dense rows nor @f$ H_{II}^{-1} H_{IB} @f$ is ever stored.
+ *
+ * The border is chosen among candidate parameters the fitter knows to be global (the refraction
+ * coefficients, the chip parameters of a constrained model), with the dense row criterion of AMD: a
+ * candidate belongs to it if it is coupled to more than max(16, 10*sqrt(n)) of the n parameters. The visit
+ * and chip parameters of any fit pass that criterion, and would make too large a border.
+ *
+ * The interior factor can be rank updated: see getInteriorRows() and updateCouplings().
+ */
+class BorderedSystem {
+public:
+    explicit BorderedSystem(unsigned maxBorder = 64) : _maxBorder(maxBorder), _dim(0) {}
+
+    /// No copy: the border couplings can be large.
+    BorderedSystem(BorderedSystem const &) = delete;
+    BorderedSystem(BorderedSystem &&) = delete;
+    BorderedSystem &operator=(BorderedSystem const &) = delete;
+    BorderedSystem &operator=(BorderedSystem &&) = delete;
+
+    /// Set the maximum number of border parameters; the densest are kept. 0 disables the border.
+    void setMaxBorder(unsigned maxBorder) { _maxBorder = maxBorder; }
+
+    /// Get the maximum number of border parameters.
+    unsigned getMaxBorder() const { return _maxBorder; }
+
+    /// Number of border parameters found by the last split().
+    unsigned getNBorder() const { return _border.size(); }
+
+    /// Indices of the border parameters found by the last split(), in increasing order.
+    std::vector<unsigned> const &getBorder() const { return _border; }
+
+    /// Index in the interior of parameter i of the last split() matrix, or -1 if i is in the border.
+    int getInteriorIndex(unsigned i) const {
+        return _interiorIndex.empty() ? static_cast<int>(i) : _interiorIndex[i];
+    }
+
+    /**
+     * Find the border of hessian and, if there is one, separate it from the interior.
+     *
+     * @param hessian  Lower triangle of the full matrix.
+     * @param candidates  Indices of the parameters that may be in the border.
+     * @param[out] interior  Lower triangle of H_II; untouched if there is no border.
+     *
+     * @return false if there is no border: hessian should then be factorized as is.
+     */
+    bool split(SparseMatrixD const &hessian, std::vector<unsigned> const &candidates,
+               SparseMatrixD &interior);
+
+    /**
+     * Return the interior rows of matrix, which has the rows of the last split() matrix: the interior
+     * factor is rank updated by the interior rows of the update.
+     */
+    SparseMatrixD getInteriorRows(SparseMatrixD const &matrix) const;
+
+    /**
+     * Update the couplings of the border from hessian, e.g. after a rank update of the interior factor;
+     * reduce() must then be called again.
+     *
+     * @param hessian  Lower triangle of the full matrix, with the same border as the last split().
+     */
+    void updateCouplings(SparseMatrixD const &hessian);
+
+    /**
+     * Form and factorize the dense matrix S of the border.
+     *
+     * @param interiorFactor  Factorization of the interior given by the last split().
+     *
+     * @return false if S is not positive semi-definite or not finite.
+     */
+    bool reduce(CholmodSimplicialLDLT2<SparseMatrixD> const &interiorFactor);
+
+    /**
+     * Solve the full system for grad, with the factorizations of the last split() and reduce().
+     *
+     * @param interiorFactor  Factorization of the interior, as given to reduce().
+     * @param grad  Right-hand side of the full system.
+     */
+    Eigen::VectorXd solve(CholmodSimplicialLDLT2<SparseMatrixD> const &interiorFactor,
+                          Eigen::VectorXd const &grad) const;
+
+private:
+    // Copy the couplings of the border from hessian, and its interior into interior if not null.
+    void _extract(SparseMatrixD const &hessian, SparseMatrixD *interior);
+
+    unsigned _maxBorder;
+    Eigen::Index _dim;                // dimension of the full system
+    std::vector<unsigned> _border;    // indices of the border parameters
+    std::vector<int> _interiorIndex;  // interior index of each parameter, -1 in the border; empty if none
+    SparseMatrixD _coupling;          // H_IB: interior rows, border columns
+    Eigen::MatrixXd _borderBlock;     // H_BB
+    Eigen::LDLT<Eigen::MatrixXd> _borderFactor;  // of S
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_BORDERED_SYSTEM_H
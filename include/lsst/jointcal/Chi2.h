@@ -25,14 +25,13 @@
 #ifndef LSST_JOINTCAL_CHI2_H
 #define LSST_JOINTCAL_CHI2_H
 
+#include <cstdint>
 #include <string>
 #include <iostream>
 #include <sstream>
 #include <utility>
 #include <vector>
 
-#include "lsst/jointcal/BaseStar.h"
-
 namespace lsst {
 namespace jointcal {
 
@@ -43,7 +42,15 @@ namespace jointcal {
  */
 class Chi2Accumulator {
 public:
-    virtual void addEntry(double inc, unsigned dof, std::shared_ptr<BaseStar> star) = 0;
+    /**
+     * Add one chi2 contribution.
+     *
+     * @param inc  The chi2 contribution.
+     * @param dof  The number of squares in the contribution.
+     * @param index  The position of the contributing star in the list being accumulated: the
+     *               catalogForFit of the CcdImage for measurements, the FittedStarList for references.
+     */
+    virtual void addEntry(double inc, unsigned dof, std::size_t index) = 0;
 
     virtual ~Chi2Accumulator(){};
 };
@@ -62,7 +69,7 @@ public:
     }
 
     // Addentry has an ignored third argument in order to make it compatible with Chi2List.
-    void addEntry(double inc, unsigned dof, std::shared_ptr<BaseStar>) override {
+    void addEntry(double inc, unsigned dof, std::size_t) override {
         chi2 += inc;
         ndof += dof;
     }
@@ -74,39 +81,66 @@ public:
     }
 };
 
-/*
- * A class to accumulate chi2 contributions together with pointers to the contributors.
+/**
+ * A compact chi2 contribution, pointing back to its contributor by index.
  *
- * This structure lets one compute the chi2 statistics (average and variance) and directly point back
- * to the bad guys without relooping.
- * The Chi2Star routine makes it compatible with AstrometryFit's
- * accumulateStatImage and accumulateStatImageList.
+ * The index is global to the fit: the measurements of all CcdImages first (in CcdImageList and
+ * catalogForFit order), then the reference terms (in FittedStarList order); see Chi2List::setIndexOffset.
+ * The chi2 is kept in double precision, so that it compares to the outlier cut exactly as the double it
+ * was computed as.
  */
-struct Chi2Star {
+struct Chi2Record {
     double chi2;
-    std::shared_ptr<BaseStar> star;
+    std::uint32_t index;
 
-    Chi2Star(double chi2, std::shared_ptr<BaseStar> star) : chi2(chi2), star(std::move(star)) {}
     // for sorting
-    bool operator<(Chi2Star const& rhs) const { return (chi2 < rhs.chi2); }
+    bool operator<(Chi2Record const& rhs) const { return (chi2 < rhs.chi2); }
 
-    friend std::ostream& operator<<(std::ostream& s, Chi2Star const& chi2Star) {
-        s << "chi2: " << chi2Star.chi2 << " star: " << *(chi2Star.star) << std::endl;
+    friend std::ostream& operator<<(std::ostream& s, Chi2Record const& record) {
+        s << "chi2: " << record.chi2 << " index: " << record.index << std::endl;
         return s;
     }
 };
 
-/// Structure to accumulate the chi2 contributions per each star (to help find outliers).
-class Chi2List : public Chi2Accumulator, public std::vector<Chi2Star> {
+/**
+ * Structure to accumulate the chi2 contributions per each star (to help find outliers).
+ *
+ * Each contribution is stored as a Chi2Record, which the caller resolves to its star, and the sums needed
+ * for the average and standard deviation are accumulated as the records are added.
+ */
+class Chi2List : public Chi2Accumulator, public std::vector<Chi2Record> {
 public:
-    void addEntry(double chi2, unsigned ndof, std::shared_ptr<BaseStar> star) override {
-        push_back(Chi2Star(chi2, std::move(star)));
+    Chi2List() : _indexOffset(0), _sum(0), _sum2(0) {}
+
+    /// Set the global index of the star at position 0 of the list being accumulated next.
+    void setIndexOffset(std::size_t indexOffset) { _indexOffset = indexOffset; }
+
+    void addEntry(double chi2, unsigned ndof, std::size_t index) override {
+        push_back(Chi2Record{chi2, static_cast<std::uint32_t>(_indexOffset + index)});
+        _sum += chi2;
+        _sum2 += chi2 * chi2;
+    }
+
+    /// Remove all records and zero the sums, keeping the storage of the records.
+    void reset() {
+        clear();
+        _indexOffset = 0;
+        _sum = 0;
+        _sum2 = 0;
     }
 
+    /// Append the records of other, and add its sums to ours.
+    void append(Chi2List const& other);
+
     /// Compute the average and std-deviation of these chisq values.
-    std::pair<double, double> computeAverageAndSigma();
+    std::pair<double, double> computeAverageAndSigma() const;
 
     friend std::ostream& operator<<(std::ostream& s, Chi2List const& chi2List);
+
+private:
+    std::size_t _indexOffset;
+    double _sum;
+    double _sum2;
 };
 
 }  // namespace jointcal
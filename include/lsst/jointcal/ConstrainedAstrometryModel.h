@@ -79,6 +79,12 @@ public:
      */
     void offsetParams(Eigen::VectorXd const &Delta) override;
 
+    /// @copydoc AstrometryModel::getParameters
+    void getParameters(Eigen::VectorXd &parameters) const override;
+
+    /// @copydoc AstrometryModel::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /**
      * From there on, measurement errors are propagated using the current
      * transforms (and no longer evolve).
@@ -88,6 +94,9 @@ public:
     /// @copydoc AstrometryModel::getTotalParameters
     int getTotalParameters() const override;
 
+    /// @copydoc AstrometryModel::getChipParameterIndices
+    std::vector<unsigned> getChipParameterIndices() const override;
+
     //! Access to mappings
     AstrometryTransform const &getChipTransform(CcdIdType const chip) const;
 
@@ -97,6 +106,24 @@ public:
     //! Access to array of visits involved in the solution.
     std::vector<VisitIdType> getVisits() const;
 
+    /**
+     * The parameters of the transform of each chip, including the one held fixed, to warm-start the
+     * chips of another model of the same camera.
+     */
+    std::map<CcdIdType, Eigen::VectorXd> getChipParameters() const;
+
+    /**
+     * Set the transforms of all the chips of this model from chipParameters.
+     *
+     * @return The number of chips that were set.
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if a chip of this model is not in
+     *         chipParameters: it would be held fixed at its initial transform.
+     * @throws lsst::pex::exceptions::LengthError if the parameters of a chip do not match its transform,
+     *         e.g. because the models have different chipOrder.
+     */
+    std::size_t setChipParameters(std::map<CcdIdType, Eigen::VectorXd> const &chipParameters);
+
     /**
      * The mapping of sky coordinates (i.e. the coordinate system in which fitted
      * stars are reported) onto the Tangent plane (into which the pixel coordinates
@@ -76,6 +76,12 @@ public:
     /// @copydoc PhotometryModel::offsetParams
     void offsetParams(Eigen::VectorXd const &delta) override;
 
+    /// @copydoc PhotometryModel::getParameters
+    void getParameters(Eigen::VectorXd &parameters) const override;
+
+    /// @copydoc PhotometryModel::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /// @copydoc PhotometryModel::freezeErrorTransform
     void freezeErrorTransform() override;
 
@@ -85,6 +91,24 @@ public:
     /// @copydoc PhotometryModel::getTotalParameters
     int getTotalParameters() const override;
 
+    /**
+     * The parameters of the transform of each chip, including the one held fixed, to warm-start the
+     * chips of another model of the same camera.
+     */
+    std::map<CcdIdType, Eigen::VectorXd> getChipParameters() const;
+
+    /**
+     * Set the transforms of all the chips of this model from chipParameters.
+     *
+     * @return The number of chips that were set.
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if a chip of this model is not in
+     *         chipParameters: it would be held fixed at its initial transform.
+     * @throws lsst::pex::exceptions::LengthError if the parameters of a chip do not match its transform,
+     *         e.g. because the models are not of the same kind.
+     */
+    std::size_t setChipParameters(std::map<CcdIdType, Eigen::VectorXd> const &chipParameters);
+
     /// @copydoc PhotometryModel::computeParameterDerivatives
     void computeParameterDerivatives(MeasuredStar const &measuredStar, CcdImage const &ccdImage,
                                      Eigen::VectorXd &derivatives) const override;
@@ -151,6 +175,14 @@ public:
         fittedStar.getFlux() -= delta;
     }
 
+    /// @copydoc PhotometryModel::getFittedStarValue
+    double getFittedStarValue(FittedStar const &fittedStar) const override { return fittedStar.getFlux(); }
+
+    /// @copydoc PhotometryModel::setFittedStarValue
+    void setFittedStarValue(FittedStar &fittedStar, double value) const override {
+        fittedStar.getFlux() = value;
+    }
+
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
@@ -195,6 +227,14 @@ public:
         fittedStar.getMag() -= delta;
     }
 
+    /// @copydoc PhotometryModel::getFittedStarValue
+    double getFittedStarValue(FittedStar const &fittedStar) const override { return fittedStar.getMag(); }
+
+    /// @copydoc PhotometryModel::setFittedStarValue
+    void setFittedStarValue(FittedStar &fittedStar, double value) const override {
+        fittedStar.getMag() = value;
+    }
+
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
@@ -212,6 +252,10 @@ public:
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::isLinear
+    /// The chip and visit magnitude offsets add up, and do not change the errors.
+    bool isLinear() const override { return true; }
+
     /// @copydoc PhotometryModel::toPhotoCalib
     std::shared_ptr<afw::image::PhotoCalib> toPhotoCalib(CcdImage const &ccdImage) const override;
 
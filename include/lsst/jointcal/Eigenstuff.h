@@ -27,6 +27,10 @@
 
 #include "lsst/pex/exceptions.h"
 
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
 #include "Eigen/CholmodSupport"  // to switch to cholmod
 #include "Eigen/Core"
 
@@ -34,14 +38,30 @@ typedef Eigen::Matrix<double, Eigen::Dynamic, 2> MatrixX2d;
 
 typedef Eigen::SparseMatrix<double> SparseMatrixD;
 
+/// Factorization kernels available in CholmodSimplicialLDLT2.
+enum class CholmodMode {
+    SimplicialLDLT,  ///< Column-by-column LDLt: low memory, supports rank updates (the default).
+    SupernodalLLT    ///< Supernodal LLt using dense BLAS-3 kernels, multithreaded if the BLAS is.
+};
+
+/// Fill-reducing orderings available in CholmodSimplicialLDLT2.
+enum class CholmodOrdering {
+    Default,           ///< cholmod's choice: AMD, or METIS if AMD fills too much and METIS is installed.
+    AMD,               ///< Approximate minimum degree.
+    NestedDissection,  ///< METIS nested dissection; AMD if cholmod was built without METIS.
+    Given              ///< The permutation passed to setPermutation().
+};
+
 /* Cholesky factorization class using cholmod, with the small-rank update capability.
  *
  * Class derived from Eigen's CholmodBase, to add the factorization
  * update capability to the interface. Besides this addition, it
  * behaves the same way as Eigen's native Cholesky factorization
- * classes. It relies on the simplicial LDLt factorization.
+ * classes. It relies on the simplicial LDLt factorization, unless
+ * setMode(CholmodMode::SupernodalLLT) was called, which is meant for
+ * large, dense-ish Hessians but cannot be rank updated.
  *
- * @Seealso Eigen::CholmodSimplicialLDLT
+ * @Seealso Eigen::CholmodSimplicialLDLT, Eigen::CholmodDecomposition
  */
 template <typename _MatrixType, int _UpLo = Eigen::Lower>
 class CholmodSimplicialLDLT2
@@ -54,15 +74,193 @@ public:
     typedef typename MatrixType::Index Index;
     typedef typename MatrixType::RealScalar RealScalar;
 
-    CholmodSimplicialLDLT2() : Base() { init(); }
+    CholmodSimplicialLDLT2()
+            : Base(),
+              _mode(CholmodMode::SimplicialLDLT),
+              _ordering(CholmodOrdering::Default),
+              _patternHash(0) {
+        init();
+    }
 
-    CholmodSimplicialLDLT2(MatrixType const &matrix) : Base() {
+    CholmodSimplicialLDLT2(MatrixType const &matrix)
+            : Base(),
+              _mode(CholmodMode::SimplicialLDLT),
+              _ordering(CholmodOrdering::Default),
+              _patternHash(0) {
         init();
         this->compute(matrix);
     }
 
+    /**
+     * Select the factorization kernel. The next factorization redoes the symbolic analysis.
+     *
+     * @note Supernodal factorization requires a cholmod library built without NSUPERNODAL;
+     *       otherwise cholmod silently falls back to the simplicial factorization.
+     */
+    void setMode(CholmodMode mode) {
+        _mode = mode;
+        m_cholmod.supernodal = (mode == CholmodMode::SupernodalLLT) ? CHOLMOD_SUPERNODAL : CHOLMOD_SIMPLICIAL;
+        Base::m_analysisIsOk = false;
+        Base::m_factorizationIsOk = false;
+    }
+
+    /// Return the factorization kernel in use.
+    CholmodMode getMode() const { return _mode; }
+
+    /// Return the kernel of the last symbolic analysis, e.g. SimplicialLDLT if cholmod has no supernodal one.
+    CholmodMode getModeUsed() const {
+        if (!Base::m_cholmodFactor) return _mode;
+        return Base::m_cholmodFactor->is_super ? CholmodMode::SupernodalLLT : CholmodMode::SimplicialLDLT;
+    }
+
+    /**
+     * Select the fill-reducing ordering. If it changed, the next factorization redoes the symbolic analysis.
+     *
+     * @note With CholmodOrdering::Given, setPermutation() must be called before the next factorization.
+     */
+    void setOrdering(CholmodOrdering ordering) {
+        if (ordering == _ordering) return;
+        _ordering = ordering;
+        if (ordering == CholmodOrdering::Default) {
+            m_cholmod.nmethods = 0;
+        } else {
+            m_cholmod.nmethods = 1;
+            m_cholmod.method[0].ordering = orderingMethod(ordering);
+        }
+        Base::m_analysisIsOk = false;
+        Base::m_factorizationIsOk = false;
+    }
+
+    /// Return the requested fill-reducing ordering.
+    CholmodOrdering getOrdering() const { return _ordering; }
+
+    /**
+     * Set the ordering used with CholmodOrdering::Given: row and column k of the permuted matrix are row
+     * and column permutation[k] of the matrix. The next factorization redoes the symbolic analysis if the
+     * permutation changed.
+     */
+    void setPermutation(std::vector<int> permutation) {
+        if (permutation == _permutation) return;
+        _permutation = std::move(permutation);
+        Base::m_analysisIsOk = false;
+        Base::m_factorizationIsOk = false;
+    }
+
+    /// Return the ordering the last symbolic analysis actually used, e.g. AMD if METIS is not available.
+    CholmodOrdering getOrderingUsed() const {
+        if (!Base::m_cholmodFactor) return _ordering;
+        switch (Base::m_cholmodFactor->ordering) {
+            case CHOLMOD_GIVEN:
+                return CholmodOrdering::Given;
+            case CHOLMOD_METIS:
+            case CHOLMOD_NESDIS:
+                return CholmodOrdering::NestedDissection;
+            case CHOLMOD_AMD:
+                return CholmodOrdering::AMD;
+            default:
+                return CholmodOrdering::Default;
+        }
+    }
+
+    /**
+     * Compute the fill-reducing ordering and the elimination tree of matrix, with the selected ordering.
+     *
+     * Replaces Eigen's CholmodBase::analyzePattern, which cannot pass a permutation to cholmod.
+     */
+    void analyzePattern(MatrixType const &matrix) {
+        if (Base::m_cholmodFactor) {
+            cholmod_free_factor(&this->m_cholmodFactor, &m_cholmod);
+            Base::m_cholmodFactor = nullptr;
+        }
+        cholmod_sparse A = Eigen::viewAsCholmod(matrix.template selfadjointView<_UpLo>());
+        if (_ordering == CholmodOrdering::Given) {
+            eigen_assert(static_cast<Index>(_permutation.size()) == matrix.rows());
+            Base::m_cholmodFactor = cholmod_analyze_p(&A, _permutation.data(), nullptr, 0, &m_cholmod);
+        } else {
+            Base::m_cholmodFactor = cholmod_analyze(&A, &m_cholmod);
+            if (!Base::m_cholmodFactor && _ordering == CholmodOrdering::NestedDissection) {
+                // cholmod was built without METIS.
+                m_cholmod.method[0].ordering = CHOLMOD_AMD;
+                Base::m_cholmodFactor = cholmod_analyze(&A, &m_cholmod);
+                m_cholmod.method[0].ordering = CHOLMOD_METIS;
+            }
+        }
+        this->m_isInitialized = true;
+        this->m_info = Base::m_cholmodFactor ? Eigen::Success : Eigen::InvalidInput;
+        Base::m_analysisIsOk = (Base::m_cholmodFactor != nullptr);
+        Base::m_factorizationIsOk = false;
+    }
+
+    /**
+     * Analyze and factorize matrix, with the selected ordering.
+     *
+     * Replaces Eigen's CholmodBase::compute, which calls its own analyzePattern, not the one above.
+     */
+    CholmodSimplicialLDLT2 &compute(MatrixType const &matrix) {
+        analyzePattern(matrix);
+        this->factorize(matrix);
+        return *this;
+    }
+
+    /// Number of floating point operations of a factorization, estimated by the last symbolic analysis.
+    double getFactorizationFlops() const { return m_cholmod.fl; }
+
+    /// Number of non-zeros in the factor, estimated by the last symbolic analysis.
+    double getFactorNonZeros() const { return m_cholmod.lnz; }
+
+    /// Whether the current factor can be modified in place by update().
+    bool canUpdate() const {
+        return Base::m_factorizationIsOk && Base::m_cholmodFactor && !Base::m_cholmodFactor->is_super;
+    }
+
+    /**
+     * Factorize matrix, reusing the symbolic analysis (fill-reducing ordering and elimination tree) of
+     * the previous call if matrix has the same sparsity pattern.
+     *
+     * The index arrays of matrix (which must be compressed) are compared exactly with those of the
+     * analysed matrix; the pattern hash only rejects a different pattern quickly. Explicitly stored zeros
+     * count as part of the pattern.
+     *
+     * @param matrix  The matrix to factorize; only the _UpLo triangle is read.
+     *
+     * @return true if the previous symbolic analysis was reused.
+     */
+    bool computeReusingAnalysis(MatrixType const &matrix) {
+        std::uint64_t hash = patternHash(matrix);
+        bool reuse = Base::m_analysisIsOk && hash == _patternHash && samePattern(matrix);
+        if (!reuse) {
+            this->analyzePattern(matrix);
+            _patternHash = hash;
+            _analyzedOuter.assign(matrix.outerIndexPtr(), matrix.outerIndexPtr() + matrix.outerSize() + 1);
+            _analyzedInner.assign(matrix.innerIndexPtr(), matrix.innerIndexPtr() + matrix.nonZeros());
+            if (!Base::m_analysisIsOk) return false;  // info() reports the failure
+        }
+        this->factorize(matrix);
+        return reuse;
+    }
+
+    /// Return a 64 bit FNV-1a hash of the dimensions and sparsity pattern of a compressed matrix.
+    static std::uint64_t patternHash(MatrixType const &matrix) {
+        eigen_assert(matrix.isCompressed());
+        std::uint64_t hash = 14695981039346656037ULL;
+        auto combine = [&hash](std::uint64_t value) {
+            hash ^= value;
+            hash *= 1099511628211ULL;
+        };
+        combine(matrix.rows());
+        combine(matrix.cols());
+        combine(matrix.nonZeros());
+        for (Index k = 0; k <= matrix.outerSize(); ++k) combine(matrix.outerIndexPtr()[k]);
+        for (Index k = 0; k < matrix.nonZeros(); ++k) combine(matrix.innerIndexPtr()[k]);
+        return hash;
+    }
+
     // this routine is the one we added
     void update(SparseMatrixD const &H, bool UpOrDown) {
+        if (!canUpdate()) {
+            throw(LSST_EXCEPT(lsst::pex::exceptions::LogicError,
+                              "Only a simplicial factorization can be rank updated."));
+        }
         // check size
         Index const size = Base::m_cholmodFactor->n;
         EIGEN_UNUSED_VARIABLE(size);
@@ -90,6 +288,42 @@ protected:
         // SuiteSparse 3.2.0.8. Fixed in 3.2.7
         Base::m_shiftOffset[0] = Base::m_shiftOffset[1] = RealScalar(0.0);
     }
+
+private:
+    typedef typename MatrixType::StorageIndex StorageIndex;
+
+    // Whether the compressed matrix has exactly the pattern the current symbolic analysis was done on.
+    bool samePattern(MatrixType const &matrix) const {
+        eigen_assert(matrix.isCompressed());
+        if (matrix.rows() != matrix.cols() ||
+            static_cast<std::size_t>(matrix.outerSize()) + 1 != _analyzedOuter.size() ||
+            static_cast<std::size_t>(matrix.nonZeros()) != _analyzedInner.size()) {
+            return false;
+        }
+        return std::equal(_analyzedOuter.begin(), _analyzedOuter.end(), matrix.outerIndexPtr()) &&
+               std::equal(_analyzedInner.begin(), _analyzedInner.end(), matrix.innerIndexPtr());
+    }
+
+    static int orderingMethod(CholmodOrdering ordering) {
+        switch (ordering) {
+            case CholmodOrdering::AMD:
+                return CHOLMOD_AMD;
+            case CholmodOrdering::NestedDissection:
+                return CHOLMOD_METIS;
+            case CholmodOrdering::Given:
+                return CHOLMOD_GIVEN;
+            default:
+                return CHOLMOD_AMD;
+        }
+    }
+
+    CholmodMode _mode;
+    CholmodOrdering _ordering;
+    std::vector<int> _permutation;  // used with CholmodOrdering::Given
+    std::uint64_t _patternHash;  // hash of the pattern the current symbolic analysis was done on
+    // Index arrays of the pattern the current symbolic analysis was done on.
+    std::vector<StorageIndex> _analyzedOuter;
+    std::vector<StorageIndex> _analyzedInner;
 };
 
 #endif  // LSST_JOINTCAL_EIGENSTUFF_H
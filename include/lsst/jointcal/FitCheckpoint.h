@@ -0,0 +1,170 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_FIT_CHECKPOINT_H
+#define LSST_JOINTCAL_FIT_CHECKPOINT_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Associations.h"
+#include "lsst/jointcal/CcdImage.h"
+#include "lsst/jointcal/FitterBase.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * A binary snapshot of a converged fit, to resume a jointcal run without redoing its associations and fit.
+ *
+ * The snapshot holds the catalogForFit of each CcdImage, the FittedStar and RefStar lists and their links
+ * (including the measurement counts, the valid flags and the refStars dropped as outliers), and the
+ * fitter state: its whatToFit and the values of its parameters (hence of the model). The transform
+ * parameters of the chips of a constrained model can be saved too, to warm-start an incremental fit of
+ * new visits against the saved solution.
+ *
+ * The file is a fixed-size header followed by contiguous arrays of fixed-size records, all 8-byte
+ * aligned, in native byte order: it is written in a few large writes, and read by mapping it in memory.
+ * The CcdImages themselves (WCS, visitInfo, detector...) are not saved: they have to be rebuilt from the
+ * input catalogs, and are matched to the saved ones by visit and ccd.
+ */
+class FitCheckpoint {
+public:
+    /// Version of the file layout; files of another version are refused.
+    static std::uint32_t const version = 2;
+
+    /**
+     * Write the state of associations and fitter to path.
+     *
+     * The file is first written next to path, then renamed, so that an interrupted write never leaves a
+     * truncated checkpoint behind.
+     *
+     * @param path  The file to write.
+     * @param associations  The associations that were fit.
+     * @param fitter  The fitter, whose current whatToFit and parameters are saved.
+     * @param chipParameters  The chip transform parameters of the model, if it is a constrained one
+     *                        (see ConstrainedAstrometryModel::getChipParameters).
+     */
+    static void write(std::string const &path, Associations const &associations, FitterBase const &fitter,
+                      std::map<CcdIdType, Eigen::VectorXd> const &chipParameters = {});
+
+    /**
+     * Map the checkpoint at path in memory, and check its header and the links between its records, so
+     * that a corrupt file is refused before anything is restored from it.
+     *
+     * @throws lsst::pex::exceptions::IoError if the file cannot be read, is not a checkpoint, or was
+     *         written with another version or byte order.
+     * @throws lsst::pex::exceptions::LengthError if the file size does not match the record counts of its
+     *         header, e.g. because it is truncated.
+     * @throws lsst::pex::exceptions::RuntimeError if the records are inconsistent: a star refers to a
+     *         star that is not in the file, or the records of the ccdImages or the chips do not add up to
+     *         the counts of the header.
+     */
+    explicit FitCheckpoint(std::string const &path);
+
+    /// No copies: the mapping is owned.
+    FitCheckpoint(FitCheckpoint const &) = delete;
+    FitCheckpoint(FitCheckpoint &&) = delete;
+    FitCheckpoint &operator=(FitCheckpoint const &) = delete;
+    FitCheckpoint &operator=(FitCheckpoint &&) = delete;
+
+    ~FitCheckpoint();
+
+    /**
+     * Replace the star lists of associations, and the catalogForFit of its CcdImages, by the saved ones.
+     *
+     * Call it before creating the model and fitter, in place of associateCatalogs(), collectRefStars()
+     * and prepareFittedStars(): the fitters read the FittedStars when they are constructed.
+     *
+     * @throws lsst::pex::exceptions::InvalidParameterError if a saved CcdImage is not in associations.
+     */
+    void restoreAssociations(Associations &associations) const;
+
+    /**
+     * Replace only the star lists of associations (and its common tangent point) by the saved ones,
+     * leaving its CcdImages untouched.
+     *
+     * This is the starting point of an incremental fit: call Associations::associateNewCatalogs() next,
+     * to associate the catalogs of the new CcdImages to the saved FittedStars.
+     */
+    void restoreStars(Associations &associations) const;
+
+    /**
+     * Set the saved parameters in fitter, after assigning the saved whatToFit.
+     *
+     * @throws lsst::pex::exceptions::LengthError if the fitter does not have as many parameters as the
+     *         saved one, e.g. because its model is not configured the same way.
+     */
+    void restoreFitter(FitterBase &fitter) const;
+
+    /// The saved chip transform parameters; empty if the model was not a constrained one.
+    std::map<CcdIdType, Eigen::VectorXd> getChipParameters() const;
+
+    /// The visits of the saved CcdImages, sorted.
+    std::vector<VisitIdType> getVisits() const;
+
+    /// The whatToFit of the saved fitter.
+    std::string getWhatToFit() const;
+
+    std::size_t getNCcdImages() const;
+    std::size_t getNMeasuredStars() const;
+    std::size_t getNFittedStars() const;
+    std::size_t getNRefStars() const;
+
+private:
+    // Compute the offsets of the sections of the file from the counts of its header, checking its size.
+    void computeOffsets();
+    // Check the star indices of the records, and the counts of the ccdImage and chip records.
+    void checkRecords() const;
+    // Restore the RefStar and FittedStar lists and the tangent point; returns the FittedStars in file order.
+    std::vector<std::shared_ptr<FittedStar>> restoreStarLists(Associations &associations) const;
+    // Set the saved measurement counts of the FittedStars returned by restoreStarLists.
+    void restoreMeasurementCounts(std::vector<std::shared_ptr<FittedStar>> const &fittedStars) const;
+
+    std::string _path;
+    char const *_data;  // the mapped file
+    std::size_t _size;
+
+    // offsets of the sections of the file
+    std::size_t _ccdImageOffset;
+    std::size_t _measuredStarOffset;
+    std::size_t _fittedStarOffset;
+    std::size_t _refStarOffset;
+    std::size_t _parameterOffset;
+    std::size_t _chipOffset;
+    std::size_t _chipParameterOffset;
+    std::size_t _whatToFitOffset;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_FIT_CHECKPOINT_H
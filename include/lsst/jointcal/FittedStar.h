@@ -59,10 +59,15 @@ struct PmBlock {
  */
 class FittedStar : public BaseStar, public PmBlock {
 public:
-    FittedStar() : BaseStar(), _indexInMatrix(-1), _measurementCount(0), _refStar(nullptr) {}
+    FittedStar()
+            : BaseStar(), _indexInMatrix(-1), _measurementCount(0), _refStar(nullptr), _robustWeight(1.0) {}
 
     FittedStar(const BaseStar& baseStar)
-            : BaseStar(baseStar), _indexInMatrix(0), _measurementCount(0), _refStar(nullptr) {}
+            : BaseStar(baseStar),
+              _indexInMatrix(0),
+              _measurementCount(0),
+              _refStar(nullptr),
+              _robustWeight(1.0) {}
 
     //!
     FittedStar(const MeasuredStar& measuredStar);
@@ -79,6 +84,7 @@ public:
         _indexInMatrix = -1;
         _measurementCount = 0;
         _refStar = nullptr;
+        _robustWeight = 1.0;
         _flux = 0;
         _fluxErr = 0;
         _mag = 0;
@@ -110,10 +116,15 @@ public:
     //! Get the astrometric reference star associated with this star.
     const RefStar* getRefStar() const { return _refStar; };
 
+    /// Factor applied to the weight of the reference term of this star by a robust fit.
+    double getRobustWeight() const { return _robustWeight; }
+    void setRobustWeight(double robustWeight) { _robustWeight = robustWeight; }
+
 private:
     unsigned _indexInMatrix;
     int _measurementCount;
     const RefStar* _refStar;
+    double _robustWeight;
 };
 
 /****** FittedStarList */
@@ -25,12 +25,24 @@
 #ifndef LSST_JOINTCAL_FITTER_BASE_H
 #define LSST_JOINTCAL_FITTER_BASE_H
 
+#include <algorithm>
+#include <functional>
+#include <memory>
+#include <vector>
+
 #include "lsst/log/Log.h"
 #include "lsst/jointcal/Associations.h"
+#include "lsst/jointcal/BlockJacobiPreconditioner.h"
+#include "lsst/jointcal/BorderedSystem.h"
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/FittedStar.h"
+#include "lsst/jointcal/FitterScratch.h"
+#include "lsst/jointcal/HessianAssembler.h"
+#include "lsst/jointcal/HessianComponents.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/SchurComplement.h"
+#include "lsst/jointcal/StageMetrics.h"
 #include "lsst/jointcal/Tripletlist.h"
 
 namespace lsst {
@@ -44,6 +56,102 @@ enum class MinimizeResult {
     NonFinite       // non-finite chi2 statistic
 };
 
+/// How minimize() solves the normal equations.
+enum class SolverMode {
+    Direct,            // factorize the full Hessian
+    SchurComplement,   // eliminate the FittedStar parameters, and factorize the reduced (model) system
+    ConjugateGradient  // preconditioned conjugate gradient, never storing the Hessian
+};
+
+/// Fill-reducing ordering of the Hessian factorized by minimize().
+enum class HessianOrdering {
+    Default,           // cholmod's choice: AMD, or METIS if AMD fills too much and METIS is installed
+    AMD,               // approximate minimum degree
+    NestedDissection,  // METIS nested dissection (AMD if cholmod was built without METIS)
+    StarsFirst         // the FittedStar parameters, then the model and global parameters
+};
+
+/**
+ * Cost of factorizing the Hessian with one fill-reducing ordering, from its symbolic analysis.
+ *
+ * @see FitterBase::compareOrderings
+ */
+struct OrderingCost {
+    OrderingCost()
+            : ordering(HessianOrdering::Default),
+              available(false),
+              factorNonZeros(0),
+              factorizationFlops(0),
+              analysisSeconds(0) {}
+
+    HessianOrdering ordering;
+    bool available;             // false if the ordering could not be computed (e.g. METIS is missing)
+    double factorNonZeros;      // non-zeros of the Cholesky factor
+    double factorizationFlops;  // floating point operations of a numerical factorization
+    double analysisSeconds;     // time to compute the ordering and the symbolic analysis
+};
+
+/// Influence function of the robust (iteratively reweighted) mode of FitterBase::minimize().
+enum class RobustLoss {
+    Quadratic,  // plain least squares
+    Huber,      // weight 1 up to the scale, then scale/residual
+    Cauchy      // weight 1/(1 + (residual/scale)^2)
+};
+
+/// One trial step of the Levenberg-Marquardt mode of FitterBase::minimize().
+struct DampingTrial {
+    DampingTrial(double damping_, double predictedReduction_, double actualReduction_, bool accepted_)
+            : damping(damping_),
+              predictedReduction(predictedReduction_),
+              actualReduction(actualReduction_),
+              accepted(accepted_) {}
+
+    double damping;             // relative increase of the Hessian diagonal
+    double predictedReduction;  // chi2 reduction predicted by the damped quadratic model
+    double actualReduction;     // chi2 reduction actually obtained
+    bool accepted;
+};
+
+/**
+ * Predicted size of the least-squares problem for a given whatToFit, to plan the memory of a fit before
+ * anything is allocated. See FitterBase::computeProblemSize().
+ *
+ * The Jacobian counts are those of the triplets produced by leastSquareDerivatives(), except for the
+ * derivatives that happen to be exactly 0 and for the measurements dropped for invalid errors. The Hessian
+ * and factor counts are upper bounds of their lower triangle, the latter for an ordering that eliminates
+ * the FittedStar parameters first: the fill-reducing ordering computed by cholmod usually does better.
+ */
+struct ProblemSize {
+    ProblemSize()
+            : nParameters(0),
+              nStarParameters(0),
+              nJacobianColumns(0),
+              nJacobianNonZeros(0),
+              nHessianNonZeros(0),
+              nFactorNonZeros(0) {}
+
+    std::size_t nParameters;      // total number of fitted parameters
+    std::size_t nStarParameters;  // parameters of the FittedStars
+    std::size_t nJacobianColumns;
+    std::size_t nJacobianNonZeros;
+    std::size_t nHessianNonZeros;
+    std::size_t nFactorNonZeros;
+
+    /// Memory of the Jacobian, stored as a TripletList.
+    std::size_t getJacobianBytes() const { return nJacobianNonZeros * sizeof(Trip); }
+
+    /// Memory of the lower triangle of the Hessian, stored as a compressed sparse matrix.
+    std::size_t getHessianBytes() const {
+        return nHessianNonZeros * (sizeof(double) + sizeof(SparseMatrixD::StorageIndex)) +
+               (nParameters + 1) * sizeof(SparseMatrixD::StorageIndex);
+    }
+
+    /// Memory of the numerical values and row indices of the Cholesky factor.
+    std::size_t getFactorBytes() const {
+        return nFactorNonZeros * (sizeof(double) + sizeof(SparseMatrixD::StorageIndex));
+    }
+};
+
 /**
  * Base class for fitters.
  *
@@ -53,7 +161,30 @@ enum class MinimizeResult {
 class FitterBase {
 public:
     explicit FitterBase(std::shared_ptr<Associations> associations)
-            : _associations(associations), _whatToFit(""), _lastNTrip(0), _nParTot(0), _nMeasuredStars(0) {}
+            : _associations(associations),
+              _whatToFit(""),
+              _minimizedWhatToFit(""),
+              _switchingIndices(false),
+              _nParTot(0),
+              _nMeasuredStars(0),
+              _nThreads(1),
+              _solverMode(SolverMode::Direct),
+              _ordering(HessianOrdering::Default),
+              _splitComponents(true),
+              _conjugateGradientTolerance(1e-10),
+              _conjugateGradientMaxIterations(1000),
+              _alternatingTolerance(1e-6),
+              _alternatingMaxIterations(100),
+              _initialDamping(0),
+              _damping(0),
+              _dampingIncrease(2),
+              _robustLoss(RobustLoss::Quadratic),
+              _robustScale(1),
+              _robustMaxIterations(10),
+              _maxDowndateDrift(1e-8),
+              _factorResidual(-1),
+              _linearHessianValid(false),
+              _linearNDowndates(0) {}
 
     /// No copy or move: there is only ever one fitter of a given type.
     FitterBase(FitterBase const &) = delete;
@@ -75,13 +206,19 @@ public:
      * @param[in]  nSigmaCut  How many sigma to reject outliers at. Outlier
      *                        rejection ignored for nSigmaCut=0.
      * @param[in]  doRankUpdate  Use CholmodSimplicialLDLT2.update() to do a fast rank update after outlier
-     *                           removal; otherwise do a slower full recomputation of the matrix.
-     *                           Only matters if nSigmaCut != 0.
-     * @param[in]  doLineSearch  Use boost's brent_find_minima to perform a line search after the gradient
-     *                           solution is found, and apply the scale factor to the computed offsets.
-     *                           The line search is done in the domain [-1, 2], but if the scale factor
-     *                           is far from 1.0, then the problem is likely in a significantly non-linear
-     *                           regime.
+     *                           removal (or, with a supernodal factorization, remove the outliers from the
+     *                           Hessian and refactor it); otherwise do a slower full recomputation of the
+     *                           matrix. Only matters if nSigmaCut != 0. The downdated Hessian is refactored
+     *                           instead when a downdate is estimated to cost more than a factorization, or
+     *                           when the steps solved with the downdated factor are not accurate enough
+     *                           (see setMaxDowndateDrift()).
+     * @param[in]  doLineSearch  Perform a line search after the gradient solution is found, and apply the
+     *                           scale factor to the computed offsets. The chi2 is modeled as a parabola
+     *                           along the step, falling back to boost's brent_find_minima if it is too
+     *                           non-linear. The line search is done in the domain [-1, 2], but if the
+     *                           scale factor is far from 1.0, then the problem is likely in a
+     *                           significantly non-linear regime. Ignored when the steps are damped (see
+     *                           setLevenbergMarquardtDamping()).
      * @param[in] dumpMatrixFile  Write the pre-fit Hessian matrix and gradient to the files with "-mat.txt"
      *                            and "-grad.txt". Be aware, this requires a large increase in memory usage
      *                            to create a dense matrix before writing it; the output file may be large.
@@ -95,6 +232,11 @@ public:
      *
      * @return  Return code describing success/failure of fit.
      *
+     * @note   If the fit is linear (see isLinear()), the Hessian and its factorization are kept at the end of
+     *         minimize() (with the Direct and SchurComplement solvers, without damping nor robust loss), and
+     *         reused by the next minimize() with the same whatToFit, which then only computes the gradient.
+     *         The outliers rejected in between are downdated from it as usual.
+     *
      * @note   When fitting one parameter set by itself (e.g. "Model"), the system is purely linear
      *         (assuming there are no cross-terms in the derivatives, e.g. the SimpleAstrometryModel),
      *         which should result in the optimal chi2 after a single step. This can
@@ -106,8 +248,54 @@ public:
                             bool const doRankUpdate = true, bool const doLineSearch = false,
                             std::string const &dumpMatrixFile = "");
 
+    /**
+     * Minimize the chi2 of whatToFit by alternating closed-form FittedStar updates with model-only fits,
+     * so that the Hessian of the FittedStars and the model together is never built.
+     *
+     * whatToFit is split into its FittedStar parameters (e.g. "Positions", "Fluxes") and its model
+     * parameters (e.g. "Distortions", "Model"). Each iteration then:
+     * - moves every FittedStar to the optimum for the current model: the star-only Hessian is block
+     *   diagonal, so its blocks are accumulated from the streamed Jacobian and each star is solved on its
+     *   own, without any global matrix;
+     * - takes one minimize() step of the model parameters, with the stars fixed.
+     * The iterations stop when the chi2 decreases by less than getAlternatingTolerance() times itself,
+     * or after getAlternatingMaxIterations() iterations. The outliers above nSigmaCut are then rejected
+     * as by minimize(), and the iterations resume, until there are no more outliers.
+     *
+     * The alternation converges linearly, at a rate set by the coupling between stars and model, where
+     * the joint Gauss-Newton step converges quadratically: finishJointly takes a final minimize() of the
+     * full whatToFit (without rejection), which needs the full Hessian.
+     *
+     * If whatToFit only has star or only has model parameters, this is minimize(whatToFit, nSigmaCut,
+     * true, doLineSearch).
+     *
+     * @param whatToFit  The parameters to fit, as given to minimize().
+     * @param nSigmaCut  How many sigma to reject outliers at; 0 to not reject outliers.
+     * @param doLineSearch  Line search the model steps, as minimize() does.
+     * @param finishJointly  Finish with a joint minimize() step of all the parameters.
+     *
+     * @return  Return code describing success/failure of fit, as minimize().
+     */
+    MinimizeResult minimizeAlternating(std::string const &whatToFit, double nSigmaCut = 0,
+                                       bool doLineSearch = false, bool finishJointly = false);
+
+    /// Set the relative chi2 decrease below which minimizeAlternating() stops iterating.
+    void setAlternatingTolerance(double tolerance) { _alternatingTolerance = tolerance; }
+
+    /// Get the relative chi2 decrease below which minimizeAlternating() stops iterating.
+    double getAlternatingTolerance() const { return _alternatingTolerance; }
+
+    /// Set the maximum number of iterations of minimizeAlternating() between outlier rejections.
+    void setAlternatingMaxIterations(unsigned maxIterations) { _alternatingMaxIterations = maxIterations; }
+
+    /// Get the maximum number of iterations of minimizeAlternating() between outlier rejections.
+    unsigned getAlternatingMaxIterations() const { return _alternatingMaxIterations; }
+
     /**
      * Returns the chi2 for the current state.
+     *
+     * The contributions of each CcdImage are computed on getNThreads() threads, and summed pairwise in
+     * CcdImage order, so that the result does not depend on the number of threads.
      */
     Chi2Statistic computeChi2() const;
 
@@ -117,11 +305,40 @@ public:
      * The Jacobian is given as triplets in a sparse matrix, the gradient as a dense vector.
      * The parameters which vary, and their indices, are to be set using  assignIndices.
      *
+     * If getNThreads() > 1, the measurement terms are computed concurrently over contiguous ranges of
+     * CcdImages, each with its own triplets and gradient, which are then merged in CcdImage order.
+     * The Jacobian (and hence the Hessian) is identical to the one obtained serially.
+     *
      * @param      tripletList  tripletList of (row,col,value) representing the Jacobian of the chi2.
      * @param      grad         The gradient of the chi2.
      */
     void leastSquareDerivatives(TripletList &tripletList, Eigen::VectorXd &grad) const;
 
+    /**
+     * Evaluates the chi2 Hessian and gradient for the current whatToFit setting.
+     *
+     * Unlike the TripletList version, the Jacobian is never stored: the Jacobian columns of each CcdImage
+     * are folded into the Hessian as soon as they are computed (see HessianAssembler), so memory scales
+     * with the number of non-zeros in the Hessian. Its sparsity pattern is cached between calls
+     * with the same whatToFit, and only the values are refilled. The result is bit-identical for any
+     * getNThreads() (see setNThreads()).
+     *
+     * @param[out] hessian  The lower triangle of the Hessian (J*J^T) of the chi2.
+     * @param[out] grad  The gradient of the chi2.
+     */
+    void leastSquareDerivatives(SparseMatrixD &hessian, Eigen::VectorXd &grad);
+
+    /**
+     * Predict the size of the Jacobian, Hessian and Cholesky factor of a fit of whatToFit.
+     *
+     * Only counts the parameters and the valid measurements: no derivative is computed, and nothing the
+     * size of the Jacobian is allocated, so this is cheap compared to a minimize() step.
+     *
+     * @param[in]  whatToFit  See child method assignIndices for valid string values; the indices of the
+     *                        current setting are restored afterwards.
+     */
+    ProblemSize computeProblemSize(std::string const &whatToFit);
+
     /**
      * Offset the parameters by the requested quantities. The used parameter
      * layout is the one from the last call to assignIndices or minimize(). There
@@ -132,6 +349,22 @@ public:
      */
     virtual void offsetParams(Eigen::VectorXd const &delta) = 0;
 
+    /**
+     * Copy the current values of the fitted parameters, in the layout of the last call to assignIndices or
+     * minimize().
+     *
+     * Passing the copy to setParameters() later restores this state exactly (unlike offsetting the
+     * parameters back), e.g. to roll back a fit step that increased the chi2.
+     */
+    virtual Eigen::VectorXd getParameters() const = 0;
+
+    /**
+     * Set the fitted parameters to values copied by getParameters() with the same whatToFit.
+     *
+     * @param[in]  parameters  vector of values to set
+     */
+    virtual void setParameters(Eigen::VectorXd const &parameters) = 0;
+
     /**
      * Set parameters to fit and assign indices in the big matrix.
      *
@@ -139,6 +372,9 @@ public:
      */
     virtual void assignIndices(std::string const &whatToFit) = 0;
 
+    /// The whatToFit of the last call to assignIndices, which sets the layout of getParameters().
+    std::string const &getWhatToFit() const { return _whatToFit; }
+
     /**
      * Save the full chi2 term per star that was used in the minimization, for debugging.
      *
@@ -149,13 +385,306 @@ public:
      */
     virtual void saveChi2Contributions(std::string const &baseName) const;
 
+    /**
+     * Set the number of threads used to compute the derivatives and the chi2.
+     *
+     * The Hessian and gradient are accumulated over fixed chunks of contiguous CcdImages, the same whatever
+     * the number of threads: each thread sums one chunk at a time, and the chunk sums are added in chunk
+     * order, so that they are bit-identical for any number of threads, as are the chi2 and the Jacobian.
+     * Only the split of the Hessian into one part per thread (see setSplitComponents()) and the products
+     * of the conjugate gradient solver depend on it, through rounding.
+     *
+     * @param nThreads  Number of threads; 1 (the default) computes everything on the calling thread.
+     */
+    void setNThreads(unsigned nThreads) { _nThreads = std::max(nThreads, 1u); }
+
+    /// Get the number of threads used to compute the derivatives and the chi2.
+    unsigned getNThreads() const { return _nThreads; }
+
+    /**
+     * Set the kernel used to factorize the Hessian.
+     *
+     * CholmodMode::SupernodalLLT is meant for large Hessians with dense blocks (e.g. many chips coupled
+     * across visits), but cannot be rank updated: with doRankUpdate, outliers are then removed from the
+     * Hessian, which is numerically refactored. See getFactorizationModeUsed() for the kernel cholmod
+     * actually used. Its gain has not been measured (see examples/benchmark_factorization.sh), so the
+     * default stays CholmodMode::SimplicialLDLT.
+     */
+    void setFactorizationMode(CholmodMode mode) {
+        _cholesky.setMode(mode);
+        _linearHessianValid = false;
+    }
+
+    /// Get the kernel used to factorize the Hessian.
+    CholmodMode getFactorizationMode() const { return _cholesky.getMode(); }
+
+    /**
+     * Get the kernel of the last factorization of the whole (unsplit) Hessian: SimplicialLDLT if cholmod
+     * was built without supernodal support, whatever the requested mode.
+     */
+    CholmodMode getFactorizationModeUsed() const { return _cholesky.getModeUsed(); }
+
+    /**
+     * Set the fill-reducing ordering of the Hessian factorization.
+     *
+     * HessianOrdering::StarsFirst eliminates the FittedStar blocks first, as SolverMode::SchurComplement
+     * does: the model block of the factor is then dense, so the order of the model parameters does not
+     * matter. The independent components of a split Hessian (see setSplitComponents()) each put their
+     * own stars first. With SolverMode::SchurComplement, whose factorized system has no star parameters,
+     * it falls back to AMD, with a warning.
+     */
+    void setOrdering(HessianOrdering ordering) {
+        _ordering = ordering;
+        _linearHessianValid = false;
+    }
+
+    /// Get the fill-reducing ordering of the Hessian factorization.
+    HessianOrdering getOrdering() const { return _ordering; }
+
+    /**
+     * Set the accuracy required from the steps solved with a rank-downdated factor.
+     *
+     * After outliers were downdated from the factor, the relative residual of the normal equations
+     * |H*delta - grad|/|grad| of each step is compared with maxDrift, or with 100 times the residual of the
+     * first step solved after the last factorization if that is larger, so that an ill-conditioned Hessian,
+     * whose fresh factor is no more accurate than that, is not refactored after every downdate. Above it,
+     * the downdated Hessian is refactored and the step solved again.
+     */
+    void setMaxDowndateDrift(double maxDrift) { _maxDowndateDrift = maxDrift; }
+
+    /// Get the accuracy required from the steps solved with a rank-downdated factor.
+    double getMaxDowndateDrift() const { return _maxDowndateDrift; }
+
+    /**
+     * Set the maximum number of dense parameters kept out of the factorized Hessian (see BorderedSystem).
+     *
+     * Global parameters, such as the refraction coefficients (coupled to every measurement) or the chip
+     * parameters of a constrained model, make whole rows of the factor dense. Up to maxBorder of them,
+     * the densest among those of getDenseBorderCandidates(), are solved as a small dense border of the
+     * factorized system (full, or reduced by SolverMode::SchurComplement), so that the factorization only
+     * sees the sparse rest. With SolverMode::Direct, the factor of that rest is still rank updated when
+     * outliers are removed. 0 factorizes the whole system.
+     */
+    void setMaxDenseBorder(unsigned maxBorder) {
+        _borderedSystem.setMaxBorder(maxBorder);
+        _linearHessianValid = false;
+    }
+
+    /// Get the maximum number of dense parameters kept out of the factorized Hessian.
+    unsigned getMaxDenseBorder() const { return _borderedSystem.getMaxBorder(); }
+
+    /// Number of dense parameters kept out of the last factorization.
+    unsigned getDenseBorderSize() const { return _borderedSystem.getNBorder(); }
+
+    /**
+     * Set whether the independent parts of the factorized system are factorized and solved separately.
+     *
+     * Disjoint groups of visits (sharing no FittedStar nor mapping) make the Hessian block diagonal. With
+     * getNThreads() > 1, its connected components are then found from its sparsity pattern, merged into
+     * at most one part per thread, and each part is factorized and solved on its own, concurrently. The
+     * factors cannot be rank updated: outliers are then removed by refactoring. A dense border (see
+     * setMaxDenseBorder()) connects all the parameters, so the system is not split when it has one.
+     *
+     * Whether split or not, minimize() warns about the components that fit both FittedStars and model
+     * parameters without any reference star, whose parameters are degenerate.
+     */
+    void setSplitComponents(bool split) {
+        _splitComponents = split;
+        _linearHessianValid = false;
+    }
+
+    /// Get whether the independent parts of the factorized system are factorized separately.
+    bool getSplitComponents() const { return _splitComponents; }
+
+    /// Number of independent parts factorized separately by the last factorization; 0 if not split.
+    std::size_t getNComponents() const { return _components.getNComponents(); }
+
+    /**
+     * Compute the cost of factorizing the full Hessian with each fill-reducing ordering.
+     *
+     * Assembles the Hessian for whatToFit, then runs the symbolic analysis of each ordering with the
+     * current factorization mode, without factorizing. Use it to pick the fastest ordering for a camera
+     * and a set of visits.
+     *
+     * @param whatToFit  The parameters to fit, as given to minimize().
+     * @return  The costs of all the orderings, in the order of HessianOrdering.
+     */
+    std::vector<OrderingCost> compareOrderings(std::string const &whatToFit);
+
+    /**
+     * Set how minimize() solves the normal equations.
+     *
+     * With SolverMode::SchurComplement, the FittedStar parameters, whose blocks of the Hessian are
+     * independent of each other, are eliminated analytically: only the system of the model parameters
+     * (mappings, refraction) is factorized, and the star offsets are obtained by back-substitution.
+     * This mode never uses rank updates: outliers are removed from the Hessian, which is then reduced and
+     * numerically refactored.
+     *
+     * With SolverMode::ConjugateGradient, the Hessian is never built: the normal equations are solved by
+     * block-Jacobi preconditioned conjugate gradient, and each product of the Hessian with a vector is
+     * computed from the Jacobian, streamed one CcdImage at a time. Memory then only scales with the number
+     * of parameters, at the cost of recomputing the derivatives at each iteration, and of an approximate
+     * solution (see setConjugateGradientTolerance()). The dumpMatrixFile argument of minimize() is ignored.
+     */
+    void setSolverMode(SolverMode mode) {
+        _solverMode = mode;
+        _linearHessianValid = false;
+    }
+
+    /// Get how minimize() solves the normal equations.
+    SolverMode getSolverMode() const { return _solverMode; }
+
+    /**
+     * Set the convergence criterion of SolverMode::ConjugateGradient.
+     *
+     * @param tolerance  The iterations stop when the norm of the residual of the normal equations is
+     *                   below tolerance times the norm of the gradient.
+     */
+    void setConjugateGradientTolerance(double tolerance) { _conjugateGradientTolerance = tolerance; }
+
+    /// Get the convergence criterion of SolverMode::ConjugateGradient.
+    double getConjugateGradientTolerance() const { return _conjugateGradientTolerance; }
+
+    /**
+     * Set the maximum number of iterations of SolverMode::ConjugateGradient.
+     *
+     * Each iteration recomputes the whole Jacobian. If the tolerance is not reached, the last iterate is
+     * used as the step.
+     */
+    void setConjugateGradientMaxIterations(unsigned maxIterations) {
+        _conjugateGradientMaxIterations = maxIterations;
+    }
+
+    /// Get the maximum number of iterations of SolverMode::ConjugateGradient.
+    unsigned getConjugateGradientMaxIterations() const { return _conjugateGradientMaxIterations; }
+
+    /**
+     * Set the initial damping of the Levenberg-Marquardt steps of minimize(); 0 (the default) takes
+     * plain Gauss-Newton steps.
+     *
+     * With a positive damping, each step solves (H + damping*diag(H)) delta = grad. The step is only
+     * applied if it reduces the chi2: the damping then decreases according to the ratio of the actual
+     * to the predicted reduction. Otherwise the step is undone and retried with a larger damping,
+     * refactoring the damped Hessian without reassembling it nor redoing its symbolic analysis.
+     * The damping reached is carried over to the next minimize() with the same whatToFit. If no damping
+     * reduces the chi2 after 10 trials, minimize() returns MinimizeResult::Chi2Increased with the
+     * parameters unchanged, and the damping is reset to its initial value.
+     * The doLineSearch argument of minimize() is then ignored, and the outliers are always removed by
+     * refactoring. Not supported by SolverMode::ConjugateGradient, which ignores the damping.
+     */
+    void setLevenbergMarquardtDamping(double damping) { _initialDamping = _damping = damping; }
+
+    /// Get the initial damping of the Levenberg-Marquardt steps of minimize().
+    double getLevenbergMarquardtDamping() const { return _initialDamping; }
+
+    /// The Levenberg-Marquardt trial steps of the last call to minimize(), in order.
+    std::vector<DampingTrial> const &getDampingHistory() const { return _dampingHistory; }
+
+    /**
+     * Set the robust loss of minimize(), which then down-weights the terms with large residuals instead
+     * of (or before) rejecting them.
+     *
+     * With a loss other than RobustLoss::Quadratic, minimize() iteratively reweights the least squares: the
+     * weight of each measurement and reference term is multiplied by the influence function of its
+     * normalized residual (the square root of its chi2 contribution), then the system is solved again,
+     * until no weight changes by more than 1e-2 or after getRobustMaxIterations() solves. The Hessian
+     * keeps its sparsity pattern, so only the numerical factorization is redone. The outliers above
+     * nSigmaCut, if any, are then rejected as usual, on their unweighted chi2, and the weights updated
+     * again. The chi2 reported by computeChi2() is unweighted; the final weights are available from
+     * MeasuredStar::getRobustWeight() and FittedStar::getRobustWeight().
+     *
+     * The robust steps are not damped nor line searched, as these judge the steps with the unweighted
+     * chi2.
+     *
+     * @param loss  The influence function; RobustLoss::Quadratic resets all the weights to 1.
+     * @param scale  Normalized residual beyond which the terms are down-weighted, e.g. 1.345 for Huber,
+     *               2.385 for Cauchy (95% efficiency for gaussian residuals).
+     */
+    void setRobustLoss(RobustLoss loss, double scale = 1.345);
+
+    /// Get the robust loss of minimize().
+    RobustLoss getRobustLoss() const { return _robustLoss; }
+
+    /// Get the scale of the robust loss of minimize().
+    double getRobustScale() const { return _robustScale; }
+
+    /// Set the maximum number of reweighted solves per minimize() with a robust loss.
+    void setRobustMaxIterations(unsigned maxIterations) { _robustMaxIterations = maxIterations; }
+
+    /// Get the maximum number of reweighted solves per minimize() with a robust loss.
+    unsigned getRobustMaxIterations() const { return _robustMaxIterations; }
+
+    /**
+     * Number of work buffers allocated or grown during the last minimize().
+     *
+     * The gradients, Jacobian chunks, Hessian accumulators and chi2 lists of the passes over the data are
+     * kept between passes and between minimize() calls, so this is 0 once they have grown to the size of
+     * the problem.
+     */
+    std::size_t getNScratchAllocations() const {
+        return _scratch.getNAllocations() + _hessianAssembler.getNAllocations();
+    }
+
+    /// Memory held by the work buffers kept between minimize() calls, in bytes.
+    std::size_t getScratchBytes() const { return _scratch.getBytes() + _hessianAssembler.getBytes(); }
+
+    /// Free the work buffers kept between minimize() calls, e.g. once the fit is done.
+    void releaseScratch() {
+        _scratch.release();
+        _hessianAssembler.release();
+    }
+
+    /**
+     * Performance counters of the minimize() and minimizeAlternating() calls since the fitter was created
+     * or resetMetrics() was called: time, Jacobian, Hessian and factor sizes, factorizations, rank updates
+     * and outliers.
+     */
+    StageMetrics const &getMetrics() const { return _metrics; }
+
+    /// Reset the counters of getMetrics(), e.g. to measure one fit step.
+    void resetMetrics() { _metrics = StageMetrics(); }
+
 protected:
     std::shared_ptr<Associations> _associations;
     std::string _whatToFit;
+    // whatToFit of the last minimize(), which the cached Hessian pattern, damping and linear Hessian are for.
+    std::string _minimizedWhatToFit;
+    bool _switchingIndices;  // the indices are switched back and forth: assignIndices() logs at debug level
 
-    int _lastNTrip;  // last triplet count, used to speed up allocation
     unsigned int _nParTot;
     unsigned _nMeasuredStars;
+    unsigned _nThreads;  // number of threads used for the derivatives and chi2
+    SolverMode _solverMode;
+    HessianOrdering _ordering;
+    HessianAssembler _hessianAssembler;  // caches the Hessian sparsity pattern between passes
+    mutable FitterScratch _scratch;      // work buffers of the passes over the data
+    // Kept between minimize() calls, so that the symbolic analysis can be reused if the pattern is unchanged.
+    CholmodSimplicialLDLT2<SparseMatrixD> _cholesky;
+    SchurComplement _schurComplement;  // used with SolverMode::SchurComplement
+    BorderedSystem _borderedSystem;    // dense parameters solved apart from the factorized system
+    bool _splitComponents;
+    HessianComponents _components;  // of the factorized system, if split
+    std::vector<std::unique_ptr<CholmodSimplicialLDLT2<SparseMatrixD>>> _componentCholesky;
+    double _conjugateGradientTolerance;
+    unsigned _conjugateGradientMaxIterations;
+    BlockJacobiPreconditioner _preconditioner;      // used with SolverMode::ConjugateGradient
+    BlockJacobiPreconditioner _starPreconditioner;  // the FittedStar blocks of minimizeAlternating()
+    double _alternatingTolerance;
+    unsigned _alternatingMaxIterations;
+    double _initialDamping;  // Levenberg-Marquardt damping given by the user; 0 for Gauss-Newton steps
+    double _damping;         // current Levenberg-Marquardt damping
+    double _dampingIncrease;  // factor applied to _damping at the next rejected step
+    std::vector<DampingTrial> _dampingHistory;
+    RobustLoss _robustLoss;
+    double _robustScale;
+    unsigned _robustMaxIterations;
+    double _maxDowndateDrift;
+    double _factorResidual;  // relative residual of a step solved with the last factor; -1 if not measured
+    // Hessian of a linear fit, kept with its factorization in _cholesky for the next minimize().
+    SparseMatrixD _linearHessian;
+    bool _linearHessianValid;
+    unsigned _linearNDowndates;  // downdates applied to the kept factorization
+    mutable StageMetrics _metrics;  // also counts the Jacobians computed by the const passes
 
     // lsst.logging instance, to be created by subclass so that messages have consistent name while fitting.
     LOG_LOGGER _log;
@@ -197,11 +726,62 @@ protected:
     /// Remove refStar outliers from the fit. No Refit done.
     void removeRefOutliers(FittedStarList &outliers);
 
+    /**
+     * Return the number of parameters of fittedStar for the current whatToFit; they start at
+     * fittedStar.getIndexInMatrix(), and are only coupled to the parameters of other FittedStars through
+     * the model parameters.
+     */
+    virtual unsigned getNParFittedStar(FittedStar const &fittedStar) const = 0;
+
+    /**
+     * Return whether the chi2 is quadratic in the parameters of the current whatToFit, i.e. whether its
+     * Hessian is independent of the parameter values.
+     */
+    virtual bool isLinear() const = 0;
+
+    /**
+     * Return the indices of the global parameters of the current whatToFit, coupled to a large part of
+     * the others (e.g. the refraction coefficients): the only ones that may be kept out of the factorized
+     * Hessian by setMaxDenseBorder().
+     */
+    virtual std::vector<unsigned> getDenseBorderCandidates() const { return {}; }
+
+    /**
+     * Split whatToFit into the words that select FittedStar parameters and the others, which select
+     * model parameters, for minimizeAlternating().
+     */
+    virtual void splitWhatToFit(std::string const &whatToFit, std::string &starWhatToFit,
+                                std::string &modelWhatToFit) const = 0;
+
+    /**
+     * Split the space-separated words of whatToFit into those in starWords and the others, for
+     * splitWhatToFit().
+     */
+    static void _splitWords(std::string const &whatToFit, std::vector<std::string> const &starWords,
+                            std::string &starWhatToFit, std::string &modelWhatToFit);
+
+    /**
+     * Set the parameter blocks of the FittedStars for _updateFittedStars(). The current whatToFit must only
+     * select FittedStar parameters; the blocks stay valid as long as that layout does not change.
+     */
+    void _setFittedStarBlocks();
+
+    /**
+     * Move each FittedStar to the minimum of the chi2 for the current model, with a Gauss-Newton step
+     * solved star by star. The current whatToFit must be the one given to the last _setFittedStarBlocks().
+     */
+    void _updateFittedStars();
+
     /// Set the indices of a measured star from the full matrix, for outlier removal.
     virtual void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                           std::vector<unsigned> &indices) const = 0;
 
-    /// Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for measurements.
+    /**
+     * Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for measurements.
+     *
+     * May be called concurrently for disjoint ccdImageLists (with different accumulators), and
+     * concurrently with accumulateStatRefStars().
+     */
     virtual void accumulateStatImageList(CcdImageList const &ccdImageList, Chi2Accumulator &accum) const = 0;
 
     /// Compute the chi2 (per star or total, depending on which Chi2Accumulator is used) for RefStars.
@@ -210,28 +790,212 @@ protected:
     /**
      * Compute the derivatives of the measured stars and model for one CcdImage.
      *
-     * The last argument will process a sub-list for outlier removal.
+     * The gradient is accumulated in grad, unless it is null: the Hessian products of the conjugate
+     * gradient solver only need the Jacobian. The last argument will process a sub-list for outlier
+     * removal.
      */
     virtual void leastSquareDerivativesMeasurement(
-            CcdImage const &ccdImage, TripletList &tripletList, Eigen::VectorXd &grad,
+            CcdImage const &ccdImage, TripletList &tripletList, Eigen::VectorXd *grad,
             MeasuredStarList const *measuredStarList = nullptr) const = 0;
 
-    /// Compute the derivatives of the reference terms
+    /// Compute the derivatives of the reference terms, accumulating the gradient in grad unless it is null.
     virtual void leastSquareDerivativesReference(FittedStarList const &fittedStarList,
-                                                 TripletList &tripletList, Eigen::VectorXd &grad) const = 0;
+                                                 TripletList &tripletList, Eigen::VectorXd *grad) const = 0;
+
+    /// Sizes accumulated by countDerivativesMeasurement() and countDerivativesReference().
+    struct DerivativesCount {
+        DerivativesCount() : nColumns(0), nNonZeros(0), nStarModelPairs(0), nModelModelPairs(0) {}
+
+        std::size_t nColumns;          // Jacobian columns
+        std::size_t nNonZeros;         // Jacobian triplets
+        std::size_t nStarModelPairs;   // (FittedStar, model) parameter pairs coupled by the measurements
+        std::size_t nModelModelPairs;  // (model, model) pairs coupled by each CcdImage, lower triangle
+    };
+
+    /**
+     * Count, without computing them, the derivatives that leastSquareDerivativesMeasurement() would
+     * produce for ccdImage with the current whatToFit.
+     */
+    virtual void countDerivativesMeasurement(CcdImage const &ccdImage, DerivativesCount &count) const = 0;
+
+    /// Count the derivatives that leastSquareDerivativesReference() would produce for all FittedStars.
+    virtual void countDerivativesReference(DerivativesCount &count) const = 0;
 
 private:
+    /// minimize(), without timing it, so that minimizeAlternating() is timed as one call.
+    MinimizeResult _minimize(std::string const &whatToFit, double nSigmaCut, bool doRankUpdate,
+                             bool doLineSearch, std::string const &dumpMatrixFile);
+
+    /**
+     * Called with each chunk of the Jacobian computed by _streamDerivatives(): the accumulation slot, the
+     * index of the CcdImage in the CcdImageList (the number of CcdImages for the reference terms), and the
+     * Jacobian triplets, with columns starting at 0.
+     */
+    using JacobianVisitor = std::function<void(std::size_t, std::size_t, TripletList const &)>;
+
+    /// Called by _streamDerivatives() after each wave of ranges, with the number of slots the wave filled.
+    using WaveFolder = std::function<void(std::size_t)>;
+
+    /**
+     * Fill chi2List with the chi2 contributions of the measurement and reference terms, computing them on
+     * getNThreads() threads.
+     *
+     * The record indices are global: the measurements of each CcdImage, in CcdImageList order, are
+     * numbered from the corresponding entry of firstIndex; the reference terms, numbered in FittedStarList
+     * order, start at firstIndex.back().
+     *
+     * @param[out] chi2List  The chi2 contributions, in no particular order.
+     * @param[out] firstIndex  Global index of the first measurement of each CcdImage, followed by that of
+     *                         the first reference term.
+     *
+     * @throws lsst::pex::exceptions::LengthError if the indices do not fit in 32 bits.
+     */
+    void _accumulateChi2List(Chi2List &chi2List, std::vector<std::size_t> &firstIndex) const;
+
+    /// Split the CcdImageList into one contiguous range per thread, each with similar number of measurements.
+    std::vector<CcdImageList> _getCcdImageRanges() const;
+
+    /**
+     * Split the CcdImageList into contiguous chunks with similar numbers of measurements, whose boundaries
+     * do not depend on the number of threads, for the sums that must not either.
+     */
+    std::vector<CcdImageList> _getCcdImageChunks() const;
+
+    /**
+     * Compute the Jacobian of each CcdImage (concurrently over ranges) then of the reference terms, passing
+     * each to visit() as soon as it is computed; the Jacobian is never stored as a whole.
+     *
+     * Without fold, all the ranges are computed at once and the slot of a CcdImage is the index of its
+     * range. With fold, the ranges are computed in waves of getNThreads() ranges, the slot of a CcdImage is
+     * the position of its range in its wave, and fold() is called after each wave, once its slots are
+     * filled, to add them up and empty them for the next wave.
+     *
+     * @param ranges  Ranges of CcdImages; the reference terms go to the slot of the last range.
+     * @param[out] grads  The gradient accumulated by each slot; must hold a vector of _nParTot per slot.
+     *                    If null, the gradient is not computed.
+     * @param visit  Called with each chunk of the Jacobian; calls for different slots may be concurrent.
+     * @param fold  Called after each wave with the number of slots it filled, or empty.
+     */
+    void _streamDerivatives(std::vector<CcdImageList> const &ranges, std::vector<Eigen::VectorXd> *grads,
+                            JacobianVisitor const &visit, WaveFolder const &fold = WaveFolder()) const;
+
+    /// Compute the gradient only, streaming the Jacobian without storing it.
+    void _computeGradient(Eigen::VectorXd &grad) const;
+
+    /**
+     * Compute the gradient and the block-Jacobi preconditioner for SolverMode::ConjugateGradient.
+     *
+     * The blocks are the parameters of each FittedStar (see getNParFittedStar()) and, for the others, the
+     * sets of parameters that appear in the Jacobian of exactly the same CcdImages the same number of
+     * times, i.e. the parameters of each mapping.
+     */
+    void _prepareConjugateGradient(Eigen::VectorXd &grad);
+
+    /// Return hessian * vector, streaming the Jacobian for the current whatToFit.
+    Eigen::VectorXd _multiplyHessian(std::vector<CcdImageList> const &ranges,
+                                     Eigen::VectorXd const &vector) const;
+
+    /**
+     * Solve hessian * delta = grad by preconditioned conjugate gradient.
+     *
+     * @return false if the iterations broke down (non-finite values).
+     */
+    bool _solveConjugateGradient(Eigen::VectorXd const &grad, Eigen::VectorXd &delta) const;
+
+    /**
+     * Prepare to solve the system with the given hessian, according to the solver mode.
+     *
+     * @return false if the factorization failed.
+     */
+    bool _prepareSolver(SparseMatrixD const &hessian);
+
+    /**
+     * Factorize matrix (full or reduced Hessian), splitting off its dense border if it has one.
+     *
+     * @param matrix  Lower triangle of the system to factorize.
+     * @param candidates  Indices in matrix of the parameters that may be in the border.
+     *
+     * @return false if the factorization failed.
+     */
+    bool _factorizeSystem(SparseMatrixD const &matrix, std::vector<unsigned> const &candidates);
+
+    /**
+     * Factorize each of the _components of matrix on its own, concurrently.
+     *
+     * @return false if a factorization failed.
+     */
+    bool _factorizeComponents(SparseMatrixD const &matrix);
+
+    /// Log the connected components of the full hessian, warning about those without reference stars.
+    void _reportComponents(SparseMatrixD const &hessian) const;
+
+    /// Solve the system factorized by the last _factorizeSystem() for rhs.
+    Eigen::VectorXd _solveSystem(Eigen::VectorXd const &rhs) const;
+
+    /**
+     * Solve hessian * delta = grad, for the hessian given to the last _prepareSolver() (or the current one,
+     * with SolverMode::ConjugateGradient).
+     *
+     * @return false if the solution failed.
+     */
+    bool _solve(Eigen::VectorXd const &grad, Eigen::VectorXd &delta);
+
+    /**
+     * Set the robust weight of each measurement and reference term from its current residual, see
+     * setRobustLoss().
+     *
+     * @return The largest change of a weight.
+     */
+    double _updateRobustWeights();
+
+    /**
+     * Take a Levenberg-Marquardt step (see setLevenbergMarquardtDamping()), retrying with an increasing
+     * damping until the chi2 decreases; the parameters are left unchanged if it never does.
+     *
+     * @param[in] hessian  The lower triangle of the undamped Hessian.
+     * @param[in] grad  The gradient of the chi2.
+     * @param[in,out] chi2  The chi2 at the current parameters, replaced by the one after the step.
+     *
+     * @return Converged if a step was taken, Chi2Increased if no damping reduced the chi2 (the damping is
+     *         then reset to its initial value), Failed if a factorization or solution failed.
+     */
+    MinimizeResult _dampedStep(SparseMatrixD const &hessian, Eigen::VectorXd const &grad,
+                               Chi2Statistic &chi2);
+
+    /**
+     * Factorize the hessian into _cholesky, redoing the symbolic analysis only if its sparsity pattern
+     * differs from that of the previous factorization.
+     */
+    void _factorizeHessian(SparseMatrixD const &hessian);
+
+    /**
+     * Set the fill-reducing ordering of cholesky, for a matrix of dimension dim: the full Hessian, its
+     * interior without the dense border, the reduced system of the Schur complement, or the block of the
+     * parameters in component (see HessianComponents::getComponent()).
+     *
+     * @return true if HessianOrdering::StarsFirst was replaced by AMD, for a system without star parameters.
+     */
+    bool _applyOrdering(CholmodSimplicialLDLT2<SparseMatrixD> &cholesky, HessianOrdering ordering,
+                        Eigen::Index dim, std::vector<unsigned> const *component = nullptr) const;
+
     /**
      * Performe a line search along vector delta, returning a scale factor for the minimum.
      *
-     * Note that this offsets and restores the model during each iteration of the line search,
+     * The chi2 is first evaluated at 0 and 1 times delta, and compared with the prediction of the
+     * Gauss-Newton model (which has a slope of -2*grad.delta at 0): if the chi2 is quadratic along delta,
+     * or if the minimum of the parabola through these points improves the chi2, that minimum is
+     * returned. Otherwise, this falls back to boost's brent_find_minima, which needs many more chi2
+     * evaluations.
+     *
+     * Note that this offsets and restores the model during each chi2 evaluation of the line search,
      * as part of the minimization schema.
      *
      * @param delta The vector of offsets that is expected to reach the minimium value.
+     * @param grad The gradient delta was computed from.
      *
      * @return The scale factor to apply to delta that gets it to the true minimum.
      */
-    double _lineSearch(Eigen::VectorXd const &delta);
+    double _lineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad);
 };
 }  // namespace jointcal
 }  // namespace lsst
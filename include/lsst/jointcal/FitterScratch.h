@@ -0,0 +1,118 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_FITTER_SCRATCH_H
+#define LSST_JOINTCAL_FITTER_SCRATCH_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Chi2.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Work buffers of a fitter, kept between its passes over the data so that they are only reallocated when
+ * the problem grows.
+ *
+ * Each getter returns buffers emptied (or zeroed) for a new pass, keeping their storage. Buffers indexed
+ * by slot belong to one range of CcdImages, hence to one thread at a time. The number of allocations
+ * (buffers created or grown) is counted, so that a steady-state fit can be checked not to allocate.
+ */
+class FitterScratch {
+public:
+    FitterScratch() : _nAllocations(0), _chi2ListCapacity(0) {}
+
+    /// No copy: the buffers can be large.
+    FitterScratch(FitterScratch const &) = delete;
+    FitterScratch(FitterScratch &&) = delete;
+    FitterScratch &operator=(FitterScratch const &) = delete;
+    FitterScratch &operator=(FitterScratch &&) = delete;
+
+    /// Gradients of nSlots slots, each of size nPar and set to zero.
+    std::vector<Eigen::VectorXd> &getGradients(std::size_t nSlots, Eigen::Index nPar);
+
+    /// A second set of per-slot vectors like getGradients(), for products computed alongside them.
+    std::vector<Eigen::VectorXd> &getProducts(std::size_t nSlots, Eigen::Index nPar);
+
+    /// Jacobian buffers of nSlots slots; their users clear them before filling them.
+    std::vector<TripletList> &getJacobians(std::size_t nSlots);
+
+    /// Per-slot buffers of Jacobian column projections; their users assign them before use.
+    std::vector<std::vector<double>> &getProjections(std::size_t nSlots);
+
+    /// nLists empty Chi2Lists, to accumulate partial lists concurrently.
+    std::vector<Chi2List> &getPartialChi2Lists(std::size_t nLists);
+
+    /// An empty Chi2List that can hold at least capacity records.
+    Chi2List &getChi2List(std::size_t capacity);
+
+    /// A vector of size nPar, set to zero.
+    Eigen::VectorXi &getCounters(Eigen::Index nPar);
+
+    /// Number of buffers created or grown since the last call to resetNAllocations().
+    std::size_t getNAllocations() const { return _nAllocations + _countGrowth(); }
+
+    /// Restart counting the allocations, e.g. at the start of a minimization.
+    void resetNAllocations();
+
+    /// Memory held by the buffers, in bytes.
+    std::size_t getBytes() const;
+
+    /// Free all the buffers.
+    void release();
+
+private:
+    // Resize vectors to nSlots vectors of size nPar, set to zero.
+    void _resize(std::vector<Eigen::VectorXd> &vectors, std::size_t nSlots, Eigen::Index nPar);
+
+    // The number of slot buffers that grew since their capacities were recorded by _recordCapacities(),
+    // each compared with the capacity recorded for the same slot.
+    std::size_t _countGrowth() const;
+
+    // Count the slot buffers that grew inside the last pass, and record their current capacities.
+    void _recordCapacities();
+
+    std::size_t _nAllocations;
+    std::vector<Eigen::VectorXd> _gradients;
+    std::vector<Eigen::VectorXd> _products;
+    std::vector<TripletList> _jacobians;
+    std::vector<std::vector<double>> _projections;
+    std::vector<Chi2List> _partialChi2Lists;
+    Chi2List _chi2List;
+    Eigen::VectorXi _counters;
+    // Capacities of the buffers that grow while they are filled, per slot of each kind of buffer.
+    std::vector<std::size_t> _jacobianCapacities;
+    std::vector<std::size_t> _projectionCapacities;
+    std::vector<std::size_t> _partialChi2ListCapacities;
+    std::size_t _chi2ListCapacity;
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_FITTER_SCRATCH_H
@@ -0,0 +1,146 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_HESSIAN_ASSEMBLER_H
+#define LSST_JOINTCAL_HESSIAN_ASSEMBLER_H
+
+#include <vector>
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Accumulate the normal-equation matrix H = J*J^T directly from small blocks of Jacobian columns.
+ *
+ * Each call to add() folds the outer products of the Jacobian columns it is given into H, so that the
+ * full Jacobian never has to be stored: memory is proportional to the number of non-zeros in H.
+ * Only the lower triangle of H is stored.
+ *
+ * The sparsity pattern of H is computed on the first pass and cached in CSC form; later passes only
+ * refill the values. If a later pass touches an entry that is not in the cached pattern, the accumulator
+ * concerned falls back to building the matrix from scratch and the pattern is recomputed by finish().
+ *
+ * Contributions can be accumulated concurrently in independent "slots", one per thread. Each fold() adds
+ * the slots to the matrix in slot order and empties them, so that a sequence of fixed chunks of
+ * contributions, dealt to the slots in waves of any size and folded after each wave, always gives the same
+ * matrix, bit for bit: each chunk is summed on its own, and the chunk sums are added in chunk order.
+ *
+ * The storage of the slots is kept between passes, and only freed by release().
+ */
+class HessianAssembler {
+public:
+    HessianAssembler() : _nParTot(0), _totalOnPattern(false), _nAllocations(0) {}
+
+    /// No copy: the cached pattern and accumulators can be large.
+    HessianAssembler(HessianAssembler const &) = delete;
+    HessianAssembler(HessianAssembler &&) = delete;
+    HessianAssembler &operator=(HessianAssembler const &) = delete;
+    HessianAssembler &operator=(HessianAssembler &&) = delete;
+
+    /// Forget the cached sparsity pattern, and set the dimension of the matrices to come.
+    void reset(unsigned nParTot);
+
+    /// Dimension of the assembled matrix.
+    unsigned getNParTot() const { return _nParTot; }
+
+    /// Whether a sparsity pattern is cached.
+    bool hasPattern() const { return !_outerIndex.empty(); }
+
+    /// Start accumulating a new matrix with nSlots independent accumulators.
+    void start(std::size_t nSlots);
+
+    /**
+     * Add the outer products of the Jacobian columns in tripletList to accumulator slot.
+     *
+     * Calls for different slots may run concurrently; calls for the same slot may not.
+     *
+     * @param tripletList  Jacobian entries (parameter index, column, value); columns are counted
+     *                     from 0 up to tripletList.getNextFreeIndex().
+     * @param slot  Accumulator to add to, in [0, nSlots).
+     */
+    void add(TripletList const &tripletList, std::size_t slot);
+
+    /// Add the accumulators [0, nSlots) to the matrix, in slot order, and empty them for the next chunks.
+    void fold(std::size_t nSlots);
+
+    /// Fold the remaining accumulators, cache the resulting pattern and return the lower triangle of H.
+    SparseMatrixD finish();
+
+    /// Number of accumulator buffers created or grown since the last call to resetNAllocations().
+    std::size_t getNAllocations() const { return _nAllocations; }
+
+    /// Restart counting the allocations of the accumulators.
+    void resetNAllocations() { _nAllocations = 0; }
+
+    /// Memory held by the accumulators between passes, in bytes.
+    std::size_t getBytes() const;
+
+    /// Free the accumulators; the cached pattern is kept.
+    void release();
+
+private:
+    using StorageIndex = SparseMatrixD::StorageIndex;
+
+    // One independent accumulator.
+    struct Slot {
+        Slot() : usePattern(false), used(true), capacity(0) {}
+
+        bool usePattern;              // refill _outerIndex/_innerIndex, or build from triplets
+        bool used;                    // whether the slot may hold something since it was last emptied
+        std::vector<double> values;   // values on the cached pattern
+        std::vector<Trip> buffer;     // not yet compressed (row, col, value) entries
+        SparseMatrixD partial;        // compressed entries
+        std::vector<std::size_t> columnStart;  // scratch for the counting sort by Jacobian column
+        std::vector<std::pair<StorageIndex, double>> entries;  // scratch: (row, value) sorted by column
+        std::size_t capacity;  // of buffer, columnStart and entries when the slot was last emptied
+    };
+
+    // Empty slot for a new chunk, keeping its storage.
+    void _clear(Slot &slot);
+
+    // Set values to size zeros, counting an allocation if it has to grow.
+    void _assignZeros(std::vector<double> &values, std::size_t size);
+
+    // Move the values of slot from the cached pattern into its triplet buffer.
+    void _leavePattern(Slot &slot) const;
+
+    // Fold the buffered triplets of slot into its partial matrix.
+    void _compress(Slot &slot) const;
+
+    unsigned _nParTot;
+    std::vector<StorageIndex> _outerIndex;
+    std::vector<StorageIndex> _innerIndex;
+    std::vector<Slot> _slots;
+    bool _totalOnPattern;              // whether the folded sum is in _totalValues or in _total
+    std::vector<double> _totalValues;  // folded sum, on the cached pattern
+    SparseMatrixD _total;              // folded sum, once a slot left the cached pattern
+    std::size_t _nAllocations;
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_HESSIAN_ASSEMBLER_H
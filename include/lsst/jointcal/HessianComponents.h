@@ -0,0 +1,98 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_HESSIAN_COMPONENTS_H
+#define LSST_JOINTCAL_HESSIAN_COMPONENTS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * The connected components of the graph of a Hessian, whose vertices are the parameters and whose edges
+ * are the non-zero off-diagonal entries.
+ *
+ * Disjoint groups of CcdImages, that share no FittedStar nor mapping, give disjoint components: the
+ * Hessian is then block diagonal (up to a permutation), and each block can be factorized and solved on
+ * its own.
+ */
+class HessianComponents {
+public:
+    HessianComponents() : _dim(0) {}
+
+    /**
+     * Find the connected components of matrix.
+     *
+     * @param matrix  Lower triangle of the Hessian.
+     *
+     * @return The number of components.
+     */
+    std::size_t find(SparseMatrixD const &matrix);
+
+    /**
+     * Merge the components into at most maxParts parts of similar numbers of non-zeros, e.g. to factorize
+     * one part per thread rather than many tiny blocks (the Hessian of the FittedStars alone has one
+     * component per star). The parts are then what the other methods call components.
+     */
+    void merge(std::size_t maxParts);
+
+    /// Forget the components, e.g. when the Hessian is not split.
+    void clear();
+
+    /// Number of components found by the last find().
+    std::size_t getNComponents() const { return _components.size(); }
+
+    /// Parameters of component i, in increasing order; the components are sorted by their first parameter.
+    std::vector<unsigned> const &getComponent(std::size_t i) const { return _components[i]; }
+
+    /// Component of parameter index.
+    unsigned getComponentOf(unsigned index) const { return _label[index]; }
+
+    /// Return the lower triangle of the diagonal block of component i of matrix, as given to find().
+    SparseMatrixD extract(SparseMatrixD const &matrix, std::size_t i) const;
+
+    /// Return the entries of component i of the full vector full.
+    Eigen::VectorXd gather(Eigen::VectorXd const &full, std::size_t i) const;
+
+    /// Set the entries of component i of the full vector full to part.
+    void scatter(Eigen::VectorXd const &part, std::size_t i, Eigen::VectorXd &full) const;
+
+private:
+    Eigen::Index _dim;
+    std::vector<unsigned> _label;                    // component of each parameter
+    std::vector<unsigned> _localIndex;               // index of each parameter in its component
+    std::vector<std::vector<unsigned>> _components;  // parameters of each component
+    std::vector<std::size_t> _nonZeros;              // of the lower triangle of each component
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_HESSIAN_COMPONENTS_H
@@ -52,6 +52,7 @@ public:
               _instFluxErr(0.),
               _ccdImage(0),
               _valid(true),
+              _robustWeight(1.0),
               _xFocal(0.0),
               _yFocal(0.0),
               _instMag(0.),
@@ -64,6 +65,7 @@ public:
               _instFluxErr(0.),
               _ccdImage(0),
               _valid(true),
+              _robustWeight(1.0),
               _xFocal(0.0),
               _yFocal(0.0),
               _instMag(0.),
@@ -121,6 +123,10 @@ public:
     //! Fits may use that to discard outliers
     void setValid(bool v) { _valid = v; }
 
+    /// Factor applied to the weight of this measurement by a robust fit (1 if not down-weighted).
+    double getRobustWeight() const { return _robustWeight; }
+    void setRobustWeight(double robustWeight) { _robustWeight = robustWeight; }
+
 private:
     afw::table::RecordId _id;  // id in original catalog
 
@@ -132,6 +138,7 @@ private:
     // Note: _fittedStar is not const, but measuredStar won't modify it.
     std::shared_ptr<FittedStar> _fittedStar;
     bool _valid;
+    double _robustWeight;
 
     double _xFocal, _yFocal;
 
@@ -0,0 +1,75 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_PARALLEL_H
+#define LSST_JOINTCAL_PARALLEL_H
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Call func(iTask) for every iTask in [0, nTasks), spreading the tasks over at most nThreads threads.
+ *
+ * Task iTask always runs on thread (iTask % nThreads), so the work assigned to a thread does not depend
+ * on scheduling. With nThreads <= 1 (or a single task) everything runs on the calling thread.
+ * The first exception thrown by any task is rethrown on the calling thread once all threads have joined.
+ *
+ * @param nTasks  Number of independent tasks.
+ * @param nThreads  Maximum number of threads to use.
+ * @param func  Callable taking a std::size_t task index; must be safe to call concurrently.
+ */
+template <typename Function>
+void parallelFor(std::size_t nTasks, unsigned nThreads, Function const &func) {
+    std::size_t nWorkers = std::min<std::size_t>(nThreads, nTasks);
+    if (nWorkers <= 1) {
+        for (std::size_t iTask = 0; iTask < nTasks; ++iTask) func(iTask);
+        return;
+    }
+    std::vector<std::exception_ptr> errors(nWorkers);
+    auto worker = [&](std::size_t iWorker) {
+        try {
+            for (std::size_t iTask = iWorker; iTask < nTasks; iTask += nWorkers) func(iTask);
+        } catch (...) {
+            errors[iWorker] = std::current_exception();
+        }
+    };
+    std::vector<std::thread> threads;
+    threads.reserve(nWorkers - 1);
+    for (std::size_t iWorker = 1; iWorker < nWorkers; ++iWorker) threads.emplace_back(worker, iWorker);
+    worker(0);
+    for (auto &thread : threads) thread.join();
+    for (auto const &error : errors) {
+        if (error) std::rethrow_exception(error);
+    }
+}
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_PARALLEL_H
@@ -84,6 +84,12 @@ public:
 
     void offsetParams(Eigen::VectorXd const &delta) override;
 
+    /// @copydoc FitterBase::getParameters
+    Eigen::VectorXd getParameters() const override;
+
+    /// @copydoc FitterBase::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /// Return the model being fit.
     std::shared_ptr<PhotometryModel> getModel() const { return _photometryModel; }
 
@@ -106,16 +112,27 @@ private:
 
     void accumulateStatRefStars(Chi2Accumulator &accum) const override;
 
+    unsigned getNParFittedStar(FittedStar const &fittedStar) const override;
+
+    bool isLinear() const override;
+
+    void countDerivativesMeasurement(CcdImage const &ccdImage, DerivativesCount &count) const override;
+
+    void countDerivativesReference(DerivativesCount &count) const override;
+
     void getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
                                   std::vector<unsigned> &indices) const override;
 
+    void splitWhatToFit(std::string const &whatToFit, std::string &starWhatToFit,
+                        std::string &modelWhatToFit) const override;
+
     void leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
-                                           Eigen::VectorXd &grad,
+                                           Eigen::VectorXd *grad,
                                            MeasuredStarList const *measuredStarList = nullptr) const override;
 
     /// Compute the derivatives of the reference terms
     void leastSquareDerivativesReference(FittedStarList const &fittedStarList, TripletList &tripletList,
-                                         Eigen::VectorXd &grad) const override;
+                                         Eigen::VectorXd *grad) const override;
 
 #ifdef STORAGE
     Point transformFittedStar(FittedStar const &fittedStar, AstrometryTransform const *sky2TP,
@@ -182,6 +182,13 @@ public:
     /// @copydoc PhotometryMappingBase::getParameters
     Eigen::VectorXd getParameters() override { return _transform->getParameters(); }
 
+    /**
+     * Set the transform parameters.
+     *
+     * @param[in]   parameters  vector of transform parameters, in the same order as getParameters().
+     */
+    void setParameters(Eigen::VectorXd const &parameters) { _transform->setParameters(parameters); }
+
     /// @copydoc PhotometryMappingBase::getMappingIndices
     void getMappingIndices(std::vector<unsigned> &indices) const override {
         if (indices.size() < getNpar()) indices.resize(getNpar());
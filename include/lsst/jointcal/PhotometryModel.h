@@ -64,6 +64,22 @@ public:
      */
     virtual void offsetParams(Eigen::VectorXd const &delta) = 0;
 
+    /**
+     * Copy the values of the fitted parameters, at the indices given in assignIndices.
+     *
+     * @param[out] parameters  vector of the size of the fit, in which to store the values
+     */
+    virtual void getParameters(Eigen::VectorXd &parameters) const = 0;
+
+    /**
+     * Set the fitted parameters to the provided values, e.g. those saved by getParameters().
+     *
+     * The values are read according to the indices given in assignIndices.
+     *
+     * @param[in]  parameters  vector of values to set
+     */
+    virtual void setParameters(Eigen::VectorXd const &parameters) = 0;
+
     /**
      * Offset the appropriate flux or magnitude (by -delta).
      *
@@ -72,6 +88,12 @@ public:
      */
     virtual void offsetFittedStar(FittedStar &fittedStar, double delta) const = 0;
 
+    /// The flux or magnitude of fittedStar that offsetFittedStar() updates.
+    virtual double getFittedStarValue(FittedStar const &fittedStar) const = 0;
+
+    /// Set the flux or magnitude of fittedStar that offsetFittedStar() updates.
+    virtual void setFittedStarValue(FittedStar &fittedStar, double value) const = 0;
+
     /**
      * Compute the residual between the model applied to a star and its associated fittedStar.
      *
@@ -116,6 +138,13 @@ public:
      */
     virtual void freezeErrorTransform() = 0;
 
+    /**
+     * Return whether computeResidual() is linear in the parameters of this model, with derivatives and
+     * errors that do not depend on them: a fit of this model and of the FittedStars then has a constant
+     * Hessian.
+     */
+    virtual bool isLinear() const { return false; }
+
     /**
      * Get how this set of parameters (of length Npar()) map into the "grand" fit.
      *
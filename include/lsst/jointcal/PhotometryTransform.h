@@ -102,6 +102,9 @@ public:
 
     /// Get a copy of the parameters of this model, in the same order as `offsetParams`.
     virtual Eigen::VectorXd getParameters() const = 0;
+
+    /// Set the parameters of this model, in the same order as `getParameters`.
+    virtual void setParameters(Eigen::VectorXd const &parameters) = 0;
 };
 
 /**
@@ -127,6 +130,9 @@ public:
         return parameters;
     }
 
+    /// @copydoc PhotometryTransform::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override { _value = parameters[0]; }
+
 protected:
     double getValue() const { return _value; }
 
@@ -256,6 +262,9 @@ public:
     /// @copydoc PhotometryTransform::getParameters
     Eigen::VectorXd getParameters() const override;
 
+    /// @copydoc PhotometryTransform::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     ndarray::Size getOrder() const { return _order; }
 
     geom::Box2D getBBox() const { return _bbox; }
@@ -0,0 +1,129 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#ifndef LSST_JOINTCAL_SCHUR_COMPLEMENT_H
+#define LSST_JOINTCAL_SCHUR_COMPLEMENT_H
+
+#include <utility>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/HessianAssembler.h"
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Eliminate small, mutually independent diagonal blocks of parameters (e.g. the FittedStar positions or
+ * fluxes) from the normal equations H * delta = grad by Schur complement.
+ *
+ * Writing the eliminated parameters as "S" and the others (the "model" parameters) as "M", with H_SS
+ * block-diagonal, the reduced system is
+ * @f[
+ *     (H_{MM} - H_{MS} H_{SS}^{-1} H_{SM}) \delta_M = g_M - H_{MS} H_{SS}^{-1} g_S,
+ * @f]
+ * after which @f$ \delta_S = H_{SS}^{-1} (g_S - H_{SM} \delta_M) @f$ block by block.
+ * Only the reduced matrix, whose dimension is the number of model parameters, has to be factorized.
+ *
+ * The reduced matrix is accumulated with a HessianAssembler, so its sparsity pattern is cached between
+ * calls with the same block layout.
+ */
+class SchurComplement {
+public:
+    SchurComplement() : _nParTot(0), _nParReduced(0) {}
+
+    /// No copy: the stored couplings can be large.
+    SchurComplement(SchurComplement const &) = delete;
+    SchurComplement(SchurComplement &&) = delete;
+    SchurComplement &operator=(SchurComplement const &) = delete;
+    SchurComplement &operator=(SchurComplement &&) = delete;
+
+    /**
+     * Define the parameters to eliminate.
+     *
+     * @param nParTot  Total number of parameters.
+     * @param blocks  (first index, number of parameters) of each block to eliminate; blocks must not
+     *                overlap, and the Hessian must not couple two different blocks.
+     */
+    void setBlocks(unsigned nParTot, std::vector<std::pair<unsigned, unsigned>> const &blocks);
+
+    /// Number of parameters that are not eliminated, i.e. the dimension of the reduced system.
+    unsigned getNParReduced() const { return _nParReduced; }
+
+    /// Index of parameter i in the reduced system, or -1 if it is eliminated.
+    int getReducedIndex(unsigned i) const { return _paramBlock[i] < 0 ? _reducedIndex[i] : -1; }
+
+    /**
+     * Eliminate the blocks from hessian.
+     *
+     * @param hessian  Lower triangle of the full Hessian.
+     * @param nThreads  Number of threads to eliminate the blocks with.
+     * @param[out] reduced  Lower triangle of the reduced matrix.
+     *
+     * @return false if a block that is constrained is not positive definite.
+     *
+     * @throws lsst::pex::exceptions::LogicError if hessian couples two different blocks.
+     */
+    bool compute(SparseMatrixD const &hessian, unsigned nThreads, SparseMatrixD &reduced);
+
+    /// Return the right-hand side of the reduced system for the full gradient grad.
+    Eigen::VectorXd reduceGradient(Eigen::VectorXd const &grad) const;
+
+    /**
+     * Return the full solution from the solution of the reduced system.
+     *
+     * @param grad  The full gradient, as given to reduceGradient().
+     * @param reducedDelta  Solution of the reduced system.
+     */
+    Eigen::VectorXd backSubstitute(Eigen::VectorXd const &grad, Eigen::VectorXd const &reducedDelta) const;
+
+private:
+    // One eliminated block, and its coupling to the model parameters.
+    struct Block {
+        unsigned first;            // index of the first parameter in the full system
+        unsigned size;             // number of parameters
+        bool active;               // false if unconstrained (zero diagonal block): left unchanged
+        std::size_t factorOffset;  // into _factors: lower Cholesky factor of the diagonal block
+        std::size_t couplingStart;  // into _coupledIndices
+        std::size_t valueStart;     // into _couplings
+        std::size_t nCoupled;       // number of model parameters this block is coupled to
+    };
+
+    unsigned _nParTot;
+    unsigned _nParReduced;
+    std::vector<std::pair<unsigned, unsigned>> _layout;  // as given to setBlocks
+    std::vector<Block> _blocks;
+    std::vector<int> _paramBlock;       // block of each parameter, or -1 for model parameters
+    std::vector<unsigned> _reducedIndex;  // index of each model parameter in the reduced system
+    std::vector<double> _factors;
+    std::vector<unsigned> _coupledIndices;  // reduced indices, sorted within each block
+    std::vector<double> _couplings;         // row-major (nCoupled x size) H_MS block of each block
+    HessianAssembler _reductionAssembler;   // accumulates H_MS H_SS^-1 H_SM
+};
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_SCHUR_COMPLEMENT_H
@@ -25,7 +25,7 @@
 #ifndef LSST_JOINTCAL_SIMPLE_ASTROMETRY_MAPPING_H
 #define LSST_JOINTCAL_SIMPLE_ASTROMETRY_MAPPING_H
 
-#include <memory>  // for unique_ptr
+#include <memory>  // for shared_ptr
 
 #include "lsst/jointcal/AstrometryMapping.h"
 #include "lsst/jointcal/AstrometryTransform.h"
@@ -44,12 +44,10 @@ public:
     SimpleAstrometryMapping(AstrometryTransform const &astrometryTransform, bool toBeFit = true)
             : toBeFit(toBeFit),
               transform(astrometryTransform.clone()),
-              errorProp(transform),
-              lin(new AstrometryTransformLinear) {
+              errorProp(transform) {
         // in this order:
         // take a copy of the input transform,
         // assign the transformation used to propagate errors to the transform itself
-        // reserve some memory space to compute the derivatives (efficiency).
     }
 
     /// No copy or move: there is only ever one instance of a given mapping (i.e.. per ccd+visit)
@@ -91,17 +89,19 @@ public:
 
     //!
     void positionDerivative(Point const &where, Eigen::Matrix2d &derivative, double epsilon) const {
-        errorProp->computeDerivative(where, *lin, epsilon);
-        derivative(0, 0) = lin->coeff(1, 0, 0);
+        // local, so that this mapping can be shared by concurrent derivative computations.
+        AstrometryTransformLinear lin;
+        errorProp->computeDerivative(where, lin, epsilon);
+        derivative(0, 0) = lin.coeff(1, 0, 0);
         //
         /* This does not work : it was proved by rotating the frame
            see the compilation switch ROTATE_T2 in constrainedAstrometryModel.cc
-        derivative(1,0) = lin->coeff(1,0,1);
-        derivative(0,1) = lin->coeff(0,1,0);
+        derivative(1,0) = lin.coeff(1,0,1);
+        derivative(0,1) = lin.coeff(0,1,0);
         */
-        derivative(1, 0) = lin->coeff(0, 1, 0);
-        derivative(0, 1) = lin->coeff(1, 0, 1);
-        derivative(1, 1) = lin->coeff(0, 1, 1);
+        derivative(1, 0) = lin.coeff(0, 1, 0);
+        derivative(0, 1) = lin.coeff(1, 0, 1);
+        derivative(1, 1) = lin.coeff(0, 1, 1);
     }
 
     //!
@@ -109,6 +109,30 @@ public:
         if (toBeFit) transform->offsetParams(delta);
     }
 
+    //! The fitted parameters (none if not fit), in the same order as offsetParams().
+    Eigen::VectorXd getParameters() const {
+        Eigen::VectorXd parameters(getNpar());
+        if (toBeFit) transform->getParams(parameters.data());
+        return parameters;
+    }
+
+    //! Set the fitted parameters, in the same order as getParameters().
+    void setParameters(Eigen::VectorXd const &parameters) {
+        if (toBeFit) transform->setParams(parameters.data());
+    }
+
+    //! All the parameters of the transform, whether it is fit or not.
+    Eigen::VectorXd getTransformParameters() const {
+        Eigen::VectorXd parameters(transform->getNpar());
+        transform->getParams(parameters.data());
+        return parameters;
+    }
+
+    //! Set all the parameters of the transform, in the same order as getTransformParameters().
+    void setTransformParameters(Eigen::VectorXd const &parameters) {
+        transform->setParams(parameters.data());
+    }
+
     //! position of the parameters within the grand fitting scheme
     unsigned getIndex() const { return index; }
 
@@ -138,9 +162,6 @@ protected:
     std::shared_ptr<AstrometryTransform> transform;
 
     std::shared_ptr<AstrometryTransform> errorProp;
-    /* to avoid allocation at every call of positionDerivative.
-       use a pointer for constness */
-    std::unique_ptr<AstrometryTransformLinear> lin;
 };
 
 //! Mapping implementation for a polynomial transformation.
@@ -179,17 +200,18 @@ public:
 
     void positionDerivative(Point const &where, Eigen::Matrix2d &derivative, double epsilon) const {
         Point tmp = _centerAndScale.apply(where);
-        errorProp->computeDerivative(tmp, *lin, epsilon);
-        derivative(0, 0) = lin->coeff(1, 0, 0);
+        AstrometryTransformLinear lin;
+        errorProp->computeDerivative(tmp, lin, epsilon);
+        derivative(0, 0) = lin.coeff(1, 0, 0);
         //
         /* This does not work : it was proved by rotating the frame
            see the compilation switch ROTATE_T2 in constrainedAstrometryModel.cc
-        derivative(1,0) = lin->coeff(1,0,1);
-        derivative(0,1) = lin->coeff(0,1,0);
+        derivative(1,0) = lin.coeff(1,0,1);
+        derivative(0,1) = lin.coeff(0,1,0);
         */
-        derivative(1, 0) = lin->coeff(0, 1, 0);
-        derivative(0, 1) = lin->coeff(1, 0, 1);
-        derivative(1, 1) = lin->coeff(0, 1, 1);
+        derivative(1, 0) = lin.coeff(0, 1, 0);
+        derivative(0, 1) = lin.coeff(1, 0, 1);
+        derivative(1, 1) = lin.coeff(0, 1, 1);
         derivative = preDer * derivative;
     }
 
@@ -72,6 +72,12 @@ public:
     // dispaches the offsets after a fit step into the actual locations of parameters
     void offsetParams(Eigen::VectorXd const &delta) override;
 
+    /// @copydoc AstrometryModel::getParameters
+    void getParameters(Eigen::VectorXd &parameters) const override;
+
+    /// @copydoc AstrometryModel::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /*! the mapping of sky coordinates (i.e. the coordinate system
     in which fitted stars are reported) onto the Tangent plane
     (into which the pixel coordinates are transformed) */
@@ -83,6 +89,10 @@ public:
     //!
     void freezeErrorTransform() override;
 
+    /// @copydoc AstrometryModel::isLinear
+    /// The polynomial mappings are linear once their error transforms are frozen.
+    bool isLinear() const override { return _errorTransformFrozen; }
+
     /// @copydoc AstrometryModel::getTotalParameters
     int getTotalParameters() const override;
 
@@ -97,6 +107,7 @@ public:
 private:
     std::unordered_map<CcdImageKey, std::unique_ptr<SimpleAstrometryMapping>> _myMap;
     const std::shared_ptr<ProjectionHandler const> _skyToTangentPlane;
+    bool _errorTransformFrozen;
 
     /// @copydoc AstrometryModel::findMapping
     AstrometryMapping *findMapping(CcdImage const &ccdImage) const override;
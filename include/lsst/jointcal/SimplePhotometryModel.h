@@ -43,7 +43,7 @@ class Point;
 class SimplePhotometryModel : public PhotometryModel {
 public:
     SimplePhotometryModel(CcdImageList const &ccdImageList, LOG_LOGGER log, double errorPedestal_ = 0)
-            : PhotometryModel(log, errorPedestal_) {
+            : PhotometryModel(log, errorPedestal_), _errorTransformFrozen(false) {
         _myMap.reserve(ccdImageList.size());
     }
 
@@ -59,6 +59,12 @@ public:
     /// @copydoc PhotometryModel::offsetParams
     void offsetParams(Eigen::VectorXd const &delta) override;
 
+    /// @copydoc PhotometryModel::getParameters
+    void getParameters(Eigen::VectorXd &parameters) const override;
+
+    /// @copydoc PhotometryModel::setParameters
+    void setParameters(Eigen::VectorXd const &parameters) override;
+
     /// @copydoc PhotometryModel::freezeErrorTransform
     void freezeErrorTransform() override;
 
@@ -78,6 +84,7 @@ public:
 protected:
     typedef std::unordered_map<CcdImageKey, std::unique_ptr<PhotometryMapping>> MapType;
     MapType _myMap;
+    bool _errorTransformFrozen;
 
     /// Return the mapping associated with this ccdImage.
     PhotometryMappingBase *findMapping(CcdImage const &ccdImage) const override;
@@ -92,6 +99,14 @@ public:
         fittedStar.getFlux() -= delta;
     }
 
+    /// @copydoc PhotometryModel::getFittedStarValue
+    double getFittedStarValue(FittedStar const &fittedStar) const override { return fittedStar.getFlux(); }
+
+    /// @copydoc PhotometryModel::setFittedStarValue
+    void setFittedStarValue(FittedStar &fittedStar, double value) const override {
+        fittedStar.getFlux() = value;
+    }
+
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
@@ -101,6 +116,10 @@ public:
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::isLinear
+    /// The flux errors scale with the model, so it is linear only once the error transform is frozen.
+    bool isLinear() const override { return _errorTransformFrozen; }
+
     /// @copydoc PhotometryModel::getRefError
     double getRefError(RefStar const &refStar) const override { return refStar.getFluxErr(); }
 
@@ -126,6 +145,14 @@ public:
         fittedStar.getMag() -= delta;
     }
 
+    /// @copydoc PhotometryModel::getFittedStarValue
+    double getFittedStarValue(FittedStar const &fittedStar) const override { return fittedStar.getMag(); }
+
+    /// @copydoc PhotometryModel::setFittedStarValue
+    void setFittedStarValue(FittedStar &fittedStar, double value) const override {
+        fittedStar.getMag() = value;
+    }
+
     /// @copydoc PhotometryModel::computeResidual
     double computeResidual(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
@@ -135,6 +162,10 @@ public:
     /// @copydoc PhotometryModel::transformError
     double transformError(CcdImage const &ccdImage, MeasuredStar const &measuredStar) const override;
 
+    /// @copydoc PhotometryModel::isLinear
+    /// The magnitude offsets are additive, and do not change the errors.
+    bool isLinear() const override { return true; }
+
     /// @copydoc PhotometryModel::getRefError
     double getRefError(RefStar const &refStar) const override { return refStar.getMagErr(); }
 
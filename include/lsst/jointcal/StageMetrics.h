@@ -0,0 +1,106 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_STAGE_METRICS_H
+#define LSST_JOINTCAL_STAGE_METRICS_H
+
+#include <chrono>
+#include <cstddef>
+#include <ctime>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Performance counters of one stage of jointcal (loading the catalogs, associating them, collecting the
+ * reference stars, or the minimizations of a fitter), accumulated over the calls of that stage.
+ *
+ * The times cover every call; the CPU time is that of the whole process, so it exceeds the wall time
+ * when the stage runs on several threads. The linear algebra counters are only filled by the fitters:
+ * the triplet count and the factorization flops are summed over all the passes, while the non-zero
+ * counts are those of the last Jacobian, Hessian and factor.
+ */
+struct StageMetrics {
+    StageMetrics()
+            : nCalls(0),
+              wallSeconds(0),
+              cpuSeconds(0),
+              nTriplets(0),
+              nJacobianNonZeros(0),
+              nHessianNonZeros(0),
+              nFactorNonZeros(0),
+              factorizationFlops(0),
+              nFactorizations(0),
+              nRankUpdates(0),
+              nMeasOutliers(0),
+              nRefOutliers(0) {}
+
+    std::size_t nCalls;
+    double wallSeconds;
+    double cpuSeconds;
+    std::size_t nTriplets;          // Jacobian triplets computed, over all the passes
+    std::size_t nJacobianNonZeros;  // triplets of the last full Jacobian
+    std::size_t nHessianNonZeros;   // lower triangle of the last assembled Hessian
+    double nFactorNonZeros;         // of the last factorization (all its components, if split)
+    double factorizationFlops;      // of all the numerical factorizations
+    std::size_t nFactorizations;
+    std::size_t nRankUpdates;  // outlier downdates of the factor, instead of refactoring it
+    std::size_t nMeasOutliers;
+    std::size_t nRefOutliers;
+};
+
+/**
+ * Add the wall and CPU time of its scope to a StageMetrics, and count one call.
+ *
+ * Only time the outermost call of a stage: a timer nested in another on the same StageMetrics counts
+ * the call and its time twice.
+ */
+class StageTimer {
+public:
+    explicit StageTimer(StageMetrics &metrics)
+            : _metrics(metrics), _wallStart(std::chrono::steady_clock::now()), _cpuStart(std::clock()) {}
+
+    StageTimer(StageTimer const &) = delete;
+    StageTimer(StageTimer &&) = delete;
+    StageTimer &operator=(StageTimer const &) = delete;
+    StageTimer &operator=(StageTimer &&) = delete;
+
+    ~StageTimer() {
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - _wallStart;
+        _metrics.wallSeconds += elapsed.count();
+        _metrics.cpuSeconds += static_cast<double>(std::clock() - _cpuStart) / CLOCKS_PER_SEC;
+        ++_metrics.nCalls;
+    }
+
+private:
+    StageMetrics &_metrics;
+    std::chrono::steady_clock::time_point _wallStart;
+    std::clock_t _cpuStart;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#endif  // LSST_JOINTCAL_STAGE_METRICS_H
@@ -0,0 +1,125 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#ifndef LSST_JOINTCAL_TRACE_H
+#define LSST_JOINTCAL_TRACE_H
+
+#include <atomic>
+#include <chrono>
+#include <string>
+
+namespace lsst {
+namespace jointcal {
+
+/**
+ * Process-wide recorder of the timeline of jointcal, written as Chrome trace-event JSON (to open with
+ * chrome://tracing or https://ui.perfetto.dev).
+ *
+ * The C++ stages open a TraceSpan (with the JOINTCAL_TRACE_SPAN macros) for each catalog load, catalog
+ * association, derivative pass over a CcdImage, minimize() step (assembly, factorization, solve, outlier
+ * rejection) and WCS creation. Each span is recorded with the thread that ran it, so that the idle
+ * threads of the parallel passes show up as gaps. Nothing is recorded until start() is called, and a
+ * span then only costs two clock reads and a locked push_back. Defining LSST_JOINTCAL_NO_TRACE when
+ * compiling jointcal removes the spans altogether.
+ */
+class Trace {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /// Start recording spans, discarding those recorded before.
+    static void start();
+
+    /**
+     * Stop recording, and write the spans recorded since start() to path.
+     *
+     * @throws lsst::pex::exceptions::IoError if the file cannot be written.
+     */
+    static void stop(std::string const &path);
+
+    /// Whether spans are being recorded.
+    static bool isEnabled() { return _enabled.load(std::memory_order_relaxed); }
+
+    /// Record a span of the calling thread; used by TraceSpan.
+    static void record(char const *name, std::string const &detail, Clock::time_point begin,
+                       Clock::time_point end);
+
+private:
+    static std::atomic<bool> _enabled;
+};
+
+/**
+ * A span of the trace, from its construction to its destruction, if Trace is recording when it is
+ * constructed.
+ */
+class TraceSpan {
+public:
+    /// @param name  A string literal: it is not copied.
+    explicit TraceSpan(char const *name) : _name(name), _active(Trace::isEnabled()) {
+        if (_active) _begin = Trace::Clock::now();
+    }
+
+    TraceSpan(TraceSpan const &) = delete;
+    TraceSpan(TraceSpan &&) = delete;
+    TraceSpan &operator=(TraceSpan const &) = delete;
+    TraceSpan &operator=(TraceSpan &&) = delete;
+
+    ~TraceSpan() {
+        if (_active) Trace::record(_name, _detail, _begin, Trace::Clock::now());
+    }
+
+    /// Whether this span is recorded: only compute its detail if it is.
+    bool isActive() const { return _active; }
+
+    /// Set the detail shown with the span, e.g. the name of its CcdImage.
+    void setDetail(std::string detail) { _detail = std::move(detail); }
+
+private:
+    char const *_name;
+    bool _active;
+    Trace::Clock::time_point _begin;
+    std::string _detail;
+};
+
+}  // namespace jointcal
+}  // namespace lsst
+
+#define JOINTCAL_TRACE_CONCAT_IMPL(a, b) a##b
+#define JOINTCAL_TRACE_CONCAT(a, b) JOINTCAL_TRACE_CONCAT_IMPL(a, b)
+
+#ifdef LSST_JOINTCAL_NO_TRACE
+#define JOINTCAL_TRACE_SPAN(name)
+#define JOINTCAL_TRACE_SPAN_DETAIL(name, detail)
+#else
+/// Trace the rest of the enclosing scope as a span called name.
+#define JOINTCAL_TRACE_SPAN(name) \
+    ::lsst::jointcal::TraceSpan JOINTCAL_TRACE_CONCAT(_traceSpan, __LINE__)(name)
+/// Trace the rest of the enclosing scope as a span called name; detail is only evaluated if it is traced.
+#define JOINTCAL_TRACE_SPAN_DETAIL(name, detail)                                      \
+    ::lsst::jointcal::TraceSpan JOINTCAL_TRACE_CONCAT(_traceSpan, __LINE__)(name); \
+    if (JOINTCAL_TRACE_CONCAT(_traceSpan, __LINE__).isActive())                      \
+    JOINTCAL_TRACE_CONCAT(_traceSpan, __LINE__).setDetail(detail)
+#endif
+
+#endif  // LSST_JOINTCAL_TRACE_H
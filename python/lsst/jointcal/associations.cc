@@ -27,6 +27,7 @@
 
 #include "lsst/jointcal/Associations.h"
 #include "lsst/jointcal/CcdImage.h"
+#include "lsst/jointcal/StageMetrics.h"
 
 namespace py = pybind11;
 using namespace pybind11::literals;
@@ -35,6 +36,24 @@ namespace lsst {
 namespace jointcal {
 namespace {
 
+void declareStageMetrics(py::module &mod) {
+    py::class_<StageMetrics, std::shared_ptr<StageMetrics>> cls(mod, "StageMetrics");
+
+    cls.def(py::init<>());
+    cls.def_readonly("nCalls", &StageMetrics::nCalls);
+    cls.def_readonly("wallSeconds", &StageMetrics::wallSeconds);
+    cls.def_readonly("cpuSeconds", &StageMetrics::cpuSeconds);
+    cls.def_readonly("nTriplets", &StageMetrics::nTriplets);
+    cls.def_readonly("nJacobianNonZeros", &StageMetrics::nJacobianNonZeros);
+    cls.def_readonly("nHessianNonZeros", &StageMetrics::nHessianNonZeros);
+    cls.def_readonly("nFactorNonZeros", &StageMetrics::nFactorNonZeros);
+    cls.def_readonly("factorizationFlops", &StageMetrics::factorizationFlops);
+    cls.def_readonly("nFactorizations", &StageMetrics::nFactorizations);
+    cls.def_readonly("nRankUpdates", &StageMetrics::nRankUpdates);
+    cls.def_readonly("nMeasOutliers", &StageMetrics::nMeasOutliers);
+    cls.def_readonly("nRefOutliers", &StageMetrics::nRefOutliers);
+}
+
 void declareAssociations(py::module &mod) {
     py::class_<Associations, std::shared_ptr<Associations>> cls(mod, "Associations");
     cls.def(py::init<>());
@@ -45,6 +64,8 @@ void declareAssociations(py::module &mod) {
     cls.def("fittedStarListSize", &Associations::fittedStarListSize);
     cls.def("associateCatalogs", &Associations::associateCatalogs, "matchCutInArcsec"_a = 0,
             "useFittedList"_a = false, "enlargeFittedList"_a = true);
+    cls.def("associateNewCatalogs", &Associations::associateNewCatalogs, "matchCutInArcsec"_a,
+            "minMeasurements"_a);
     cls.def("collectRefStars", &Associations::collectRefStars, "refCat"_a, "matchCut"_a, "fluxField"_a,
             "rejectBadFluxes"_a = false);
     cls.def("deprojectFittedStars", &Associations::deprojectFittedStars);
@@ -53,6 +74,7 @@ void declareAssociations(py::module &mod) {
 
     cls.def("createCcdImage", &Associations::createCcdImage);
     cls.def("prepareFittedStars", &Associations::prepareFittedStars);
+    cls.def("sortStarsSpatially", &Associations::sortStarsSpatially);
 
     cls.def("getCcdImageList", &Associations::getCcdImageList, py::return_value_policy::reference_internal);
     cls.def_property_readonly("ccdImageList", &Associations::getCcdImageList,
@@ -64,10 +86,15 @@ void declareAssociations(py::module &mod) {
     cls.def("getCommonTangentPoint", &Associations::getCommonTangentPoint);
     cls.def("setCommonTangentPoint", &Associations::setCommonTangentPoint);
     cls.def("computeCommonTangentPoint", &Associations::computeCommonTangentPoint);
+
+    cls.def("getLoadCatalogMetrics", &Associations::getLoadCatalogMetrics);
+    cls.def("getAssociateCatalogsMetrics", &Associations::getAssociateCatalogsMetrics);
+    cls.def("getCollectRefStarsMetrics", &Associations::getCollectRefStarsMetrics);
 }
 
 PYBIND11_MODULE(associations, mod) {
     py::module::import("lsst.jointcal.ccdImage");
+    declareStageMetrics(mod);
     declareAssociations(mod);
 }
 }  // namespace
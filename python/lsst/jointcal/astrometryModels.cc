@@ -52,6 +52,7 @@ void declareAstrometryModel(py::module &mod) {
     cls.def("getSkyToTangentPlane", &AstrometryModel::getSkyToTangentPlane);
     cls.def("makeSkyWcs", &AstrometryModel::makeSkyWcs);
     cls.def("getTotalParameters", &AstrometryModel::getTotalParameters);
+    cls.def("isLinear", &AstrometryModel::isLinear);
     cls.def("validate", &AstrometryModel::validate);
 }
 
@@ -78,6 +79,8 @@ void declareConstrainedAstrometryModel(py::module &mod) {
             py::return_value_policy::reference_internal);
     cls.def("getVisitTransform", &ConstrainedAstrometryModel::getVisitTransform,
             py::return_value_policy::reference_internal);
+    cls.def("getChipParameters", &ConstrainedAstrometryModel::getChipParameters);
+    cls.def("setChipParameters", &ConstrainedAstrometryModel::setChipParameters, "chipParameters"_a);
 }
 
 PYBIND11_MODULE(astrometryModels, mod) {
@@ -23,11 +23,14 @@
  */
 
 #include "pybind11/pybind11.h"
+#include "pybind11/eigen.h"
+#include "pybind11/stl.h"
 
 #include "lsst/jointcal/Associations.h"
 #include "lsst/jointcal/AstrometryFit.h"
 #include "lsst/jointcal/AstrometryModel.h"
 #include "lsst/jointcal/Chi2.h"
+#include "lsst/jointcal/FitCheckpoint.h"
 #include "lsst/jointcal/FitterBase.h"
 #include "lsst/jointcal/PhotometryFit.h"
 #include "lsst/jointcal/PhotometryModel.h"
@@ -39,13 +42,112 @@ namespace lsst {
 namespace jointcal {
 namespace {
 
+void declareProblemSize(py::module &mod) {
+    py::class_<ProblemSize, std::shared_ptr<ProblemSize>> cls(mod, "ProblemSize");
+
+    cls.def_readonly("nParameters", &ProblemSize::nParameters);
+    cls.def_readonly("nStarParameters", &ProblemSize::nStarParameters);
+    cls.def_readonly("nJacobianColumns", &ProblemSize::nJacobianColumns);
+    cls.def_readonly("nJacobianNonZeros", &ProblemSize::nJacobianNonZeros);
+    cls.def_readonly("nHessianNonZeros", &ProblemSize::nHessianNonZeros);
+    cls.def_readonly("nFactorNonZeros", &ProblemSize::nFactorNonZeros);
+    cls.def("getJacobianBytes", &ProblemSize::getJacobianBytes);
+    cls.def("getHessianBytes", &ProblemSize::getHessianBytes);
+    cls.def("getFactorBytes", &ProblemSize::getFactorBytes);
+}
+
+void declareDampingTrial(py::module &mod) {
+    py::class_<DampingTrial, std::shared_ptr<DampingTrial>> cls(mod, "DampingTrial");
+
+    cls.def_readonly("damping", &DampingTrial::damping);
+    cls.def_readonly("predictedReduction", &DampingTrial::predictedReduction);
+    cls.def_readonly("actualReduction", &DampingTrial::actualReduction);
+    cls.def_readonly("accepted", &DampingTrial::accepted);
+}
+
+void declareOrderingCost(py::module &mod) {
+    py::class_<OrderingCost, std::shared_ptr<OrderingCost>> cls(mod, "OrderingCost");
+
+    cls.def_readonly("ordering", &OrderingCost::ordering);
+    cls.def_readonly("available", &OrderingCost::available);
+    cls.def_readonly("factorNonZeros", &OrderingCost::factorNonZeros);
+    cls.def_readonly("factorizationFlops", &OrderingCost::factorizationFlops);
+    cls.def_readonly("analysisSeconds", &OrderingCost::analysisSeconds);
+}
+
 void declareFitterBase(py::module &mod) {
     py::class_<FitterBase, std::shared_ptr<FitterBase>> cls(mod, "FitterBase");
 
     cls.def("minimize", &FitterBase::minimize, "whatToFit"_a, "nSigRejCut"_a = 0, "doRankUpdate"_a = true,
             "doLineSearch"_a = false, "dumpMatrixFile"_a = "");
+    cls.def("minimizeAlternating", &FitterBase::minimizeAlternating, "whatToFit"_a, "nSigRejCut"_a = 0,
+            "doLineSearch"_a = false, "finishJointly"_a = false);
+    cls.def("setAlternatingTolerance", &FitterBase::setAlternatingTolerance, "tolerance"_a);
+    cls.def("getAlternatingTolerance", &FitterBase::getAlternatingTolerance);
+    cls.def("setAlternatingMaxIterations", &FitterBase::setAlternatingMaxIterations, "maxIterations"_a);
+    cls.def("getAlternatingMaxIterations", &FitterBase::getAlternatingMaxIterations);
     cls.def("computeChi2", &FitterBase::computeChi2);
+    cls.def("getParameters", &FitterBase::getParameters);
+    cls.def("setParameters", &FitterBase::setParameters, "parameters"_a);
+    cls.def("assignIndices", &FitterBase::assignIndices, "whatToFit"_a);
+    cls.def("getWhatToFit", &FitterBase::getWhatToFit);
+    cls.def("computeProblemSize", &FitterBase::computeProblemSize, "whatToFit"_a);
+    cls.def("getNScratchAllocations", &FitterBase::getNScratchAllocations);
+    cls.def("getScratchBytes", &FitterBase::getScratchBytes);
+    cls.def("releaseScratch", &FitterBase::releaseScratch);
+    cls.def("getMetrics", &FitterBase::getMetrics);
+    cls.def("resetMetrics", &FitterBase::resetMetrics);
     cls.def("saveChi2Contributions", &FitterBase::saveChi2Contributions);
+    cls.def("setNThreads", &FitterBase::setNThreads, "nThreads"_a);
+    cls.def("getNThreads", &FitterBase::getNThreads);
+    cls.def("setFactorizationMode", &FitterBase::setFactorizationMode, "mode"_a);
+    cls.def("getFactorizationMode", &FitterBase::getFactorizationMode);
+    cls.def("getFactorizationModeUsed", &FitterBase::getFactorizationModeUsed);
+    cls.def("setOrdering", &FitterBase::setOrdering, "ordering"_a);
+    cls.def("getOrdering", &FitterBase::getOrdering);
+    cls.def("setMaxDowndateDrift", &FitterBase::setMaxDowndateDrift, "maxDrift"_a);
+    cls.def("getMaxDowndateDrift", &FitterBase::getMaxDowndateDrift);
+    cls.def("compareOrderings", &FitterBase::compareOrderings, "whatToFit"_a);
+    cls.def("setMaxDenseBorder", &FitterBase::setMaxDenseBorder, "maxBorder"_a);
+    cls.def("getMaxDenseBorder", &FitterBase::getMaxDenseBorder);
+    cls.def("getDenseBorderSize", &FitterBase::getDenseBorderSize);
+    cls.def("setSplitComponents", &FitterBase::setSplitComponents, "split"_a);
+    cls.def("getSplitComponents", &FitterBase::getSplitComponents);
+    cls.def("getNComponents", &FitterBase::getNComponents);
+    cls.def("setSolverMode", &FitterBase::setSolverMode, "mode"_a);
+    cls.def("getSolverMode", &FitterBase::getSolverMode);
+    cls.def("setConjugateGradientTolerance", &FitterBase::setConjugateGradientTolerance, "tolerance"_a);
+    cls.def("getConjugateGradientTolerance", &FitterBase::getConjugateGradientTolerance);
+    cls.def("setConjugateGradientMaxIterations", &FitterBase::setConjugateGradientMaxIterations,
+            "maxIterations"_a);
+    cls.def("getConjugateGradientMaxIterations", &FitterBase::getConjugateGradientMaxIterations);
+    cls.def("setLevenbergMarquardtDamping", &FitterBase::setLevenbergMarquardtDamping, "damping"_a);
+    cls.def("getLevenbergMarquardtDamping", &FitterBase::getLevenbergMarquardtDamping);
+    cls.def("getDampingHistory", &FitterBase::getDampingHistory);
+    cls.def("setRobustLoss", &FitterBase::setRobustLoss, "loss"_a, "scale"_a = 1.345);
+    cls.def("getRobustLoss", &FitterBase::getRobustLoss);
+    cls.def("getRobustScale", &FitterBase::getRobustScale);
+    cls.def("setRobustMaxIterations", &FitterBase::setRobustMaxIterations, "maxIterations"_a);
+    cls.def("getRobustMaxIterations", &FitterBase::getRobustMaxIterations);
+}
+
+void declareFitCheckpoint(py::module &mod) {
+    py::class_<FitCheckpoint, std::shared_ptr<FitCheckpoint>> cls(mod, "FitCheckpoint");
+
+    cls.def(py::init<std::string const &>(), "path"_a);
+    cls.attr("version") = py::int_(FitCheckpoint::version);
+    cls.def_static("write", &FitCheckpoint::write, "path"_a, "associations"_a, "fitter"_a,
+                   "chipParameters"_a = std::map<CcdIdType, Eigen::VectorXd>());
+    cls.def("restoreAssociations", &FitCheckpoint::restoreAssociations, "associations"_a);
+    cls.def("restoreStars", &FitCheckpoint::restoreStars, "associations"_a);
+    cls.def("restoreFitter", &FitCheckpoint::restoreFitter, "fitter"_a);
+    cls.def("getChipParameters", &FitCheckpoint::getChipParameters);
+    cls.def("getVisits", &FitCheckpoint::getVisits);
+    cls.def("getWhatToFit", &FitCheckpoint::getWhatToFit);
+    cls.def("getNCcdImages", &FitCheckpoint::getNCcdImages);
+    cls.def("getNMeasuredStars", &FitCheckpoint::getNMeasuredStars);
+    cls.def("getNFittedStars", &FitCheckpoint::getNFittedStars);
+    cls.def("getNRefStars", &FitCheckpoint::getNRefStars);
 }
 
 void declareAstrometryFit(py::module &mod) {
@@ -76,10 +178,30 @@ PYBIND11_MODULE(fitter, mod) {
             .value("Chi2Increased", MinimizeResult::Chi2Increased)
             .value("NonFinite", MinimizeResult::NonFinite)
             .value("Failed", MinimizeResult::Failed);
+    py::enum_<CholmodMode>(mod, "CholmodMode")
+            .value("SimplicialLDLT", CholmodMode::SimplicialLDLT)
+            .value("SupernodalLLT", CholmodMode::SupernodalLLT);
+    py::enum_<HessianOrdering>(mod, "HessianOrdering")
+            .value("Default", HessianOrdering::Default)
+            .value("AMD", HessianOrdering::AMD)
+            .value("NestedDissection", HessianOrdering::NestedDissection)
+            .value("StarsFirst", HessianOrdering::StarsFirst);
+    py::enum_<SolverMode>(mod, "SolverMode")
+            .value("Direct", SolverMode::Direct)
+            .value("SchurComplement", SolverMode::SchurComplement)
+            .value("ConjugateGradient", SolverMode::ConjugateGradient);
+    py::enum_<RobustLoss>(mod, "RobustLoss")
+            .value("Quadratic", RobustLoss::Quadratic)
+            .value("Huber", RobustLoss::Huber)
+            .value("Cauchy", RobustLoss::Cauchy);
 
+    declareProblemSize(mod);
+    declareDampingTrial(mod);
+    declareOrderingCost(mod);
     declareFitterBase(mod);
     declareAstrometryFit(mod);
     declarePhotometryFit(mod);
+    declareFitCheckpoint(mod);
 }
 }  // namespace
 }  // namespace jointcal
@@ -20,6 +20,7 @@
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
 import collections
+import os
 import numpy as np
 import astropy.units as u
 
@@ -54,6 +55,46 @@ def add_measurement(job, name, value):
     job.measurements.insert(meas)
 
 
+# Measurement name suffix and unit of each field of lsst.jointcal.StageMetrics.
+STAGE_TIME_METRICS = {'nCalls': ('calls', u.dimensionless_unscaled),
+                      'wallSeconds': ('wall_time', u.s),
+                      'cpuSeconds': ('cpu_time', u.s)}
+STAGE_FIT_METRICS = {'nTriplets': ('triplets', u.dimensionless_unscaled),
+                     'nJacobianNonZeros': ('jacobian_nonzeros', u.dimensionless_unscaled),
+                     'nHessianNonZeros': ('hessian_nonzeros', u.dimensionless_unscaled),
+                     'nFactorNonZeros': ('factor_nonzeros', u.dimensionless_unscaled),
+                     'factorizationFlops': ('factorization_flops', u.dimensionless_unscaled),
+                     'nFactorizations': ('factorizations', u.dimensionless_unscaled),
+                     'nRankUpdates': ('rank_updates', u.dimensionless_unscaled),
+                     'nMeasOutliers': ('meas_outliers', u.dimensionless_unscaled),
+                     'nRefOutliers': ('ref_outliers', u.dimensionless_unscaled)}
+
+
+def add_stage_metrics(job, stage, metrics, fields=STAGE_TIME_METRICS):
+    """Record the performance counters of a stage of jointcal in job, as
+    measurements named ``jointcal.<stage>_<counter>``.
+
+    These are not metrics of the verify metrics package: they are meant
+    to track the performance of jointcal, not to be tested against
+    specifications.
+
+    Parameters
+    ----------
+    job : `lsst.verify.Job`
+        The job to record the measurements in.
+    stage : `str`
+        Name of the stage, e.g. "astrometry_fit".
+    metrics : `lsst.jointcal.StageMetrics`
+        The counters of the stage.
+    fields : `dict`, optional
+        The fields of metrics to record, with their measurement name suffix
+        and unit.
+    """
+    for field, (suffix, unit) in fields.items():
+        meas = Measurement(f'jointcal.{stage}_{suffix}', getattr(metrics, field)*unit)
+        job.measurements.insert(meas)
+
+
 class JointcalRunner(pipeBase.ButlerInitializedTaskRunner):
     """Subclass of TaskRunner for jointcalTask
 
@@ -184,7 +225,9 @@ class JointcalConfig(pexConfig.Config):
     )
     allowLineSearch = pexConfig.Field(
         doc="Allow a line search during minimization, if it is reasonable for the model"
-        " (models with a significant non-linear component, e.g. constrainedPhotometry).",
+        " (models with a significant non-linear component, e.g. constrainedPhotometry)."
+        " It usually costs two or three chi2 evaluations per step, unless the chi2 is far from"
+        " quadratic along the step.",
         dtype=bool,
         default=False
     )
@@ -270,6 +313,157 @@ class JointcalConfig(pexConfig.Config):
         dtype=int,
         default=20,
     )
+    nThreads = pexConfig.Field(
+        doc="Number of threads to use when computing the fit derivatives and chi2. "
+        "The chi2, Hessian and gradient are summed over fixed chunks of CcdImages, in a fixed order, so "
+        "they do not depend on the number of threads; only splitComponents and the conjugateGradient "
+        "solver make the results depend on it, through floating point rounding.",
+        dtype=int,
+        default=1,
+        check=lambda x: x >= 1,
+    )
+    factorizationMode = pexConfig.ChoiceField(
+        doc="Cholmod kernel used to factorize the Hessian. The default stays simplicialLDLT until the "
+            "supernodal kernel has been benchmarked on the cfht and hsc data.",
+        dtype=str,
+        allowed={"simplicialLDLT": "Simplicial LDLt; supports fast rank updates when removing outliers.",
+                 "supernodalLLT": "Supernodal LLt with BLAS-3 kernels (multithreaded if the BLAS is); "
+                                  "meant for large fits with many chips coupled across visits, but not "
+                                  "measured yet: run examples/benchmark_factorization.sh before using it."},
+        default="simplicialLDLT",
+    )
+    sortStarsSpatially = pexConfig.Field(
+        doc="Sort the fitted stars and the measurements of each ccd along a Hilbert curve on the sky "
+            "before fitting, so that nearby stars get nearby parameter indices, for the cache locality "
+            "of the Hessian assembly. The gain has not been measured, so this stays off until "
+            "examples/benchmark_star_ordering.sh has been run on the hsc data.",
+        dtype=bool,
+        default=False,
+    )
+    factorizationOrdering = pexConfig.ChoiceField(
+        doc="Fill-reducing ordering of the Hessian factorization.",
+        dtype=str,
+        allowed={"default": "Let cholmod choose (AMD, or METIS if AMD fills too much).",
+                 "amd": "Approximate minimum degree.",
+                 "nestedDissection": "METIS nested dissection (AMD if cholmod was built without METIS).",
+                 "starsFirst": "Eliminate the fitted star parameters first, then the model parameters."},
+        default="default",
+    )
+    compareOrderings = pexConfig.Field(
+        doc="Log the factor size and flop count of each fill-reducing ordering before the final fits, "
+            "to choose factorizationOrdering.",
+        dtype=bool,
+        default=False,
+    )
+    maxDowndateDrift = pexConfig.Field(
+        doc="Relative residual of the normal equations above which a step solved with a factor downdated "
+            "for outliers is refactored and solved again; raised to 100 times the residual of a fresh "
+            "factorization when that is larger, for ill-conditioned fits.",
+        dtype=float,
+        default=1e-8,
+        check=lambda x: x > 0,
+    )
+    maxDenseBorder = pexConfig.Field(
+        doc="Maximum number of dense global parameters (the refraction coefficients and the chip "
+            "parameters of a constrained astrometry model) solved apart from the factorized Hessian, to "
+            "keep their rows from filling the factor; the densest are kept. 0 factorizes the whole Hessian.",
+        dtype=int,
+        default=64,
+        check=lambda x: x >= 0,
+    )
+    splitComponents = pexConfig.Field(
+        doc="With nThreads > 1, factorize the independent parts of the fit (e.g. disjoint groups of "
+            "visits, or the fitted stars alone) separately, one part per thread.",
+        dtype=bool,
+        default=True,
+    )
+    solverMode = pexConfig.ChoiceField(
+        doc="How to solve the normal equations at each minimization step.",
+        dtype=str,
+        allowed={"direct": "Factorize the full Hessian.",
+                 "schurComplement": "Eliminate the fitted star parameters analytically and only factorize "
+                                    "the model parameter system; much smaller for large fits.",
+                 "conjugateGradient": "Iterate with block-Jacobi preconditioned conjugate gradient, "
+                                      "recomputing the derivatives instead of storing the Hessian; "
+                                      "for fits too large to factorize, at the cost of an approximate "
+                                      "solution and much more CPU time."},
+        default="direct",
+    )
+    conjugateGradientTolerance = pexConfig.Field(
+        doc="With solverMode='conjugateGradient', stop iterating when the residual of the normal equations "
+        "is below this fraction of the gradient.",
+        dtype=float,
+        default=1e-10,
+        check=lambda x: x > 0,
+    )
+    conjugateGradientMaxIterations = pexConfig.Field(
+        doc="With solverMode='conjugateGradient', the maximum number of iterations per minimization step; "
+        "each one recomputes the derivatives of all the terms of the fit.",
+        dtype=int,
+        default=1000,
+        check=lambda x: x >= 1,
+    )
+    finalFit = pexConfig.ChoiceField(
+        doc="How to minimize the chi2 of the final fit of the fitted stars and the model together.",
+        dtype=str,
+        allowed={"joint": "Gauss-Newton steps of all the parameters together.",
+                 "alternating": "Alternate closed-form fitted star updates with model-only steps, never "
+                                "building the Hessian of the stars and the model together; for catalogs "
+                                "too large to fit jointly, at the cost of slower convergence.",
+                 "alternatingThenJoint": "Alternate, then finish with a joint step of all the parameters."},
+        default="joint",
+    )
+    alternatingTolerance = pexConfig.Field(
+        doc="With finalFit='alternating*', stop alternating when the chi2 decreases by less than this "
+        "fraction of itself.",
+        dtype=float,
+        default=1e-6,
+        check=lambda x: x > 0,
+    )
+    alternatingMaxIterations = pexConfig.Field(
+        doc="With finalFit='alternating*', the maximum number of alternations between outlier rejections.",
+        dtype=int,
+        default=100,
+        check=lambda x: x >= 1,
+    )
+    levenbergMarquardtDamping = pexConfig.Field(
+        doc="Initial Levenberg-Marquardt damping of the minimization steps, relative to the diagonal of the "
+        "Hessian; 0 takes plain Gauss-Newton steps. With a positive damping, steps that do not reduce the "
+        "chi2 are retried with more damping, which helps the non-linear fits (e.g. constrained models) "
+        "converge in fewer outer iterations. Ignored by solverMode='conjugateGradient'.",
+        dtype=float,
+        default=0.0,
+        check=lambda x: x >= 0,
+    )
+    rollbackChi2Increase = pexConfig.Field(
+        doc="When a minimization step increases the chi2, restore the parameters it started from before "
+        "retrying (its outliers stay rejected), instead of retrying from the worse step.",
+        dtype=bool,
+        default=False,
+    )
+    robustLoss = pexConfig.ChoiceField(
+        doc="Down-weight the measurements and reference stars with large residuals by iteratively "
+        "reweighted least squares, before the outlier rejection (if outlierRejectSigma is not 0).",
+        dtype=str,
+        allowed={"none": "Plain least squares.",
+                 "huber": "Weights decrease as 1/residual beyond robustLossScale.",
+                 "cauchy": "Weights decrease as 1/residual^2 beyond robustLossScale."},
+        default="none",
+    )
+    robustLossScale = pexConfig.Field(
+        doc="Normalized residual (square root of the chi2 contribution) beyond which robustLoss down-weights "
+        "a term. If None, 1.345 for huber and 2.385 for cauchy (95% efficiency for gaussian residuals).",
+        dtype=float,
+        default=None,
+        optional=True,
+        check=lambda x: x > 0,
+    )
+    robustMaxIterations = pexConfig.Field(
+        doc="With a robustLoss, the maximum number of reweighted solves per minimization step.",
+        dtype=int,
+        default=10,
+        check=lambda x: x >= 1,
+    )
     astrometryRefObjLoader = pexConfig.ConfigurableField(
         target=LoadIndexedReferenceObjectsTask,
         doc="Reference object loader for astrometric fit",
@@ -312,12 +506,57 @@ class JointcalConfig(pexConfig.Config):
         doc="Source flux field to use in source selection and to get fluxes from the catalog.",
         default='Calib'
     )
+    checkpointDir = pexConfig.Field(
+        dtype=str,
+        doc="Directory where a checkpoint of the associations and fit is written when a fit stage "
+            "(astrometry or photometry) is done. A stage whose checkpoint is already there is restored "
+            "from it instead of being associated and fit again, to resume an interrupted run. "
+            "The input catalogs are still read. None to disable checkpoints.",
+        default=None,
+        optional=True,
+    )
+    traceFile = pexConfig.Field(
+        dtype=str,
+        doc="Path of a Chrome trace-event JSON file (for chrome://tracing or https://ui.perfetto.dev) "
+            "where the timeline of the C++ stages is written: catalog loads, association of each catalog, "
+            "the derivatives of each CcdImage on each thread, the assembly, factorization, solve and "
+            "outlier rejection of each minimize step, and the WCS creation. None to not trace.",
+        default=None,
+        optional=True,
+    )
+    recordStageMetrics = pexConfig.Field(
+        dtype=bool,
+        doc="Record the wall and CPU time of each stage (loading the catalogs, associating them, collecting "
+            "the reference stars, fitting), and the Jacobian, Hessian and factor sizes, factorizations, rank "
+            "updates and outliers of each fit, as measurements of the verify Job named "
+            "jointcal.<stage>_<counter>. They are always returned as stageMetrics.",
+        default=False,
+    )
+    incremental = pexConfig.Field(
+        dtype=bool,
+        doc="Fit the input visits as new visits of the solution saved in the checkpoints of checkpointDir, "
+            "instead of fitting them from scratch: the chip transforms are taken from the saved solution "
+            "and frozen, only the visit transforms and the stars that the new visits measure are fit, "
+            "and the saved stars are held near their saved solution. Only pass the new visits. "
+            "Requires checkpointDir and constrained models; the checkpoints are not modified.",
+        default=False,
+    )
 
     def validate(self):
         super().validate()
         if self.applyColorTerms and len(self.colorterms.data) == 0:
             msg = "applyColorTerms=True requires the `colorterms` field be set to a ColortermLibrary."
             raise pexConfig.FieldValidationError(JointcalConfig.colorterms, self, msg)
+        if self.incremental:
+            if self.checkpointDir is None:
+                msg = "incremental=True requires checkpointDir, to read the saved solution from."
+                raise pexConfig.FieldValidationError(JointcalConfig.checkpointDir, self, msg)
+            if self.doAstrometry and self.astrometryModel != "constrained":
+                msg = "incremental=True requires the constrained astrometryModel, to freeze its chips."
+                raise pexConfig.FieldValidationError(JointcalConfig.astrometryModel, self, msg)
+            if self.doPhotometry and not self.photometryModel.startswith("constrained"):
+                msg = "incremental=True requires a constrained photometryModel, to freeze its chips."
+                raise pexConfig.FieldValidationError(JointcalConfig.photometryModel, self, msg)
 
     def setDefaults(self):
         sourceSelector = self.sourceSelector["astrometry"]
@@ -466,10 +705,27 @@ class JointcalTask(pipeBase.CmdLineTask):
                 The original WCS from each dataRef
             ``metrics``
                 Dictionary of internally-computed metrics for testing/validation.
+            ``stageMetrics``
+                Performance counters of each stage, by stage name
+                (`dict` of `lsst.jointcal.StageMetrics`).
         """
         if len(dataRefs) == 0:
             raise ValueError('Need a non-empty list of data references!')
 
+        if self.config.traceFile is None:
+            return self._run(dataRefs, profile_jointcal)
+        lsst.jointcal.Trace.start()
+        try:
+            return self._run(dataRefs, profile_jointcal)
+        finally:
+            # also written if the fit fails, to see where it was.
+            lsst.jointcal.Trace.stop(self.config.traceFile)
+
+    def _run(self, dataRefs, profile_jointcal):
+        """Do the work of runDataRef, which takes the same parameters and
+        returns its result.
+        """
+
         exitStatus = 0  # exit status for shell
 
         sourceFluxField = "slot_%sFlux" % (self.config.sourceFluxType,)
@@ -542,14 +798,56 @@ class JointcalTask(pipeBase.CmdLineTask):
         else:
             photometry = Photometry(None, None)
 
+        stageMetrics = self._get_stage_metrics(associations, astrometry, photometry)
+
         return pipeBase.Struct(dataRefs=dataRefs,
                                oldWcsList=oldWcsList,
                                job=self.job,
+                               stageMetrics=stageMetrics,
                                astrometryRefObjLoader=self.astrometryRefObjLoader,
                                photometryRefObjLoader=self.photometryRefObjLoader,
                                defaultFilter=defaultFilter,
                                exitStatus=exitStatus)
 
+    def _get_stage_metrics(self, associations, astrometry, photometry):
+        """Collect the performance counters of each stage, and record them in
+        the verify Job if config.recordStageMetrics.
+
+        Parameters
+        ----------
+        associations : `lsst.jointcal.Associations`
+            The associations that were fit.
+        astrometry : `Astrometry`
+            The result of the astrometric fit; its fit is None if it was
+            not done.
+        photometry : `Photometry`
+            The result of the photometric fit; its fit is None if it was
+            not done.
+
+        Returns
+        -------
+        stageMetrics : `dict` of `lsst.jointcal.StageMetrics`
+            The counters of each stage, by stage name.
+        """
+        stageMetrics = {'load_catalog': associations.getLoadCatalogMetrics(),
+                        'associate_catalogs': associations.getAssociateCatalogsMetrics(),
+                        'collect_refstars': associations.getCollectRefStarsMetrics()}
+        fitStages = []
+        for name, result in (("astrometry_fit", astrometry), ("photometry_fit", photometry)):
+            if result.fit is not None:
+                stageMetrics[name] = result.fit.getMetrics()
+                fitStages.append(name)
+        for stage, metrics in stageMetrics.items():
+            self.log.info("%s: %d calls, %.3f s wall, %.3f s CPU", stage, metrics.nCalls,
+                          metrics.wallSeconds, metrics.cpuSeconds)
+
+        if self.config.recordStageMetrics:
+            for stage, metrics in stageMetrics.items():
+                add_stage_metrics(self.job, stage, metrics)
+            for stage in fitStages:
+                add_stage_metrics(self.job, stage, stageMetrics[stage], fields=STAGE_FIT_METRICS)
+        return stageMetrics
+
     def _do_load_refcat_and_fit(self, associations, defaultFilter, center, radius,
                                 name="", refObjLoader=None, referenceSelector=None,
                                 filters=[], fit_function=None,
@@ -591,6 +889,14 @@ class JointcalTask(pipeBase.CmdLineTask):
             Result of `fit_function()`
         """
         self.log.info("====== Now processing %s...", name)
+        dataName = "{}_{}".format(tract, defaultFilter)
+        checkpointPath = self._get_checkpoint_path(name, dataName)
+        if self.config.incremental:
+            return self._fit_incremental(associations, checkpointPath, name, dataName, fit_function,
+                                         match_cut)
+        if checkpointPath is not None and os.path.exists(checkpointPath):
+            return self._restore_checkpoint(associations, checkpointPath, name, dataName, fit_function)
+
         # TODO: this should not print "trying to invert a singular transformation:"
         # if it does that, something's not right about the WCS...
         associations.associateCatalogs(match_cut)
@@ -612,6 +918,8 @@ class JointcalTask(pipeBase.CmdLineTask):
                         associations.refStarListSize())
 
         associations.prepareFittedStars(self.config.minMeasurements)
+        if self.config.sortStarsSpatially:
+            associations.sortStarsSpatially()
 
         self._check_star_lists(associations, name)
         add_measurement(self.job, 'jointcal.selected_%s_refStars' % name,
@@ -622,9 +930,14 @@ class JointcalTask(pipeBase.CmdLineTask):
                         associations.nCcdImagesValidForFit())
 
         load_cat_prof_file = 'jointcal_fit_%s.prof'%name if profile_jointcal else ''
-        dataName = "{}_{}".format(tract, defaultFilter)
         with pipeBase.cmdLineTask.profile(load_cat_prof_file):
             result = fit_function(associations, dataName)
+        if checkpointPath is not None:
+            # The chips of a constrained model are saved too, to fit new visits incrementally.
+            chipParameters = {}
+            if hasattr(result.model, "getChipParameters"):
+                chipParameters = result.model.getChipParameters()
+            lsst.jointcal.FitCheckpoint.write(checkpointPath, associations, result.fit, chipParameters)
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -633,6 +946,105 @@ class JointcalTask(pipeBase.CmdLineTask):
 
         return result
 
+    def _get_checkpoint_path(self, name, dataName):
+        """Return the path of the checkpoint of a fit stage, or None if
+        checkpoints are disabled.
+        """
+        if self.config.checkpointDir is None:
+            return None
+        return os.path.join(self.config.checkpointDir, f"jointcal_{name}_{dataName}.checkpoint")
+
+    def _restore_checkpoint(self, associations, path, name, dataName, fit_function):
+        """Restore the associations and fit of a stage from its checkpoint,
+        in place of associating, loading the reference catalog and fitting.
+
+        Parameters
+        ----------
+        associations : `lsst.jointcal.Associations`
+            The associations to restore, with all their ccdImages created.
+        path : `str`
+            The checkpoint written by a previous run of this stage.
+        name : `str`
+            Name of thing being fit: "astrometry" or "photometry".
+        dataName : `str`
+            Name of the data being processed (e.g. "1234_HSC-Y").
+        fit_function : callable
+            Function that performs the fit; it is passed the checkpoint, to
+            restore its fitter instead of fitting.
+
+        Returns
+        -------
+        result : `Photometry` or `Astrometry`
+            Result of `fit_function()`
+        """
+        self.log.info("Restoring %s from checkpoint %s", name, path)
+        checkpoint = lsst.jointcal.FitCheckpoint(path)
+        checkpoint.restoreAssociations(associations)
+        add_measurement(self.job, 'jointcal.selected_%s_refStars' % name,
+                        associations.nFittedStarsWithAssociatedRefStar())
+        add_measurement(self.job, 'jointcal.selected_%s_fittedStars' % name,
+                        associations.fittedStarListSize())
+        add_measurement(self.job, 'jointcal.selected_%s_ccdImages' % name,
+                        associations.nCcdImagesValidForFit())
+        return fit_function(associations, dataName, checkpoint=checkpoint)
+
+    def _fit_incremental(self, associations, path, name, dataName, fit_function, match_cut):
+        """Fit the new visits of associations against the solution saved
+        in the checkpoint of this stage, in place of associating, loading
+        the reference catalog and fitting all the visits.
+
+        Parameters
+        ----------
+        associations : `lsst.jointcal.Associations`
+            The associations to fit, with the ccdImages of the new visits.
+        path : `str`
+            The checkpoint of the saved solution.
+        name : `str`
+            Name of thing being fit: "astrometry" or "photometry".
+        dataName : `str`
+            Name of the data being processed (e.g. "1234_HSC-Y").
+        fit_function : callable
+            Function that performs the fit; it is passed the checkpoint, to
+            warm-start the chips of its model from.
+        match_cut : `float`
+            Radius in arcseconds to match the new catalogs to the saved
+            fittedStars.
+
+        Returns
+        -------
+        result : `Photometry` or `Astrometry`
+            Result of `fit_function()`
+
+        Raises
+        ------
+        RuntimeError
+            Raised if there is no checkpoint to start from.
+        """
+        if not os.path.exists(path):
+            raise RuntimeError(f"Cannot fit {name} incrementally: no saved solution in {path}.")
+        self.log.info("Fitting %s incrementally from checkpoint %s", name, path)
+        checkpoint = lsst.jointcal.FitCheckpoint(path)
+        newVisits = {ccdImage.visit for ccdImage in associations.getCcdImageList()}
+        savedVisits = newVisits.intersection(checkpoint.getVisits())
+        if savedVisits:
+            self.log.warn("Visits %s are already in the saved solution: their measurements count twice.",
+                          sorted(savedVisits))
+
+        checkpoint.restoreStars(associations)
+        associations.associateNewCatalogs(match_cut, self.config.minMeasurements)
+        if self.config.sortStarsSpatially:
+            associations.sortStarsSpatially()
+
+        self._check_star_lists(associations, name)
+        # The refStars of an incremental fit are the priors on the saved stars, not reference stars.
+        add_measurement(self.job, 'jointcal.selected_%s_priorStars' % name,
+                        associations.nFittedStarsWithAssociatedRefStar())
+        add_measurement(self.job, 'jointcal.selected_%s_fittedStars' % name,
+                        associations.fittedStarListSize())
+        add_measurement(self.job, 'jointcal.selected_%s_ccdImages' % name,
+                        associations.nCcdImagesValidForFit())
+        return fit_function(associations, dataName, checkpoint=checkpoint, incremental=True)
+
     def _load_reference_catalog(self, refObjLoader, referenceSelector, center, radius, filterName,
                                 applyColorterms=False):
         """Load the necessary reference catalog sources, convert fluxes to
@@ -741,7 +1153,45 @@ class JointcalTask(pipeBase.CmdLineTask):
             raise ValueError("Model is not valid: check log messages for warnings.")
         return chi2
 
-    def _fit_photometry(self, associations, dataName=None):
+    def _configure_fitter(self, fit):
+        """Apply the fitter-level (threading, linear algebra, solver) config options.
+
+        Parameters
+        ----------
+        fit : `lsst.jointcal.FitterBase`
+            The fitter to configure.
+        """
+        fit.setNThreads(self.config.nThreads)
+        modes = {"simplicialLDLT": lsst.jointcal.CholmodMode.SimplicialLDLT,
+                 "supernodalLLT": lsst.jointcal.CholmodMode.SupernodalLLT}
+        fit.setFactorizationMode(modes[self.config.factorizationMode])
+        orderings = {"default": lsst.jointcal.HessianOrdering.Default,
+                     "amd": lsst.jointcal.HessianOrdering.AMD,
+                     "nestedDissection": lsst.jointcal.HessianOrdering.NestedDissection,
+                     "starsFirst": lsst.jointcal.HessianOrdering.StarsFirst}
+        fit.setOrdering(orderings[self.config.factorizationOrdering])
+        fit.setMaxDowndateDrift(self.config.maxDowndateDrift)
+        fit.setMaxDenseBorder(self.config.maxDenseBorder)
+        fit.setSplitComponents(self.config.splitComponents)
+        solvers = {"direct": lsst.jointcal.SolverMode.Direct,
+                   "schurComplement": lsst.jointcal.SolverMode.SchurComplement,
+                   "conjugateGradient": lsst.jointcal.SolverMode.ConjugateGradient}
+        fit.setSolverMode(solvers[self.config.solverMode])
+        fit.setConjugateGradientTolerance(self.config.conjugateGradientTolerance)
+        fit.setConjugateGradientMaxIterations(self.config.conjugateGradientMaxIterations)
+        fit.setAlternatingTolerance(self.config.alternatingTolerance)
+        fit.setAlternatingMaxIterations(self.config.alternatingMaxIterations)
+        fit.setLevenbergMarquardtDamping(self.config.levenbergMarquardtDamping)
+        losses = {"none": (lsst.jointcal.RobustLoss.Quadratic, 1.0),
+                  "huber": (lsst.jointcal.RobustLoss.Huber, 1.345),
+                  "cauchy": (lsst.jointcal.RobustLoss.Cauchy, 2.385)}
+        loss, scale = losses[self.config.robustLoss]
+        if self.config.robustLossScale is not None:
+            scale = self.config.robustLossScale
+        fit.setRobustLoss(loss, scale)
+        fit.setRobustMaxIterations(self.config.robustMaxIterations)
+
+    def _fit_photometry(self, associations, dataName=None, checkpoint=None, incremental=False):
         """
         Fit the photometric data.
 
@@ -752,6 +1202,13 @@ class JointcalTask(pipeBase.CmdLineTask):
         dataName : `str`
             Name of the data being processed (e.g. "1234_HSC-Y"), for
             identifying debugging files.
+        checkpoint : `lsst.jointcal.FitCheckpoint`, optional
+            Checkpoint of a previous fit of these associations: restore its
+            parameters instead of fitting.
+        incremental : `bool`, optional
+            The checkpoint is the solution that the visits of associations
+            are added to: only fit the visits, with the chips of the saved
+            solution.
 
         Returns
         -------
@@ -788,6 +1245,23 @@ class JointcalTask(pipeBase.CmdLineTask):
             doLineSearch = False  # purely linear in model parameters, so no line search needed
 
         fit = lsst.jointcal.PhotometryFit(associations, model)
+        self._configure_fitter(fit)
+        if incremental:
+            model.setChipParameters(checkpoint.getChipParameters())
+            self._fit_new_visits(associations, fit, model, "photometry", "ModelVisit", "Fluxes",
+                                 self.config.maxPhotometrySteps, dataName,
+                                 doRankUpdate=self.config.photometryDoRankUpdate,
+                                 doLineSearch=doLineSearch)
+            return Photometry(fit, model)
+        if checkpoint is not None:
+            checkpoint.restoreFitter(fit)
+            # Frozen at the restored parameters rather than at those before the final fit.
+            model.freezeErrorTransform()
+            chi2 = self._logChi2AndValidate(associations, fit, model, "Restored")
+            add_measurement(self.job, 'jointcal.photometry_final_chi2', chi2.chi2)
+            add_measurement(self.job, 'jointcal.photometry_final_ndof', chi2.ndof)
+            return Photometry(fit, model)
+
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -838,7 +1312,7 @@ class JointcalTask(pipeBase.CmdLineTask):
         add_measurement(self.job, 'jointcal.photometry_final_ndof', chi2.ndof)
         return Photometry(fit, model)
 
-    def _fit_astrometry(self, associations, dataName=None):
+    def _fit_astrometry(self, associations, dataName=None, checkpoint=None, incremental=False):
         """
         Fit the astrometric data.
 
@@ -849,6 +1323,13 @@ class JointcalTask(pipeBase.CmdLineTask):
         dataName : `str`
             Name of the data being processed (e.g. "1234_HSC-Y"), for
             identifying debugging files.
+        checkpoint : `lsst.jointcal.FitCheckpoint`, optional
+            Checkpoint of a previous fit of these associations: restore its
+            parameters instead of fitting.
+        incremental : `bool`, optional
+            The checkpoint is the solution that the visits of associations
+            are added to: only fit the visits, with the chips of the saved
+            solution.
 
         Returns
         -------
@@ -863,7 +1344,9 @@ class JointcalTask(pipeBase.CmdLineTask):
 
         self.log.info("=== Starting astrometric fitting...")
 
-        associations.deprojectFittedStars()
+        if checkpoint is None or incremental:
+            # The restored fittedStars are already on the sky.
+            associations.deprojectFittedStars()
 
         # NOTE: need to return sky_to_tan_projection so that it doesn't get garbage collected.
         # TODO: could we package sky_to_tan_projection and model together so we don't have to manage
@@ -883,6 +1366,20 @@ class JointcalTask(pipeBase.CmdLineTask):
                                                         order=self.config.astrometrySimpleOrder)
 
         fit = lsst.jointcal.AstrometryFit(associations, model, self.config.positionErrorPedestal)
+        self._configure_fitter(fit)
+        if incremental:
+            model.setChipParameters(checkpoint.getChipParameters())
+            self._fit_new_visits(associations, fit, model, "astrometry", "DistortionsVisit", "Positions",
+                                 self.config.maxAstrometrySteps, dataName,
+                                 doRankUpdate=self.config.astrometryDoRankUpdate)
+            return Astrometry(fit, model, sky_to_tan_projection)
+        if checkpoint is not None:
+            checkpoint.restoreFitter(fit)
+            chi2 = self._logChi2AndValidate(associations, fit, model, "Restored")
+            add_measurement(self.job, 'jointcal.astrometry_final_chi2', chi2.chi2)
+            add_measurement(self.job, 'jointcal.astrometry_final_ndof', chi2.ndof)
+            return Astrometry(fit, model, sky_to_tan_projection)
+
         # TODO DM-12446: turn this into a "butler save" somehow.
         # Save reference and measurement chi2 contributions for this data
         if self.config.writeChi2FilesInitialFinal:
@@ -928,6 +1425,61 @@ class JointcalTask(pipeBase.CmdLineTask):
 
         return Astrometry(fit, model, sky_to_tan_projection)
 
+    def _fit_new_visits(self, associations, fit, model, name, visitWhatToFit, starWhatToFit, max_steps,
+                        dataName, doRankUpdate=True, doLineSearch=False):
+        """Fit the visit transforms and the stars of an incremental fit,
+        with the chips frozen at their saved solution.
+
+        Parameters
+        ----------
+        associations : `lsst.jointcal.Associations`
+            The star/reference star associations to fit.
+        fit : `lsst.jointcal.FitterBase`
+            The fitter, whose model chips are set to the saved solution.
+        model : `lsst.jointcal.AstrometryModel` or `lsst.jointcal.PhotometryModel`
+            The model being fit.
+        name : `str`
+            Name of the fit stage: "astrometry" or "photometry".
+        visitWhatToFit : `str`
+            What to fit to only fit the visits of the model.
+        starWhatToFit : `str`
+            What to fit to fit the stars.
+        max_steps : `int`
+            Maximum number of outlier rejection steps.
+        dataName : `str`
+            Name of the data being processed (e.g. "1234_HSC-Y").
+        doRankUpdate : `bool`, optional
+            Do an Eigen rank update during minimization.
+        doLineSearch : `bool`, optional
+            Do a line search for the optimum step during minimization?
+
+        Returns
+        -------
+        chi2: `lsst.jointcal.Chi2Accumulator`
+            The final chi2 of the fit.
+        """
+        self._logChi2AndValidate(associations, fit, model, "Initial")
+        fit.minimize(visitWhatToFit)
+        self._logChi2AndValidate(associations, fit, model)
+        fit.minimize(starWhatToFit)
+        self._logChi2AndValidate(associations, fit, model, "Fit prepared")
+        if name == "photometry":
+            model.freezeErrorTransform()
+            self.log.debug("Photometry error scales are frozen.")
+
+        chi2 = self._iterate_fit(associations,
+                                 fit,
+                                 max_steps,
+                                 name,
+                                 f"{visitWhatToFit} {starWhatToFit}",
+                                 doRankUpdate=doRankUpdate,
+                                 doLineSearch=doLineSearch,
+                                 dataName=dataName)
+
+        add_measurement(self.job, f'jointcal.{name}_final_chi2', chi2.chi2)
+        add_measurement(self.job, f'jointcal.{name}_final_ndof', chi2.ndof)
+        return chi2
+
     def _check_stars(self, associations):
         """Count measured and reference stars per ccd and warn/log them."""
         for ccdImage in associations.getCcdImageList():
@@ -982,28 +1534,47 @@ class JointcalTask(pipeBase.CmdLineTask):
             Raised if the fitter fails for some other reason;
             log messages will provide further details.
         """
+        if self.config.compareOrderings:
+            for cost in fitter.compareOrderings(whatToFit):
+                self.log.info("%s %s ordering: %g factor non-zeros, %g flops (analysis %.3g s)%s",
+                              name, cost.ordering.name, cost.factorNonZeros, cost.factorizationFlops,
+                              cost.analysisSeconds, "" if cost.available else ", not available")
         dumpMatrixFile = "%s_postinit" % name if self.config.writeInitMatrix else ""
         for i in range(max_steps):
+            if self.config.rollbackChi2Increase:
+                # getParameters() copies them in the layout of the last assignIndices().
+                if fitter.getWhatToFit() != whatToFit:
+                    fitter.assignIndices(whatToFit)
+                previousParameters = fitter.getParameters()
             if self.config.writeChi2FilesOuterLoop:
                 writeChi2Name = f"{name}_iterate_{i}_chi2-{dataName}"
             else:
                 writeChi2Name = None
-            result = fitter.minimize(whatToFit,
-                                     self.config.outlierRejectSigma,
-                                     doRankUpdate=doRankUpdate,
-                                     doLineSearch=doLineSearch,
-                                     dumpMatrixFile=dumpMatrixFile)
+            if self.config.finalFit == "joint":
+                result = fitter.minimize(whatToFit,
+                                         self.config.outlierRejectSigma,
+                                         doRankUpdate=doRankUpdate,
+                                         doLineSearch=doLineSearch,
+                                         dumpMatrixFile=dumpMatrixFile)
+            else:
+                result = fitter.minimizeAlternating(whatToFit,
+                                                    self.config.outlierRejectSigma,
+                                                    doLineSearch=doLineSearch,
+                                                    finishJointly=self.config.finalFit != "alternating")
             dumpMatrixFile = ""  # clear it so we don't write the matrix again.
+            self.log.debug("%s step %d: %d work buffer allocations", name, i, fitter.getNScratchAllocations())
+            if self.config.levenbergMarquardtDamping > 0:
+                for trial in fitter.getDampingHistory():
+                    self.log.debug("damping %g: chi2 reduction %g (predicted %g)%s", trial.damping,
+                                   trial.actualReduction, trial.predictedReduction,
+                                   "" if trial.accepted else ", rejected")
             chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(),
                                             writeChi2Name=writeChi2Name)
 
             if result == MinimizeResult.Converged:
-                if doRankUpdate:
-                    self.log.debug("fit has converged - no more outliers - redo minimization "
-                                   "one more time in case we have lost accuracy in rank update.")
-                    # Redo minimization one more time in case we have lost accuracy in rank update
-                    result = fitter.minimize(whatToFit, self.config.outlierRejectSigma)
-                    chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(), "Fit completed")
+                # No need to redo the minimization for accuracy after rank updates: minimize() refactors
+                # the Hessian itself if the downdated factor drifted (see maxDowndateDrift).
+                self.log.info("%s %s", "Fit completed", chi2)
 
                 # log a message for a large final chi2, TODO: DM-15247 for something better
                 if chi2.chi2/chi2.ndof >= 4.0:
@@ -1012,6 +1583,12 @@ class JointcalTask(pipeBase.CmdLineTask):
                 break
             elif result == MinimizeResult.Chi2Increased:
                 self.log.warn("still some outliers but chi2 increases - retry")
+                if self.config.rollbackChi2Increase:
+                    if fitter.getWhatToFit() != whatToFit:
+                        fitter.assignIndices(whatToFit)
+                    fitter.setParameters(previousParameters)
+                    chi2 = self._logChi2AndValidate(associations, fitter, fitter.getModel(),
+                                                    "Rolled back to")
             elif result == MinimizeResult.NonFinite:
                 filename = "{}_failure-nonfinite_chi2-{}.csv".format(name, dataName)
                 # TODO DM-12446: turn this into a "butler save" somehow.
@@ -71,6 +71,7 @@ void declarePhotometryMapping(py::module &mod) {
     cls.def(py::init<std::shared_ptr<PhotometryTransform>>(), "transform"_a);
 
     cls.def("offsetParams", &PhotometryMapping::offsetParams);
+    cls.def("setParameters", &PhotometryMapping::setParameters, "parameters"_a);
     cls.def("getTransform", &PhotometryMapping::getTransform);
     cls.def("getTransformErrors", &PhotometryMapping::getTransformErrors);
 }
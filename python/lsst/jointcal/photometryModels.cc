@@ -49,6 +49,7 @@ void declarePhotometryModel(py::module &mod) {
 
     cls.def("assignIndices", &PhotometryModel::assignIndices);
     cls.def("freezeErrorTransform", &PhotometryModel::freezeErrorTransform);
+    cls.def("isLinear", &PhotometryModel::isLinear);
 
     cls.def("offsetParams", &PhotometryModel::offsetParams);
     cls.def("offsetFittedStar", &PhotometryModel::offsetFittedStar);
@@ -99,6 +100,9 @@ void declareSimpleMagnitudeModel(py::module &mod) {
 void declareConstrainedPhotometryModel(py::module &mod) {
     py::class_<ConstrainedPhotometryModel, std::shared_ptr<ConstrainedPhotometryModel>, PhotometryModel> cls(
             mod, "ConstrainedPhotometryModel");
+
+    cls.def("getChipParameters", &ConstrainedPhotometryModel::getChipParameters);
+    cls.def("setChipParameters", &ConstrainedPhotometryModel::setChipParameters, "chipParameters"_a);
 }
 
 void declareConstrainedFluxModel(py::module &mod) {
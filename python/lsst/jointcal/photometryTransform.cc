@@ -53,6 +53,7 @@ void declarePhotometryTransform(py::module &mod) {
     cls.def("clone", &PhotometryTransform::clone);
     cls.def("getNpar", &PhotometryTransform::getNpar);
     cls.def("getParameters", &PhotometryTransform::getParameters);
+    cls.def("setParameters", &PhotometryTransform::setParameters, "parameters"_a);
     cls.def("computeParameterDerivatives",
             [](PhotometryTransform const &self, double x, double y, double instFlux) {
                 Eigen::VectorXd derivatives(self.getNpar());
@@ -89,6 +89,8 @@ void declareFittedStar(py::module &mod) {
 
     cls.def(py::init<>());
     cls.def(py::init<BaseStar const &>(), "baseStar"_a);
+
+    cls.def("getRobustWeight", &FittedStar::getRobustWeight);
 }
 
 void declareMeasuredStar(py::module &mod) {
@@ -109,6 +111,7 @@ void declareMeasuredStar(py::module &mod) {
     cls.def("setYFocal", &MeasuredStar::setYFocal);
     cls.def("getXFocal", &MeasuredStar::getXFocal);
     cls.def("getYFocal", &MeasuredStar::getYFocal);
+    cls.def("getRobustWeight", &MeasuredStar::getRobustWeight);
 }
 
 PYBIND11_MODULE(star, mod) {
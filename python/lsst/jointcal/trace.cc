@@ -0,0 +1,47 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "pybind11/pybind11.h"
+
+#include "lsst/jointcal/Trace.h"
+
+namespace py = pybind11;
+using namespace pybind11::literals;
+
+namespace lsst {
+namespace jointcal {
+namespace {
+
+void declareTrace(py::module &mod) {
+    py::class_<Trace> cls(mod, "Trace");
+
+    cls.def_static("start", &Trace::start);
+    cls.def_static("stop", &Trace::stop, "path"_a);
+    cls.def_static("isEnabled", &Trace::isEnabled);
+}
+
+PYBIND11_MODULE(trace, mod) { declareTrace(mod); }
+}  // namespace
+}  // namespace jointcal
+}  // namespace lsst
@@ -22,13 +22,17 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cmath>
+#include <cstdint>
 #include <iostream>
 #include <limits>
 #include <sstream>
+#include <unordered_set>
 
 #include "lsst/log/Log.h"
 #include "lsst/jointcal/Associations.h"
+#include "lsst/jointcal/Trace.h"
 #include "lsst/jointcal/CcdImage.h"
 #include "lsst/jointcal/StarMatch.h"
 #include "lsst/jointcal/ListMatch.h"
@@ -50,8 +54,44 @@ namespace jointcal = lsst::jointcal;
 
 namespace {
 LOG_LOGGER _log = LOG_GET("jointcal.Associations");
+
+// The bounding square of the stars is divided in 2^hilbertOrder x 2^hilbertOrder cells along the curve.
+unsigned const hilbertOrder = 16;
+
+/// Distance along the Hilbert curve of cell (x, y) of the 2^hilbertOrder square grid.
+std::uint64_t hilbertIndex(std::uint32_t x, std::uint32_t y) {
+    std::uint32_t const n = 1u << hilbertOrder;
+    std::uint64_t index = 0;
+    for (std::uint32_t s = n / 2; s > 0; s /= 2) {
+        std::uint32_t const rx = (x & s) > 0;
+        std::uint32_t const ry = (y & s) > 0;
+        index += static_cast<std::uint64_t>(s) * s * ((3 * rx) ^ ry);
+        // rotate the quadrant, so that the curve is continuous between quadrants.
+        if (ry == 0) {
+            if (rx == 1) {
+                x = n - 1 - x;
+                y = n - 1 - y;
+            }
+            std::swap(x, y);
+        }
+    }
+    return index;
 }
 
+/// Stable sort of a list of stars by the given keys, one per star in list order.
+template <class List>
+void sortByKeys(List &list, std::vector<std::uint64_t> const &keys) {
+    std::vector<std::pair<std::uint64_t, typename List::value_type>> sorted;
+    sorted.reserve(list.size());
+    auto key = keys.begin();
+    for (auto &star : list) sorted.emplace_back(*key++, std::move(star));
+    std::stable_sort(sorted.begin(), sorted.end(),
+                     [](auto const &a, auto const &b) { return a.first < b.first; });
+    list.clear();
+    for (auto &item : sorted) list.push_back(std::move(item.second));
+}
+}  // namespace
+
 namespace lsst {
 namespace jointcal {
 
@@ -62,6 +102,9 @@ void Associations::createCcdImage(afw::table::SourceCatalog &catalog,
                                   std::shared_ptr<afw::image::PhotoCalib> photoCalib,
                                   std::shared_ptr<afw::cameraGeom::Detector> detector, int visit, int ccd,
                                   lsst::jointcal::JointcalControl const &control) {
+    StageTimer timer(_loadCatalogMetrics);
+    JOINTCAL_TRACE_SPAN_DETAIL("loadCatalog",
+                               "visit=" + std::to_string(visit) + " ccd=" + std::to_string(ccd));
     auto ccdImage = std::make_shared<CcdImage>(catalog, wcs, visitInfo, bbox, filter, photoCalib, detector,
                                                visit, ccd, control.sourceFluxField);
     ccdImageList.push_back(ccdImage);
@@ -87,6 +130,7 @@ void Associations::setCommonTangentPoint(lsst::afw::geom::Point2D const &commonT
 
 void Associations::associateCatalogs(const double matchCutInArcSec, const bool useFittedList,
                                      const bool enlargeFittedList) {
+    StageTimer timer(_associateCatalogsMetrics);
     // clear reference stars
     refStarList.clear();
 
@@ -95,71 +139,15 @@ void Associations::associateCatalogs(const double matchCutInArcSec, const bool u
         item->clearBeforeAssoc();
     }
     // clear fitted stars
-    if (!useFittedList) fittedStarList.clear();
+    if (!useFittedList) {
+        fittedStarList.clear();
+        // the new fittedStars are created on the common tangent plane.
+        fittedStarList.inTangentPlaneCoordinates = true;
+    }
 
     for (auto &ccdImage : ccdImageList) {
-        std::shared_ptr<AstrometryTransform> toCommonTangentPlane = ccdImage->getPixelToCommonTangentPlane();
-
-        // Clear the catalog to fit and copy the whole catalog into it.
-        // This allows reassociating from scratch after a fit.
-        ccdImage->resetCatalogForFit();
-        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
-
-        // Associate with previous lists.
-        /* To speed up the match (more precisely the contruction of the FastFinder), select in the
-         fittedStarList the objects that are within reach of the current ccdImage */
-        Frame ccdImageFrameCPT = toCommonTangentPlane->apply(ccdImage->getImageFrame(), false);
-        ccdImageFrameCPT = ccdImageFrameCPT.rescale(1.10);  // add 10 % margin.
-        // We cannot use FittedStarList::ExtractInFrame, because it does an actual copy, which we don't want
-        // here: we want the pointers in the StarMatch to refer to fittedStarList elements.
-        FittedStarList toMatch;
-
-        for (auto const &fittedStar : fittedStarList) {
-            if (ccdImageFrameCPT.inFrame(*fittedStar)) {
-                toMatch.push_back(fittedStar);
-            }
-        }
-
-        // divide by 3600 because coordinates in CTP are in degrees.
-        auto starMatchList = listMatchCollect(Measured2Base(catalog), Fitted2Base(toMatch),
-                                              toCommonTangentPlane.get(), matchCutInArcSec / 3600.);
-
-        /* should check what this removeAmbiguities does... */
-        LOGLS_DEBUG(_log, "Measured-to-Fitted matches before removing ambiguities " << starMatchList->size());
-        starMatchList->removeAmbiguities(*toCommonTangentPlane);
-        LOGLS_DEBUG(_log, "Measured-to-Fitted matches after removing ambiguities " << starMatchList->size());
-
-        // Associate MeasuredStar -> FittedStar using the surviving matches.
-
-        int matchedCount = 0;
-        for (auto const &starMatch : *starMatchList) {
-            auto bs = starMatch.s1;
-            auto ms_const = std::dynamic_pointer_cast<const MeasuredStar>(bs);
-            auto ms = std::const_pointer_cast<MeasuredStar>(ms_const);
-            auto bs2 = starMatch.s2;
-            auto fs_const = std::dynamic_pointer_cast<const FittedStar>(bs2);
-            auto fs = std::const_pointer_cast<FittedStar>(fs_const);
-            ms->setFittedStar(fs);
-            matchedCount++;
-        }
-        LOGLS_INFO(_log, "Matched " << matchedCount << " objects in " << ccdImage->getName());
-
-        // add unmatched objets to FittedStarList
-        int unMatchedCount = 0;
-        for (auto const &mstar : catalog) {
-            // to check if it was matched, just check if it has a fittedStar Pointer assigned
-            if (mstar->getFittedStar()) continue;
-            if (enlargeFittedList) {
-                auto fs = std::make_shared<FittedStar>(*mstar);
-                // transform coordinates to CommonTangentPlane
-                toCommonTangentPlane->transformPosAndErrors(*fs, *fs);
-                fittedStarList.push_back(fs);
-                mstar->setFittedStar(fs);
-            }
-            unMatchedCount++;
-        }
-        LOGLS_INFO(_log, "Unmatched objects: " << unMatchedCount);
-    }  // end of loop on CcdImages
+        associateCatalog(*ccdImage, matchCutInArcSec, enlargeFittedList);
+    }
 
     // !!!!!!!!!!!!!!!!!
     // TODO: DO WE REALLY NEED THIS???
@@ -169,8 +157,151 @@ void Associations::associateCatalogs(const double matchCutInArcSec, const bool u
     // assignMags();
 }
 
+void Associations::associateCatalog(CcdImage &ccdImage, double matchCutInArcSec, bool enlargeFittedList) {
+    JOINTCAL_TRACE_SPAN_DETAIL("associateCatalog", ccdImage.getName());
+    std::shared_ptr<AstrometryTransform> toCommonTangentPlane = ccdImage.getPixelToCommonTangentPlane();
+
+    // Clear the catalog to fit and copy the whole catalog into it.
+    // This allows reassociating from scratch after a fit.
+    ccdImage.resetCatalogForFit();
+    MeasuredStarList &catalog = ccdImage.getCatalogForFit();
+
+    // Associate with previous lists.
+    /* To speed up the match (more precisely the contruction of the FastFinder), select in the
+     fittedStarList the objects that are within reach of the current ccdImage */
+    Frame ccdImageFrameCPT = toCommonTangentPlane->apply(ccdImage.getImageFrame(), false);
+    ccdImageFrameCPT = ccdImageFrameCPT.rescale(1.10);  // add 10 % margin.
+    // We cannot use FittedStarList::ExtractInFrame, because it does an actual copy, which we don't want
+    // here: we want the pointers in the StarMatch to refer to fittedStarList elements.
+    FittedStarList toMatch;
+
+    for (auto const &fittedStar : fittedStarList) {
+        if (ccdImageFrameCPT.inFrame(*fittedStar)) {
+            toMatch.push_back(fittedStar);
+        }
+    }
+
+    // divide by 3600 because coordinates in CTP are in degrees.
+    auto starMatchList = listMatchCollect(Measured2Base(catalog), Fitted2Base(toMatch),
+                                          toCommonTangentPlane.get(), matchCutInArcSec / 3600.);
+
+    /* should check what this removeAmbiguities does... */
+    LOGLS_DEBUG(_log, "Measured-to-Fitted matches before removing ambiguities " << starMatchList->size());
+    starMatchList->removeAmbiguities(*toCommonTangentPlane);
+    LOGLS_DEBUG(_log, "Measured-to-Fitted matches after removing ambiguities " << starMatchList->size());
+
+    // Associate MeasuredStar -> FittedStar using the surviving matches.
+
+    int matchedCount = 0;
+    for (auto const &starMatch : *starMatchList) {
+        auto bs = starMatch.s1;
+        auto ms_const = std::dynamic_pointer_cast<const MeasuredStar>(bs);
+        auto ms = std::const_pointer_cast<MeasuredStar>(ms_const);
+        auto bs2 = starMatch.s2;
+        auto fs_const = std::dynamic_pointer_cast<const FittedStar>(bs2);
+        auto fs = std::const_pointer_cast<FittedStar>(fs_const);
+        ms->setFittedStar(fs);
+        matchedCount++;
+    }
+    LOGLS_INFO(_log, "Matched " << matchedCount << " objects in " << ccdImage.getName());
+
+    // add unmatched objets to FittedStarList
+    int unMatchedCount = 0;
+    for (auto const &mstar : catalog) {
+        // to check if it was matched, just check if it has a fittedStar Pointer assigned
+        if (mstar->getFittedStar()) continue;
+        if (enlargeFittedList) {
+            auto fs = std::make_shared<FittedStar>(*mstar);
+            // transform coordinates to CommonTangentPlane
+            toCommonTangentPlane->transformPosAndErrors(*fs, *fs);
+            fittedStarList.push_back(fs);
+            mstar->setFittedStar(fs);
+        }
+        unMatchedCount++;
+    }
+    LOGLS_INFO(_log, "Unmatched objects: " << unMatchedCount);
+}
+
+void Associations::associateNewCatalogs(double matchCutInArcSec, int minMeasurements) {
+    StageTimer timer(_associateCatalogsMetrics);
+    // The saved fittedStars are anchored by priors that stand for the measurements they were fit to: their
+    // solution, with the error of one measurement divided by the number of measurements. Like refStars, the
+    // priors are on the sky.
+    TanPixelToRaDec ctp2Sky(AstrometryTransformLinear(), getCommonTangentPoint());
+    std::unordered_set<FittedStar const *> savedStars;
+    RefStarList priors;
+    for (auto &fittedStar : fittedStarList) {
+        FatPoint onSky = *fittedStar;
+        if (fittedStarList.inTangentPlaneCoordinates) ctp2Sky.transformPosAndErrors(*fittedStar, onSky);
+        double const count = std::max(fittedStar->getMeasurementCount(), 1);
+        auto prior = std::make_shared<RefStar>(onSky.x, onSky.y, fittedStar->getFlux(),
+                                               fittedStar->getFluxErr() / std::sqrt(count));
+        prior->vx = onSky.vx / count;
+        prior->vy = onSky.vy / count;
+        prior->vxy = onSky.vxy / count;
+        prior->getMag() = fittedStar->getMag();
+        prior->setMagErr(fittedStar->getMagErr() / std::sqrt(count));
+        fittedStar->setRefStar(nullptr);
+        fittedStar->setRefStar(prior.get());
+        // from now on, only count the new measurements.
+        fittedStar->getMeasurementCount() = 0;
+        savedStars.insert(fittedStar.get());
+        priors.push_back(std::move(prior));
+    }
+    refStarList.swap(priors);
+
+    // The new catalogs are matched on the common tangent plane.
+    if (!fittedStarList.inTangentPlaneCoordinates) {
+        TanRaDecToPixel sky2ctp(AstrometryTransformLinear(), getCommonTangentPoint());
+        fittedStarList.applyTransform(sky2ctp);
+        fittedStarList.inTangentPlaneCoordinates = true;
+    }
+    for (auto &ccdImage : ccdImageList) {
+        associateCatalog(*ccdImage, matchCutInArcSec, true);
+    }
+
+    // Drops the saved fittedStars that no new measurement touches, and the new ones with too few
+    // measurements; the others all have a prior.
+    selectFittedStars(minMeasurements);
+    std::unordered_set<RefStar const *> usedPriors;
+    for (auto const &fittedStar : fittedStarList) usedPriors.insert(fittedStar->getRefStar());
+    refStarList.remove_if([&usedPriors](std::shared_ptr<RefStar> const &prior) {
+        return usedPriors.count(prior.get()) == 0;
+    });
+
+    // Only the new fittedStars start from the average of their measurements.
+    for (auto &fittedStar : fittedStarList) {
+        if (savedStars.count(fittedStar.get())) continue;
+        fittedStar->x = 0.0;
+        fittedStar->y = 0.0;
+        fittedStar->setFlux(0.0);
+    }
+    for (auto const &ccdImage : ccdImageList) {
+        std::shared_ptr<AstrometryTransform> toCommonTangentPlane = ccdImage->getPixelToCommonTangentPlane();
+        for (auto const &measuredStar : ccdImage->getCatalogForFit()) {
+            auto fittedStar = measuredStar->getFittedStar();
+            if (savedStars.count(fittedStar.get())) continue;
+            auto point = toCommonTangentPlane->apply(*measuredStar);
+            fittedStar->x += point.x / fittedStar->getMeasurementCount();
+            fittedStar->y += point.y / fittedStar->getMeasurementCount();
+            fittedStar->getFlux() += measuredStar->getFlux() / fittedStar->getMeasurementCount();
+        }
+    }
+    std::size_t nNewStars = 0;
+    for (auto &fittedStar : fittedStarList) {
+        if (savedStars.count(fittedStar.get())) continue;
+        fittedStar->getMag() = utils::nanojanskyToABMagnitude(fittedStar->getFlux());
+        ++nNewStars;
+    }
+    LOGLS_INFO(_log, "Associated the new catalogs with " << fittedStarList.size() - nNewStars << " of the "
+                                                         << savedStars.size() << " saved fittedStars, and "
+                                                         << nNewStars << " new fittedStars.");
+}
+
 void Associations::collectRefStars(afw::table::SimpleCatalog &refCat, afw::geom::Angle matchCut,
                                    std::string const &fluxField, bool rejectBadFluxes) {
+    StageTimer timer(_collectRefStarsMetrics);
+    JOINTCAL_TRACE_SPAN("collectRefStars");
     if (refCat.size() == 0) {
         throw(LSST_EXCEPT(pex::exceptions::InvalidParameterError,
                           " reference catalog is empty : stop here "));
@@ -384,6 +515,53 @@ void Associations::deprojectFittedStars() {
     fittedStarList.inTangentPlaneCoordinates = false;
 }
 
+void Associations::sortStarsSpatially() {
+    if (fittedStarList.empty()) return;
+    // Everything is ordered on the common tangent plane.
+    TanRaDecToPixel sky2ctp(AstrometryTransformLinear(), getCommonTangentPoint());
+    std::vector<Point> fittedPositions;
+    fittedPositions.reserve(fittedStarList.size());
+    for (auto const &fittedStar : fittedStarList) {
+        fittedPositions.push_back(fittedStarList.inTangentPlaneCoordinates ? Point(*fittedStar)
+                                                                           : sky2ctp.apply(*fittedStar));
+    }
+    double xMin = fittedPositions.front().x, xMax = xMin;
+    double yMin = fittedPositions.front().y, yMax = yMin;
+    for (auto const &position : fittedPositions) {
+        xMin = std::min(xMin, position.x);
+        xMax = std::max(xMax, position.x);
+        yMin = std::min(yMin, position.y);
+        yMax = std::max(yMax, position.y);
+    }
+    // square cells, so that the curve follows the actual distances; measurements outside of the fitted
+    // stars bounding square go to its edge.
+    double const cellSize = std::max({xMax - xMin, yMax - yMin, 1e-10}) / (1u << hilbertOrder);
+    auto cell = [cellSize](double value, double min) {
+        double const index = std::floor((value - min) / cellSize);
+        return static_cast<std::uint32_t>(std::min(std::max(index, 0.), double((1u << hilbertOrder) - 1)));
+    };
+    auto key = [&](Point const &position) {
+        return hilbertIndex(cell(position.x, xMin), cell(position.y, yMin));
+    };
+
+    std::vector<std::uint64_t> keys;
+    keys.reserve(fittedPositions.size());
+    for (auto const &position : fittedPositions) keys.push_back(key(position));
+    sortByKeys(fittedStarList, keys);
+
+    std::size_t nMeasured = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        MeasuredStarList &catalog = ccdImage->getCatalogForFit();
+        auto const &pixelToCtp = *ccdImage->getPixelToCommonTangentPlane();
+        keys.clear();
+        for (auto const &measuredStar : catalog) keys.push_back(key(pixelToCtp.apply(*measuredStar)));
+        sortByKeys(catalog, keys);
+        nMeasured += catalog.size();
+    }
+    LOGLS_DEBUG(_log, "Sorted " << fittedStarList.size() << " fitted stars and " << nMeasured
+                                << " measured stars along a Hilbert curve");
+}
+
 int Associations::nCcdImagesValidForFit() const {
     return std::count_if(ccdImageList.begin(), ccdImageList.end(), [](std::shared_ptr<CcdImage> const &item) {
         return item->getCatalogForFit().size() > 0;
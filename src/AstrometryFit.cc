@@ -25,6 +25,7 @@
 #include <iostream>
 #include <iomanip>
 #include <algorithm>
+#include <cmath>
 #include <fstream>
 
 #include "Eigen/Sparse"
@@ -96,14 +97,10 @@ Point AstrometryFit::transformFittedStar(FittedStar const &fittedStar, Astrometr
 
 /*! This is the first implementation of an error "model".  We'll
   certainly have to upgrade it. MeasuredStar provides the mag in case
-  we need it.  */
+  we need it.  No state is kept between calls, so that derivatives can be
+  computed concurrently.  */
 static void tweakAstromMeasurementErrors(FatPoint &P, MeasuredStar const &Ms, double error) {
-    static bool called = false;
-    static double increment = 0;
-    if (!called) {
-        increment = std::pow(error, 2);  // was in Preferences
-        called = true;
-    }
+    double increment = std::pow(error, 2);  // was in Preferences
     P.vx += increment;
     P.vy += increment;
 }
@@ -111,7 +108,7 @@ static void tweakAstromMeasurementErrors(FatPoint &P, MeasuredStar const &Ms, do
 // we could consider computing the chi2 here.
 // (although it is not extremely useful)
 void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
-                                                      Eigen::VectorXd &fullGrad,
+                                                      Eigen::VectorXd *fullGrad,
                                                       MeasuredStarList const *msList) const {
     /**********************************************************************/
     /* @note the math in this method and accumulateStatImage() must be kept consistent,
@@ -189,12 +186,12 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
         // PA - seems correct !
         alpha(1, 1) = 1. / sqrt(det * transW(0, 0));
         alpha(0, 1) = 0;
+        // down-weight the measurement if the fit is robust
+        transW *= ms.getRobustWeight();
+        alpha *= std::sqrt(ms.getRobustWeight());
 
         std::shared_ptr<FittedStar const> const fs = ms.getFittedStar();
 
-        Point fittedStarInTP =
-                transformFittedStar(*fs, *sky2TP, refractionVector, _refractionCoefficient, mjd);
-
         // compute derivative of TP position w.r.t sky position ....
         if (npar_pos > 0)  // ... if actually fitting FittedStar position
         {
@@ -229,31 +226,36 @@ void AstrometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
             ipar += 1;
         }
 
-        // We can now compute the residual
-        Eigen::Vector2d res(fittedStarInTP.x - outPos.x, fittedStarInTP.y - outPos.y);
-
-        // do not write grad = H*transW*res to avoid
-        // dynamic allocation of a temporary
         halpha = H * alpha;
-        HW = H * transW;
-        grad = HW * res;
-        // now feed in triplets and fullGrad
+        // now feed in triplets
         for (unsigned ipar = 0; ipar < npar_tot; ++ipar) {
             for (unsigned ic = 0; ic < 2; ++ic) {
                 double val = halpha(ipar, ic);
                 if (val == 0) continue;
                 tripletList.addTriplet(indices[ipar], kTriplets + ic, val);
             }
-            fullGrad(indices[ipar]) += grad(ipar);
         }
         kTriplets += 2;  // each measurement contributes 2 columns in the Jacobian
-    }                    // end loop on measurements
+        if (!fullGrad) continue;
+
+        // We can now compute the residual
+        Point fittedStarInTP =
+                transformFittedStar(*fs, *sky2TP, refractionVector, _refractionCoefficient, mjd);
+        Eigen::Vector2d res(fittedStarInTP.x - outPos.x, fittedStarInTP.y - outPos.y);
+
+        // do not write grad = H*transW*res to avoid
+        // dynamic allocation of a temporary
+        HW = H * transW;
+        grad = HW * res;
+        // and fullGrad
+        for (unsigned ipar = 0; ipar < npar_tot; ++ipar) (*fullGrad)(indices[ipar]) += grad(ipar);
+    }  // end loop on measurements
     tripletList.setNextFreeIndex(kTriplets);
 }
 
 void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fittedStarList,
                                                     TripletList &tripletList,
-                                                    Eigen::VectorXd &fullGrad) const {
+                                                    Eigen::VectorXd *fullGrad) const {
     /**********************************************************************/
     /* @note the math in this method and accumulateStatRefStars() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -311,6 +313,8 @@ void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
         alpha(1, 0) = W(0, 1) / alpha(0, 0);
         alpha(1, 1) = 1. / sqrt(det * W(0, 0));
         alpha(0, 1) = 0;
+        W *= fs.getRobustWeight();
+        alpha *= std::sqrt(fs.getRobustWeight());
         indices[0] = fs.getIndexInMatrix();
         indices[1] = fs.getIndexInMatrix() + 1;
         unsigned npar_tot = 2;
@@ -335,7 +339,7 @@ void AstrometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
                 if (val == 0) continue;
                 tripletList.addTriplet(indices[ipar], kTriplets + ic, val);
             }
-            fullGrad(indices[ipar]) += grad(ipar);
+            if (fullGrad) (*fullGrad)(indices[ipar]) += grad(ipar);
         }
         kTriplets += 2;  // each measurement contributes 2 columns in the Jacobian
     }
@@ -360,7 +364,9 @@ void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulato
     Eigen::Matrix2Xd transW(2, 2);
 
     auto &catalog = ccdImage.getCatalogForFit();
+    std::size_t position = 0;
     for (auto const &ms : catalog) {
+        std::size_t const index = position++;
         if (!ms->isValid()) continue;
         // tweak the measurement errors
         FatPoint inPos = *ms;
@@ -386,7 +392,7 @@ void AstrometryFit::accumulateStatImage(CcdImage const &ccdImage, Chi2Accumulato
         Eigen::Vector2d res(fittedStarInTP.x - outPos.x, fittedStarInTP.y - outPos.y);
         double chi2Val = res.transpose() * transW * res;
 
-        accum.addEntry(chi2Val, 2, ms);
+        accum.addEntry(chi2Val, 2, index);
     }  // end of loop on measurements
 }
 
@@ -406,7 +412,9 @@ void AstrometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
        AstrometryFit::leastSquareDerivativesReference(TripletList &TList, Eigen::VectorXd &Rhs) */
     FittedStarList &fittedStarList = _associations->fittedStarList;
     TanRaDecToPixel proj(AstrometryTransformLinear(), Point(0., 0.));
+    std::size_t position = 0;
     for (auto const &fs : fittedStarList) {
+        std::size_t const index = position++;
         const RefStar *rs = fs->getRefStar();
         if (rs == nullptr) continue;
         proj.setTangentPoint(*fs);
@@ -421,10 +429,59 @@ void AstrometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
         double wyy = rsProj.vx / det;
         double wxy = -rsProj.vxy / det;
         double chi2 = wxx * std::pow(rx, 2) + 2 * wxy * rx * ry + wyy * std::pow(ry, 2);
-        accum.addEntry(chi2, 2, fs);
+        accum.addEntry(chi2, 2, index);
+    }
+}
+
+bool AstrometryFit::isLinear() const {
+    // The refraction term is linear in its coefficient, the mappings may be.
+    return !_fittingPos && !_fittingPM && (!_fittingDistortions || _astrometryModel->isLinear());
+}
+
+std::vector<unsigned> AstrometryFit::getDenseBorderCandidates() const {
+    // The refraction coefficients are coupled to every measurement, the chip parameters of a constrained
+    // model to every visit.
+    std::vector<unsigned> candidates;
+    if (_fittingDistortions) candidates = _astrometryModel->getChipParameterIndices();
+    if (_fittingRefrac) {
+        for (unsigned k = 0; k < _nParRefrac; ++k) candidates.push_back(_refracPosInMatrix + k);
+    }
+    return candidates;
+}
+
+void AstrometryFit::countDerivativesMeasurement(CcdImage const &ccdImage, DerivativesCount &count) const {
+    // must match leastSquareDerivativesMeasurement()
+    unsigned nParModel = (_fittingDistortions) ? _astrometryModel->getMapping(ccdImage)->getNpar() : 0;
+    if (_fittingRefrac) nParModel += 1;
+    std::size_t nValid = 0;
+    for (auto const &ms : ccdImage.getCatalogForFit()) {
+        if (!ms->isValid()) continue;
+        unsigned nParStar = getNParFittedStar(*ms->getFittedStar());
+        if (nParModel + nParStar == 0) continue;
+        ++nValid;
+        count.nColumns += 2;
+        count.nNonZeros += 2 * (nParModel + nParStar);
+        count.nStarModelPairs += nParStar * nParModel;
+    }
+    if (nValid > 0) count.nModelModelPairs += nParModel * (nParModel + 1) / 2;
+}
+
+void AstrometryFit::countDerivativesReference(DerivativesCount &count) const {
+    // must match leastSquareDerivativesReference()
+    if (!_fittingPos || _associations->refStarList.size() == 0) return;
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        if (fittedStar->getRefStar() == nullptr) continue;
+        count.nColumns += 2;
+        count.nNonZeros += 4;
     }
 }
 
+unsigned AstrometryFit::getNParFittedStar(FittedStar const &fittedStar) const {
+    if (!_fittingPos) return 0;
+    // must match the layout in assignIndices()
+    return ((_fittingPM) && fittedStar.mightMove) ? 2 + NPAR_PM : 2;
+}
+
 //! this routine is to be used only in the framework of outlier removal
 /*! it fills the array of indices of parameters that a Measured star
     constrains. Not really all of them if you check. */
@@ -448,9 +505,19 @@ void AstrometryFit::getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
        able to remove more than 1 star at a time. */
 }
 
+void AstrometryFit::splitWhatToFit(std::string const &whatToFit, std::string &starWhatToFit,
+                                   std::string &modelWhatToFit) const {
+    _splitWords(whatToFit, {"Positions", "PM"}, starWhatToFit, modelWhatToFit);
+}
+
 void AstrometryFit::assignIndices(std::string const &whatToFit) {
     _whatToFit = whatToFit;
-    LOGLS_INFO(_log, "assignIndices: Now fitting " << whatToFit);
+    // minimizeAlternating() and computeProblemSize() switch back and forth between settings quietly.
+    if (_switchingIndices) {
+        LOGLS_DEBUG(_log, "assignIndices: Now fitting " << whatToFit);
+    } else {
+        LOGLS_INFO(_log, "assignIndices: Now fitting " << whatToFit);
+    }
     _fittingDistortions = (_whatToFit.find("Distortions") != std::string::npos);
     _fittingPos = (_whatToFit.find("Positions") != std::string::npos);
     _fittingRefrac = (_whatToFit.find("Refrac") != std::string::npos);
@@ -514,6 +581,51 @@ void AstrometryFit::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+Eigen::VectorXd AstrometryFit::getParameters() const {
+    Eigen::VectorXd parameters(_nParTot);
+    if (_fittingDistortions) _astrometryModel->getParameters(parameters);
+
+    if (_fittingPos) {
+        for (auto const &fittedStar : _associations->fittedStarList) {
+            // same layout as offsetParams()
+            unsigned index = fittedStar->getIndexInMatrix();
+            parameters(index) = fittedStar->x;
+            parameters(index + 1) = fittedStar->y;
+            if ((_fittingPM)&fittedStar->mightMove) {
+                parameters(index + 2) = fittedStar->pmx;
+                parameters(index + 3) = fittedStar->pmy;
+            }
+        }
+    }
+    if (_fittingRefrac) {
+        parameters(_refracPosInMatrix) = _refractionCoefficient;
+    }
+    return parameters;
+}
+
+void AstrometryFit::setParameters(Eigen::VectorXd const &parameters) {
+    if (parameters.size() != _nParTot)
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "AstrometryFit::setParameters : the provided vector length is not compatible with "
+                          "the current whatToFit setting");
+    if (_fittingDistortions) _astrometryModel->setParameters(parameters);
+
+    if (_fittingPos) {
+        for (auto &fittedStar : _associations->fittedStarList) {
+            unsigned index = fittedStar->getIndexInMatrix();
+            fittedStar->x = parameters(index);
+            fittedStar->y = parameters(index + 1);
+            if ((_fittingPM)&fittedStar->mightMove) {
+                fittedStar->pmx = parameters(index + 2);
+                fittedStar->pmy = parameters(index + 3);
+            }
+        }
+    }
+    if (_fittingRefrac) {
+        _refractionCoefficient = parameters(_refracPosInMatrix);
+    }
+}
+
 void AstrometryFit::checkStuff() {
 #if (0)
     const char *what2fit[] = {"Positions",
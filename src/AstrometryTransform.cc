@@ -217,6 +217,11 @@ void AstrometryTransform::getParams(double *params) const {
     for (int i = 0; i < npar; ++i) params[i] = paramRef(i);
 }
 
+void AstrometryTransform::setParams(double const *params) {
+    int npar = getNpar();
+    for (int i = 0; i < npar; ++i) paramRef(i) = params[i];
+}
+
 void AstrometryTransform::offsetParams(Eigen::VectorXd const &delta) {
     int npar = getNpar();
     for (int i = 0; i < npar; ++i) paramRef(i) += delta[i];
@@ -0,0 +1,152 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "Eigen/Cholesky"
+
+#include "lsst/jointcal/BlockJacobiPreconditioner.h"
+
+namespace lsst {
+namespace jointcal {
+
+void BlockJacobiPreconditioner::setBlocks(unsigned nParTot,
+                                          std::vector<std::vector<unsigned>> const &blocks) {
+    _nParTot = nParTot;
+    _blocks.clear();
+    _indices.clear();
+    _blockOf.assign(nParTot, -1);
+    _position.assign(nParTot, 0);
+    std::size_t valueStart = 0;
+    for (auto const &indices : blocks) {
+        Block block;
+        block.size = indices.size();
+        block.indexStart = _indices.size();
+        block.valueStart = valueStart;
+        block.factorized = false;
+        for (unsigned k = 0; k < indices.size(); ++k) {
+            _blockOf[indices[k]] = _blocks.size();
+            _position[indices[k]] = k;
+            _indices.push_back(indices[k]);
+        }
+        valueStart += std::size_t(block.size) * block.size;
+        _blocks.push_back(block);
+    }
+    _factors.assign(valueStart, 0);
+    _slots.clear();
+}
+
+unsigned BlockJacobiPreconditioner::getMaxBlockSize() const {
+    unsigned maxSize = 0;
+    for (auto const &block : _blocks) maxSize = std::max(maxSize, block.size);
+    return maxSize;
+}
+
+void BlockJacobiPreconditioner::start(std::size_t nSlots) {
+    _slots.resize(nSlots);
+    for (auto &slot : _slots) slot.values.assign(_factors.size(), 0);
+}
+
+void BlockJacobiPreconditioner::add(TripletList const &tripletList, std::size_t slotIndex) {
+    Slot &slot = _slots[slotIndex];
+    std::size_t nColumns = tripletList.getNextFreeIndex();
+
+    // counting sort of the entries by Jacobian column, as in HessianAssembler::add.
+    slot.columnStart.assign(nColumns + 1, 0);
+    for (auto const &trip : tripletList) slot.columnStart[trip.col() + 1]++;
+    for (std::size_t k = 0; k < nColumns; ++k) slot.columnStart[k + 1] += slot.columnStart[k];
+    slot.entries.resize(tripletList.size());
+    for (auto const &trip : tripletList) {
+        unsigned row = trip.row();
+        slot.entries[slot.columnStart[trip.col()]++] = Entry{_blockOf[row], _position[row], trip.value()};
+    }
+    for (std::size_t k = nColumns; k > 0; --k) slot.columnStart[k] = slot.columnStart[k - 1];
+    slot.columnStart[0] = 0;
+
+    for (std::size_t k = 0; k < nColumns; ++k) {
+        auto begin = slot.entries.begin() + slot.columnStart[k];
+        auto end = slot.entries.begin() + slot.columnStart[k + 1];
+        std::sort(begin, end);
+        // only the pairs of entries in the same block contribute to the block diagonal.
+        for (auto runBegin = begin; runBegin != end;) {
+            auto runEnd = runBegin;
+            while (runEnd != end && runEnd->block == runBegin->block) ++runEnd;
+            Block const &block = _blocks[runBegin->block];
+            double *values = slot.values.data() + block.valueStart;
+            for (auto a = runBegin; a != runEnd; ++a) {
+                for (auto b = runBegin; b != runEnd; ++b) {
+                    values[std::size_t(b->position) * block.size + a->position] += a->value * b->value;
+                }
+            }
+            runBegin = runEnd;
+        }
+    }
+}
+
+std::size_t BlockJacobiPreconditioner::finish() {
+    std::fill(_factors.begin(), _factors.end(), 0);
+    for (auto const &slot : _slots) {
+        for (std::size_t i = 0; i < _factors.size(); ++i) _factors[i] += slot.values[i];
+    }
+    _slots.clear();
+
+    std::size_t nFallbacks = 0;
+    for (auto &block : _blocks) {
+        Eigen::Map<Eigen::MatrixXd> values(_factors.data() + block.valueStart, block.size, block.size);
+        Eigen::LLT<Eigen::MatrixXd> llt(values);
+        block.factorized = (llt.info() == Eigen::Success);
+        if (block.factorized) {
+            values = llt.matrixL();
+            continue;
+        }
+        ++nFallbacks;
+        Eigen::VectorXd diagonal = values.diagonal();
+        values.setZero();
+        for (unsigned k = 0; k < block.size; ++k) {
+            if (diagonal[k] > 0) values(k, k) = 1. / diagonal[k];
+        }
+    }
+    return nFallbacks;
+}
+
+Eigen::VectorXd BlockJacobiPreconditioner::apply(Eigen::VectorXd const &residual) const {
+    Eigen::VectorXd result = Eigen::VectorXd::Zero(_nParTot);
+    Eigen::VectorXd local;
+    for (auto const &block : _blocks) {
+        local.resize(block.size);
+        for (unsigned k = 0; k < block.size; ++k) local[k] = residual[_indices[block.indexStart + k]];
+        Eigen::Map<Eigen::MatrixXd const> factor(_factors.data() + block.valueStart, block.size, block.size);
+        if (block.factorized) {
+            factor.triangularView<Eigen::Lower>().solveInPlace(local);
+            factor.transpose().triangularView<Eigen::Upper>().solveInPlace(local);
+        } else {
+            local = factor.diagonal().cwiseProduct(local);
+        }
+        for (unsigned k = 0; k < block.size; ++k) result[_indices[block.indexStart + k]] = local[k];
+    }
+    return result;
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -0,0 +1,179 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+
+#include "lsst/jointcal/BorderedSystem.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+// Number of border columns solved for at once when forming S.
+Eigen::Index const solveChunk = 16;
+}  // namespace
+
+bool BorderedSystem::split(SparseMatrixD const &hessian, std::vector<unsigned> const &candidates,
+                           SparseMatrixD &interior) {
+    Eigen::Index const n = hessian.cols();
+    _dim = n;
+    _border.clear();
+    _interiorIndex.clear();
+    if (_maxBorder == 0 || n < 2 || candidates.empty()) return false;
+
+    // number of off-diagonal couplings of each parameter, from the lower triangle.
+    std::vector<Eigen::Index> degree(n, 0);
+    for (Eigen::Index j = 0; j < n; ++j) {
+        for (SparseMatrixD::InnerIterator it(hessian, j); it; ++it) {
+            if (it.row() == j) continue;
+            ++degree[it.row()];
+            ++degree[j];
+        }
+    }
+    double const denseDegree = std::max(16., 10 * std::sqrt(static_cast<double>(n)));
+    for (unsigned j : candidates) {
+        if (degree[j] > denseDegree) _border.push_back(j);
+    }
+    if (_border.empty()) return false;
+    std::sort(_border.begin(), _border.end());
+    _border.erase(std::unique(_border.begin(), _border.end()), _border.end());
+    std::size_t const nBorder = std::min<std::size_t>(_maxBorder, n - 1);
+    if (_border.size() > nBorder) {
+        std::stable_sort(_border.begin(), _border.end(),
+                         [&degree](unsigned a, unsigned b) { return degree[a] > degree[b]; });
+        _border.resize(nBorder);
+        std::sort(_border.begin(), _border.end());
+    }
+
+    _interiorIndex.assign(n, 0);
+    for (unsigned b : _border) _interiorIndex[b] = -1;
+    int nInterior = 0;
+    for (Eigen::Index j = 0; j < n; ++j) {
+        if (_interiorIndex[j] == 0) _interiorIndex[j] = nInterior++;
+    }
+    _extract(hessian, &interior);
+    return true;
+}
+
+SparseMatrixD BorderedSystem::getInteriorRows(SparseMatrixD const &matrix) const {
+    if (_interiorIndex.empty()) return matrix;
+    std::vector<Eigen::Triplet<double>> triplets;
+    triplets.reserve(matrix.nonZeros());
+    for (Eigen::Index j = 0; j < matrix.outerSize(); ++j) {
+        for (SparseMatrixD::InnerIterator it(matrix, j); it; ++it) {
+            int const row = _interiorIndex[it.row()];
+            if (row >= 0) triplets.emplace_back(row, j, it.value());
+        }
+    }
+    SparseMatrixD interiorRows(_coupling.rows(), matrix.cols());
+    interiorRows.setFromTriplets(triplets.begin(), triplets.end());
+    return interiorRows;
+}
+
+void BorderedSystem::updateCouplings(SparseMatrixD const &hessian) {
+    assert(hessian.cols() == _dim);
+    if (!_border.empty()) _extract(hessian, nullptr);
+}
+
+void BorderedSystem::_extract(SparseMatrixD const &hessian, SparseMatrixD *interior) {
+    std::vector<int> borderIndex(_dim, -1);
+    for (std::size_t b = 0; b < _border.size(); ++b) borderIndex[_border[b]] = b;
+    Eigen::Index const nInterior = _dim - _border.size();
+
+    // The interior indices preserve the order of the parameters, so the interior columns and their rows
+    // come out sorted and can be appended directly.
+    if (interior) {
+        interior->resize(nInterior, nInterior);
+        interior->reserve(hessian.nonZeros());
+    }
+    std::vector<Eigen::Triplet<double>> couplings;
+    _borderBlock.setZero(_border.size(), _border.size());
+    for (Eigen::Index j = 0; j < _dim; ++j) {
+        int const column = _interiorIndex[j];
+        if (column >= 0) {
+            if (interior) interior->startVec(column);
+            for (SparseMatrixD::InnerIterator it(hessian, j); it; ++it) {
+                int const row = _interiorIndex[it.row()];
+                if (row < 0) {
+                    couplings.emplace_back(column, borderIndex[it.row()], it.value());
+                } else if (interior) {
+                    interior->insertBack(row, column) = it.value();
+                }
+            }
+        } else {
+            int const borderColumn = borderIndex[j];
+            for (SparseMatrixD::InnerIterator it(hessian, j); it; ++it) {
+                int const row = _interiorIndex[it.row()];
+                if (row >= 0) {
+                    couplings.emplace_back(row, borderColumn, it.value());
+                } else {
+                    _borderBlock(borderIndex[it.row()], borderColumn) = it.value();
+                    _borderBlock(borderColumn, borderIndex[it.row()]) = it.value();
+                }
+            }
+        }
+    }
+    if (interior) interior->finalize();
+    _coupling.resize(nInterior, _border.size());
+    _coupling.setFromTriplets(couplings.begin(), couplings.end());
+}
+
+bool BorderedSystem::reduce(CholmodSimplicialLDLT2<SparseMatrixD> const &interiorFactor) {
+    Eigen::Index const nBorder = _border.size();
+    Eigen::MatrixXd reduced = _borderBlock;
+    for (Eigen::Index first = 0; first < nBorder; first += solveChunk) {
+        Eigen::Index const size = std::min(solveChunk, nBorder - first);
+        Eigen::MatrixXd columns(_coupling.middleCols(first, size));
+        Eigen::MatrixXd solved = interiorFactor.solve(columns);
+        reduced.middleCols(first, size) -= _coupling.transpose() * solved;
+    }
+    if (!reduced.allFinite()) return false;
+    _borderFactor.compute(reduced);
+    return _borderFactor.info() == Eigen::Success && _borderFactor.isPositive();
+}
+
+Eigen::VectorXd BorderedSystem::solve(CholmodSimplicialLDLT2<SparseMatrixD> const &interiorFactor,
+                                      Eigen::VectorXd const &grad) const {
+    Eigen::VectorXd interiorGrad(_coupling.rows());
+    Eigen::VectorXd borderGrad(_border.size());
+    for (Eigen::Index i = 0; i < _dim; ++i) {
+        if (_interiorIndex[i] >= 0) interiorGrad(_interiorIndex[i]) = grad(i);
+    }
+    for (std::size_t b = 0; b < _border.size(); ++b) borderGrad(b) = grad(_border[b]);
+
+    Eigen::VectorXd interiorDelta = interiorFactor.solve(interiorGrad);
+    Eigen::VectorXd borderDelta = _borderFactor.solve(borderGrad - _coupling.transpose() * interiorDelta);
+    interiorDelta = interiorFactor.solve(interiorGrad - _coupling * borderDelta);
+
+    Eigen::VectorXd delta(_dim);
+    for (Eigen::Index i = 0; i < _dim; ++i) {
+        if (_interiorIndex[i] >= 0) delta(i) = interiorDelta(_interiorIndex[i]);
+    }
+    for (std::size_t b = 0; b < _border.size(); ++b) delta(_border[b]) = borderDelta(b);
+    return delta;
+}
+}  // namespace jointcal
+}  // namespace lsst
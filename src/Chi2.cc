@@ -22,6 +22,7 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <cmath>
 #include <utility>
 #include <iostream>
 
@@ -30,22 +31,22 @@
 namespace lsst {
 namespace jointcal {
 
-std::pair<double, double> Chi2List::computeAverageAndSigma() {
-    double sum = 0;
-    double sum2 = 0;
-    for (auto i : *this) {
-        sum += i.chi2;
-        sum2 += std::pow(i.chi2, 2);
-    }
-    double average = sum / size();
-    double sigma = sqrt(sum2 / size() - std::pow(average, 2));
+void Chi2List::append(Chi2List const& other) {
+    insert(end(), other.begin(), other.end());
+    _sum += other._sum;
+    _sum2 += other._sum2;
+}
+
+std::pair<double, double> Chi2List::computeAverageAndSigma() const {
+    double average = _sum / size();
+    double sigma = sqrt(_sum2 / size() - std::pow(average, 2));
     return std::make_pair(average, sigma);
 }
 
 std::ostream& operator<<(std::ostream& s, Chi2List const& chi2List) {
     s << "chi2 per star : ";
-    for (auto chi2 : chi2List) {
-        s << *(chi2.star) << " chi2: " << chi2.chi2 << " ; ";
+    for (auto const& record : chi2List) {
+        s << "index: " << record.index << " chi2: " << record.chi2 << " ; ";
     }
     s << std::endl;
     return s;
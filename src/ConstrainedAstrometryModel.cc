@@ -32,6 +32,7 @@
 #include "lsst/jointcal/AstrometryTransform.h"
 #include "lsst/jointcal/ProjectionHandler.h"
 #include "lsst/jointcal/StarMatch.h"
+#include "lsst/jointcal/Trace.h"
 
 #include "lsst/pex/exceptions.h"
 namespace pexExcept = lsst::pex::exceptions;
@@ -182,6 +183,32 @@ void ConstrainedAstrometryModel::offsetParams(Eigen::VectorXd const &delta) {
         }
 }
 
+void ConstrainedAstrometryModel::getParameters(Eigen::VectorXd &parameters) const {
+    if (_fittingChips)
+        for (auto const &i : _chipMap) {
+            auto mapping = i.second.get();
+            parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+        }
+    if (_fittingVisits)
+        for (auto const &i : _visitMap) {
+            auto mapping = i.second.get();
+            parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+        }
+}
+
+void ConstrainedAstrometryModel::setParameters(Eigen::VectorXd const &parameters) {
+    if (_fittingChips)
+        for (auto &i : _chipMap) {
+            auto mapping = i.second.get();
+            mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+        }
+    if (_fittingVisits)
+        for (auto &i : _visitMap) {
+            auto mapping = i.second.get();
+            mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+        }
+}
+
 void ConstrainedAstrometryModel::freezeErrorTransform() {
     for (auto i = _visitMap.begin(); i != _visitMap.end(); ++i) i->second->freezeErrorTransform();
     for (auto i = _chipMap.begin(); i != _chipMap.end(); ++i) i->second->freezeErrorTransform();
@@ -207,6 +234,39 @@ std::vector<VisitIdType> ConstrainedAstrometryModel::getVisits() const {
     return res;
 }
 
+std::map<CcdIdType, Eigen::VectorXd> ConstrainedAstrometryModel::getChipParameters() const {
+    std::map<CcdIdType, Eigen::VectorXd> chipParameters;
+    for (auto const &i : _chipMap) chipParameters.emplace(i.first, i.second->getTransformParameters());
+    return chipParameters;
+}
+
+std::size_t ConstrainedAstrometryModel::setChipParameters(
+        std::map<CcdIdType, Eigen::VectorXd> const &chipParameters) {
+    std::stringstream missing;
+    for (auto const &i : _chipMap) {
+        if (chipParameters.count(i.first) == 0) missing << " " << i.first;
+    }
+    if (!missing.str().empty()) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "No saved parameters for chips" + missing.str() + ": they cannot be held fixed.");
+    }
+    std::size_t count = 0;
+    for (auto &i : _chipMap) {
+        auto parameters = chipParameters.find(i.first);
+        if (parameters->second.size() != i.second->getTransformParameters().size()) {
+            throw LSST_EXCEPT(pex::exceptions::LengthError,
+                              "Chip " + std::to_string(i.first) + " has " +
+                                      std::to_string(i.second->getTransformParameters().size()) +
+                                      " transform parameters, not " +
+                                      std::to_string(parameters->second.size()));
+        }
+        i.second->setTransformParameters(parameters->second);
+        ++count;
+    }
+    LOGLS_INFO(_log, "Set " << count << " of " << _chipMap.size() << " chip mappings.");
+    return count;
+}
+
 const AstrometryTransform &ConstrainedAstrometryModel::getVisitTransform(VisitIdType const &visit) const {
     auto visitp = _visitMap.find(visit);
     if (visitp == _visitMap.end()) {
@@ -230,7 +290,17 @@ int ConstrainedAstrometryModel::getTotalParameters() const {
     return total;
 }
 
+std::vector<unsigned> ConstrainedAstrometryModel::getChipParameterIndices() const {
+    std::vector<unsigned> indices;
+    if (!_fittingChips) return indices;
+    for (auto const &i : _chipMap) {
+        for (unsigned k = 0; k < i.second->getNpar(); ++k) indices.push_back(i.second->getIndex() + k);
+    }
+    return indices;
+}
+
 std::shared_ptr<afw::geom::SkyWcs> ConstrainedAstrometryModel::makeSkyWcs(CcdImage const &ccdImage) const {
+    JOINTCAL_TRACE_SPAN_DETAIL("makeSkyWcs", ccdImage.getName());
     auto proj = std::dynamic_pointer_cast<const TanRaDecToPixel>(getSkyToTangentPlane(ccdImage));
     jointcal::Point tangentPoint(proj->getTangentPoint());
 
@@ -25,6 +25,7 @@
 #include <map>
 #include <limits>
 #include <vector>
+#include <sstream>
 #include <string>
 
 #include "lsst/log/Log.h"
@@ -95,6 +96,39 @@ void ConstrainedPhotometryModel::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+void ConstrainedPhotometryModel::getParameters(Eigen::VectorXd &parameters) const {
+    if (_fittingChips) {
+        for (auto const &idMapping : _chipMap) {
+            auto mapping = idMapping.second.get();
+            if (mapping->isFixed()) continue;
+            parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+        }
+    }
+    if (_fittingVisits) {
+        for (auto const &idMapping : _visitMap) {
+            auto mapping = idMapping.second.get();
+            parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+        }
+    }
+}
+
+void ConstrainedPhotometryModel::setParameters(Eigen::VectorXd const &parameters) {
+    if (_fittingChips) {
+        for (auto &idMapping : _chipMap) {
+            auto mapping = idMapping.second.get();
+            // Fixed mappings have no parameters in the fit.
+            if (mapping->isFixed()) continue;
+            mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+        }
+    }
+    if (_fittingVisits) {
+        for (auto &idMapping : _visitMap) {
+            auto mapping = idMapping.second.get();
+            mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+        }
+    }
+}
+
 void ConstrainedPhotometryModel::freezeErrorTransform() {
     for (auto &idMapping : _chipMap) {
         idMapping.second.get()->freezeErrorTransform();
@@ -121,6 +155,41 @@ int ConstrainedPhotometryModel::getTotalParameters() const {
     return total;
 }
 
+std::map<CcdIdType, Eigen::VectorXd> ConstrainedPhotometryModel::getChipParameters() const {
+    std::map<CcdIdType, Eigen::VectorXd> chipParameters;
+    for (auto const &idMapping : _chipMap) {
+        chipParameters.emplace(idMapping.first, idMapping.second->getParameters());
+    }
+    return chipParameters;
+}
+
+std::size_t ConstrainedPhotometryModel::setChipParameters(
+        std::map<CcdIdType, Eigen::VectorXd> const &chipParameters) {
+    std::stringstream missing;
+    for (auto const &idMapping : _chipMap) {
+        if (chipParameters.count(idMapping.first) == 0) missing << " " << idMapping.first;
+    }
+    if (!missing.str().empty()) {
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "No saved parameters for chips" + missing.str() + ": they cannot be held fixed.");
+    }
+    std::size_t count = 0;
+    for (auto &idMapping : _chipMap) {
+        auto parameters = chipParameters.find(idMapping.first);
+        auto const nParameters = idMapping.second->getParameters().size();
+        if (parameters->second.size() != nParameters) {
+            throw LSST_EXCEPT(pex::exceptions::LengthError,
+                              "Chip " + std::to_string(idMapping.first) + " has " +
+                                      std::to_string(nParameters) + " transform parameters, not " +
+                                      std::to_string(parameters->second.size()));
+        }
+        idMapping.second->setParameters(parameters->second);
+        ++count;
+    }
+    LOGLS_INFO(_log, "Set " << count << " of " << _chipMap.size() << " chip mappings.");
+    return count;
+}
+
 void ConstrainedPhotometryModel::computeParameterDerivatives(MeasuredStar const &measuredStar,
                                                              CcdImage const &ccdImage,
                                                              Eigen::VectorXd &derivatives) const {
@@ -0,0 +1,542 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <set>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
+#include "lsst/afw/geom/Point.h"
+
+#include "lsst/jointcal/FitCheckpoint.h"
+#include "lsst/jointcal/CcdImage.h"
+#include "lsst/jointcal/FittedStar.h"
+#include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/RefStar.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+LOG_LOGGER _log = LOG_GET("jointcal.FitCheckpoint");
+
+char const checkpointMagic[8] = {'J', 'C', 'A', 'L', 'C', 'K', 'P', 'T'};
+// Reads back as another value on a machine of the other endianness.
+std::uint32_t const byteOrderMark = 0x01020304;
+
+/*
+ * The file layout: a Header, then the CcdImageRecords, the MeasuredStarRecords of all CcdImages (in the
+ * order of the CcdImageRecords), the FittedStarRecords, the RefStarRecords, the parameters (doubles), the
+ * ChipRecords, the chip parameters (doubles, in the order of the ChipRecords) and the characters of
+ * whatToFit. All the records are multiples of 8 bytes, so every section is aligned.
+ */
+struct Header {
+    char magic[8];
+    std::uint32_t version;
+    std::uint32_t byteOrder;
+    std::uint64_t nCcdImages;
+    std::uint64_t nMeasuredStars;
+    std::uint64_t nFittedStars;
+    std::uint64_t nRefStars;
+    std::uint64_t nParameters;
+    std::uint64_t nChips;
+    std::uint64_t nChipParameters;
+    std::uint64_t whatToFitSize;
+    double commonTangentPoint[2];
+    std::uint64_t inTangentPlaneCoordinates;
+};
+
+/// The fields of a BaseStar, including its FatPoint position and errors.
+struct StarRecord {
+    double x, y, vx, vy, vxy;
+    double flux, fluxErr, mag, magErr;
+};
+
+struct CcdImageRecord {
+    std::int32_t visit;
+    std::int32_t ccd;
+    std::uint64_t nMeasuredStars;
+};
+
+struct MeasuredStarRecord {
+    StarRecord star;
+    double instFlux, instFluxErr, xFocal, yFocal, robustWeight;
+    std::int64_t id;
+    std::int64_t fittedStar;  // index in the FittedStarRecords, -1 if none
+    std::uint64_t valid;
+};
+
+struct FittedStarRecord {
+    StarRecord star;
+    double pmx, pmy, epmx, epmy, epmxy, color, robustWeight;
+    std::int64_t refStar;  // index in the RefStarRecords, -1 if none
+    std::int32_t measurementCount;
+    std::uint32_t mightMove;
+};
+
+using RefStarRecord = StarRecord;
+
+struct ChipRecord {
+    std::int32_t ccd;
+    std::uint32_t nParameters;
+};
+
+static_assert(sizeof(Header) % 8 == 0, "checkpoint sections must stay 8-byte aligned");
+static_assert(sizeof(CcdImageRecord) % 8 == 0, "checkpoint sections must stay 8-byte aligned");
+static_assert(sizeof(MeasuredStarRecord) % 8 == 0, "checkpoint sections must stay 8-byte aligned");
+static_assert(sizeof(FittedStarRecord) % 8 == 0, "checkpoint sections must stay 8-byte aligned");
+static_assert(sizeof(ChipRecord) % 8 == 0, "checkpoint sections must stay 8-byte aligned");
+
+StarRecord makeStarRecord(BaseStar const &star) {
+    return {star.x,         star.y,           star.vx,        star.vy,          star.vxy,
+            star.getFlux(), star.getFluxErr(), star.getMag(), star.getMagErr()};
+}
+
+void restoreStar(StarRecord const &record, BaseStar &star) {
+    star.x = record.x;
+    star.y = record.y;
+    star.vx = record.vx;
+    star.vy = record.vy;
+    star.vxy = record.vxy;
+    star.setFlux(record.flux);
+    star.setFluxErr(record.fluxErr);
+    star.getMag() = record.mag;
+    star.setMagErr(record.magErr);
+}
+
+template <class T>
+void writeArray(std::ofstream &out, T const *data, std::size_t size) {
+    out.write(reinterpret_cast<char const *>(data), sizeof(T) * size);
+}
+
+template <class T>
+T const *readArray(char const *data, std::size_t offset) {
+    return reinterpret_cast<T const *>(data + offset);
+}
+
+Header const &getHeader(char const *data) { return *readArray<Header>(data, 0); }
+
+/*
+ * Return the end of a section of count records that starts at offset, which is in the file.
+ * Checked before computing it, so that a corrupt count cannot overflow the offsets.
+ */
+std::size_t getSectionEnd(std::string const &path, char const *section, std::size_t offset,
+                          std::uint64_t count, std::size_t recordSize, std::size_t fileSize) {
+    if (count > (fileSize - offset) / recordSize) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          path + ": the " + std::to_string(count) + " " + section +
+                                  " of the fit checkpoint header do not fit in the file.");
+    }
+    return offset + count * recordSize;
+}
+}  // namespace
+
+void FitCheckpoint::write(std::string const &path, Associations const &associations, FitterBase const &fitter,
+                          std::map<CcdIdType, Eigen::VectorXd> const &chipParameters) {
+    std::unordered_map<RefStar const *, std::int64_t> refStarIndices;
+    std::vector<RefStarRecord> refStarRecords;
+    refStarRecords.reserve(associations.refStarList.size());
+    for (auto const &refStar : associations.refStarList) {
+        refStarIndices.emplace(refStar.get(), refStarRecords.size());
+        refStarRecords.push_back(makeStarRecord(*refStar));
+    }
+
+    std::unordered_map<FittedStar const *, std::int64_t> fittedStarIndices;
+    std::vector<FittedStarRecord> fittedStarRecords;
+    fittedStarRecords.reserve(associations.fittedStarList.size());
+    for (auto const &fittedStar : associations.fittedStarList) {
+        fittedStarIndices.emplace(fittedStar.get(), fittedStarRecords.size());
+        auto refStar = refStarIndices.find(fittedStar->getRefStar());
+        fittedStarRecords.push_back({makeStarRecord(*fittedStar), fittedStar->pmx, fittedStar->pmy,
+                                     fittedStar->epmx, fittedStar->epmy, fittedStar->epmxy,
+                                     fittedStar->color, fittedStar->getRobustWeight(),
+                                     refStar == refStarIndices.end() ? -1 : refStar->second,
+                                     fittedStar->getMeasurementCount(), fittedStar->mightMove});
+    }
+
+    std::vector<CcdImageRecord> ccdImageRecords;
+    std::vector<MeasuredStarRecord> measuredStarRecords;
+    for (auto const &ccdImage : associations.getCcdImageList()) {
+        auto const &catalog = ccdImage->getCatalogForFit();
+        ccdImageRecords.push_back({ccdImage->getVisit(), ccdImage->getCcdId(), catalog.size()});
+        for (auto const &measuredStar : catalog) {
+            auto fittedStar = fittedStarIndices.find(measuredStar->getFittedStar().get());
+            measuredStarRecords.push_back({makeStarRecord(*measuredStar), measuredStar->getInstFlux(),
+                                           measuredStar->getInstFluxErr(), measuredStar->getXFocal(),
+                                           measuredStar->getYFocal(), measuredStar->getRobustWeight(),
+                                           measuredStar->getId(),
+                                           fittedStar == fittedStarIndices.end() ? -1 : fittedStar->second,
+                                           measuredStar->isValid()});
+        }
+    }
+
+    Eigen::VectorXd const parameters = fitter.getParameters();
+    std::string const &whatToFit = fitter.getWhatToFit();
+
+    std::vector<ChipRecord> chipRecords;
+    std::vector<double> chipParameterValues;
+    for (auto const &idParameters : chipParameters) {
+        chipRecords.push_back(
+                {idParameters.first, static_cast<std::uint32_t>(idParameters.second.size())});
+        chipParameterValues.insert(chipParameterValues.end(), idParameters.second.data(),
+                                   idParameters.second.data() + idParameters.second.size());
+    }
+
+    Header header;
+    std::memcpy(header.magic, checkpointMagic, sizeof(header.magic));
+    header.version = version;
+    header.byteOrder = byteOrderMark;
+    header.nCcdImages = ccdImageRecords.size();
+    header.nMeasuredStars = measuredStarRecords.size();
+    header.nFittedStars = fittedStarRecords.size();
+    header.nRefStars = refStarRecords.size();
+    header.nParameters = parameters.size();
+    header.nChips = chipRecords.size();
+    header.nChipParameters = chipParameterValues.size();
+    header.whatToFitSize = whatToFit.size();
+    header.commonTangentPoint[0] = associations.getCommonTangentPoint().x;
+    header.commonTangentPoint[1] = associations.getCommonTangentPoint().y;
+    header.inTangentPlaneCoordinates = associations.fittedStarList.inTangentPlaneCoordinates;
+
+    // Written aside and renamed, so that a checkpoint is either complete or absent.
+    std::string const tmpPath = path + ".tmp";
+    std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+    if (!out) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Could not open " + tmpPath + " for writing.");
+    }
+    writeArray(out, &header, 1);
+    writeArray(out, ccdImageRecords.data(), ccdImageRecords.size());
+    writeArray(out, measuredStarRecords.data(), measuredStarRecords.size());
+    writeArray(out, fittedStarRecords.data(), fittedStarRecords.size());
+    writeArray(out, refStarRecords.data(), refStarRecords.size());
+    writeArray(out, parameters.data(), parameters.size());
+    writeArray(out, chipRecords.data(), chipRecords.size());
+    writeArray(out, chipParameterValues.data(), chipParameterValues.size());
+    writeArray(out, whatToFit.data(), whatToFit.size());
+    out.close();
+    if (!out) {
+        std::remove(tmpPath.c_str());
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Could not write the fit checkpoint " + tmpPath);
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          "Could not rename " + tmpPath + " to " + path + ": " + std::strerror(errno));
+    }
+    LOGLS_INFO(_log, "Wrote fit checkpoint " << path << " of " << header.nCcdImages << " ccdImages, "
+                                             << header.nMeasuredStars << " measuredStars, "
+                                             << header.nFittedStars << " fittedStars, " << header.nRefStars
+                                             << " refStars, " << header.nParameters << " parameters and "
+                                             << header.nChips << " chips.");
+}
+
+FitCheckpoint::FitCheckpoint(std::string const &path) : _path(path), _data(nullptr), _size(0) {
+    int const file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          "Could not open the fit checkpoint " + path + ": " + std::strerror(errno));
+    }
+    struct stat status;
+    if (::fstat(file, &status) != 0) {
+        ::close(file);
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          "Could not stat the fit checkpoint " + path + ": " + std::strerror(errno));
+    }
+    _size = status.st_size;
+    if (_size < sizeof(Header)) {
+        ::close(file);
+        throw LSST_EXCEPT(pex::exceptions::IoError, path + " is too short to be a fit checkpoint.");
+    }
+    void *data = ::mmap(nullptr, _size, PROT_READ, MAP_PRIVATE, file, 0);
+    ::close(file);  // the mapping keeps its own reference to the file
+    if (data == MAP_FAILED) {
+        throw LSST_EXCEPT(pex::exceptions::IoError,
+                          "Could not map the fit checkpoint " + path + ": " + std::strerror(errno));
+    }
+    _data = static_cast<char const *>(data);
+
+    auto fail = [this](std::string const &message) {
+        ::munmap(const_cast<char *>(_data), _size);
+        throw LSST_EXCEPT(pex::exceptions::IoError, _path + ": " + message);
+    };
+    Header const &header = getHeader(_data);
+    if (std::memcmp(header.magic, checkpointMagic, sizeof(header.magic)) != 0) {
+        fail("not a fit checkpoint.");
+    }
+    if (header.byteOrder != byteOrderMark) fail("fit checkpoint written with another byte order.");
+    if (header.version != version) {
+        fail("fit checkpoint version " + std::to_string(header.version) + ", expected " +
+             std::to_string(version) + ".");
+    }
+    try {
+        computeOffsets();
+        checkRecords();
+    } catch (...) {
+        ::munmap(const_cast<char *>(_data), _size);
+        throw;
+    }
+}
+
+FitCheckpoint::~FitCheckpoint() { ::munmap(const_cast<char *>(_data), _size); }
+
+void FitCheckpoint::computeOffsets() {
+    Header const &header = getHeader(_data);
+    _ccdImageOffset = sizeof(Header);
+    _measuredStarOffset = getSectionEnd(_path, "ccdImages", _ccdImageOffset, header.nCcdImages,
+                                        sizeof(CcdImageRecord), _size);
+    _fittedStarOffset = getSectionEnd(_path, "measuredStars", _measuredStarOffset, header.nMeasuredStars,
+                                      sizeof(MeasuredStarRecord), _size);
+    _refStarOffset = getSectionEnd(_path, "fittedStars", _fittedStarOffset, header.nFittedStars,
+                                   sizeof(FittedStarRecord), _size);
+    _parameterOffset =
+            getSectionEnd(_path, "refStars", _refStarOffset, header.nRefStars, sizeof(RefStarRecord), _size);
+    _chipOffset = getSectionEnd(_path, "parameters", _parameterOffset, header.nParameters, sizeof(double),
+                                _size);
+    _chipParameterOffset =
+            getSectionEnd(_path, "chips", _chipOffset, header.nChips, sizeof(ChipRecord), _size);
+    _whatToFitOffset = getSectionEnd(_path, "chip parameters", _chipParameterOffset, header.nChipParameters,
+                                     sizeof(double), _size);
+    std::size_t const end =
+            getSectionEnd(_path, "whatToFit characters", _whatToFitOffset, header.whatToFitSize, 1, _size);
+    if (end != _size) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          _path + ": fit checkpoint size " + std::to_string(_size) +
+                                  " does not match its header (" + std::to_string(end) + ").");
+    }
+}
+
+void FitCheckpoint::checkRecords() const {
+    Header const &header = getHeader(_data);
+    auto corrupt = [this](std::string const &message) {
+        throw LSST_EXCEPT(pex::exceptions::RuntimeError, _path + ": corrupt fit checkpoint: " + message);
+    };
+
+    auto const *ccdImageRecords = readArray<CcdImageRecord>(_data, _ccdImageOffset);
+    std::uint64_t nMeasuredStars = 0;
+    for (std::size_t i = 0; i < header.nCcdImages; ++i) {
+        if (ccdImageRecords[i].nMeasuredStars > header.nMeasuredStars - nMeasuredStars) break;
+        nMeasuredStars += ccdImageRecords[i].nMeasuredStars;
+    }
+    if (nMeasuredStars != header.nMeasuredStars) {
+        corrupt("the measuredStars of its ccdImages do not add up to the " +
+                std::to_string(header.nMeasuredStars) + " of its header.");
+    }
+
+    auto const *measuredStarRecords = readArray<MeasuredStarRecord>(_data, _measuredStarOffset);
+    for (std::size_t i = 0; i < header.nMeasuredStars; ++i) {
+        std::int64_t const fittedStar = measuredStarRecords[i].fittedStar;
+        if (fittedStar < -1 || fittedStar >= static_cast<std::int64_t>(header.nFittedStars)) {
+            corrupt("measuredStar " + std::to_string(i) + " refers to fittedStar " +
+                    std::to_string(fittedStar) + ", out of " + std::to_string(header.nFittedStars) + ".");
+        }
+    }
+
+    auto const *fittedStarRecords = readArray<FittedStarRecord>(_data, _fittedStarOffset);
+    for (std::size_t i = 0; i < header.nFittedStars; ++i) {
+        std::int64_t const refStar = fittedStarRecords[i].refStar;
+        if (refStar < -1 || refStar >= static_cast<std::int64_t>(header.nRefStars)) {
+            corrupt("fittedStar " + std::to_string(i) + " refers to refStar " + std::to_string(refStar) +
+                    ", out of " + std::to_string(header.nRefStars) + ".");
+        }
+    }
+
+    auto const *chipRecords = readArray<ChipRecord>(_data, _chipOffset);
+    std::uint64_t nChipParameters = 0;
+    for (std::size_t i = 0; i < header.nChips; ++i) nChipParameters += chipRecords[i].nParameters;
+    if (nChipParameters != header.nChipParameters) {
+        corrupt("the parameters of its chips do not add up to the " +
+                std::to_string(header.nChipParameters) + " of its header.");
+    }
+}
+
+void FitCheckpoint::restoreAssociations(Associations &associations) const {
+    Header const &header = getHeader(_data);
+    auto const *ccdImageRecords = readArray<CcdImageRecord>(_data, _ccdImageOffset);
+    auto const *measuredStarRecords = readArray<MeasuredStarRecord>(_data, _measuredStarOffset);
+
+    // Find all the CcdImages first, so that associations is left untouched if one is missing.
+    std::map<std::pair<VisitIdType, CcdIdType>, CcdImage *> ccdImagesByKey;
+    for (auto const &ccdImage : associations.ccdImageList) {
+        ccdImagesByKey.emplace(std::make_pair(ccdImage->getVisit(), ccdImage->getCcdId()), ccdImage.get());
+    }
+    std::vector<CcdImage *> ccdImages(header.nCcdImages);
+    for (std::size_t i = 0; i < header.nCcdImages; ++i) {
+        auto found = ccdImagesByKey.find(std::make_pair(ccdImageRecords[i].visit, ccdImageRecords[i].ccd));
+        if (found == ccdImagesByKey.end()) {
+            throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                              "CcdImage visit=" + std::to_string(ccdImageRecords[i].visit) +
+                                      " ccd=" + std::to_string(ccdImageRecords[i].ccd) + " of " + _path +
+                                      " is not in the associations.");
+        }
+        ccdImages[i] = found->second;
+    }
+
+    auto fittedStars = restoreStarLists(associations);
+
+    // CcdImages that are not in the checkpoint had nothing left to fit.
+    for (auto const &ccdImage : associations.ccdImageList) ccdImage->getCatalogForFit().clear();
+    MeasuredStarRecord const *record = measuredStarRecords;
+    for (std::size_t i = 0; i < header.nCcdImages; ++i) {
+        auto &catalog = ccdImages[i]->getCatalogForFit();
+        for (std::size_t j = 0; j < ccdImageRecords[i].nMeasuredStars; ++j, ++record) {
+            auto measuredStar = std::make_shared<MeasuredStar>(BaseStar());
+            restoreStar(record->star, *measuredStar);
+            measuredStar->setInstFluxAndErr(record->instFlux, record->instFluxErr);
+            measuredStar->setXFocal(record->xFocal);
+            measuredStar->setYFocal(record->yFocal);
+            measuredStar->setRobustWeight(record->robustWeight);
+            measuredStar->setId(record->id);
+            measuredStar->setValid(record->valid);
+            measuredStar->setCcdImage(ccdImages[i]);
+            if (record->fittedStar >= 0) measuredStar->setFittedStar(fittedStars[record->fittedStar]);
+            catalog.push_back(std::move(measuredStar));
+        }
+    }
+    // setFittedStar() counted every link, but the outliers that were removed are not counted anymore.
+    restoreMeasurementCounts(fittedStars);
+
+    LOGLS_INFO(_log, "Restored fit checkpoint " << _path << ": " << header.nCcdImages << " ccdImages, "
+                                                << header.nMeasuredStars << " measuredStars, "
+                                                << header.nFittedStars << " fittedStars, "
+                                                << header.nRefStars << " refStars.");
+}
+
+void FitCheckpoint::restoreStars(Associations &associations) const {
+    Header const &header = getHeader(_data);
+    restoreMeasurementCounts(restoreStarLists(associations));
+    LOGLS_INFO(_log, "Restored the stars of fit checkpoint " << _path << ": " << header.nFittedStars
+                                                             << " fittedStars, " << header.nRefStars
+                                                             << " refStars.");
+}
+
+void FitCheckpoint::restoreFitter(FitterBase &fitter) const {
+    Header const &header = getHeader(_data);
+    fitter.assignIndices(getWhatToFit());
+    Eigen::Index const nParameters = fitter.getParameters().size();
+    if (nParameters != static_cast<Eigen::Index>(header.nParameters)) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "The fitter has " + std::to_string(nParameters) + " parameters for \"" +
+                                  getWhatToFit() + "\", but " + _path + " has " +
+                                  std::to_string(header.nParameters) + ".");
+    }
+    fitter.setParameters(Eigen::Map<Eigen::VectorXd const>(readArray<double>(_data, _parameterOffset),
+                                                           header.nParameters));
+}
+
+std::map<CcdIdType, Eigen::VectorXd> FitCheckpoint::getChipParameters() const {
+    Header const &header = getHeader(_data);
+    auto const *chipRecords = readArray<ChipRecord>(_data, _chipOffset);
+    double const *values = readArray<double>(_data, _chipParameterOffset);
+    std::map<CcdIdType, Eigen::VectorXd> chipParameters;
+    for (std::size_t i = 0; i < header.nChips; ++i) {
+        chipParameters.emplace(chipRecords[i].ccd,
+                               Eigen::Map<Eigen::VectorXd const>(values, chipRecords[i].nParameters));
+        values += chipRecords[i].nParameters;
+    }
+    return chipParameters;
+}
+
+std::vector<VisitIdType> FitCheckpoint::getVisits() const {
+    auto const *ccdImageRecords = readArray<CcdImageRecord>(_data, _ccdImageOffset);
+    std::set<VisitIdType> visits;
+    for (std::size_t i = 0; i < getHeader(_data).nCcdImages; ++i) visits.insert(ccdImageRecords[i].visit);
+    return std::vector<VisitIdType>(visits.begin(), visits.end());
+}
+
+std::string FitCheckpoint::getWhatToFit() const {
+    return std::string(_data + _whatToFitOffset, getHeader(_data).whatToFitSize);
+}
+
+std::size_t FitCheckpoint::getNCcdImages() const { return getHeader(_data).nCcdImages; }
+
+std::size_t FitCheckpoint::getNMeasuredStars() const { return getHeader(_data).nMeasuredStars; }
+
+std::size_t FitCheckpoint::getNFittedStars() const { return getHeader(_data).nFittedStars; }
+
+std::size_t FitCheckpoint::getNRefStars() const { return getHeader(_data).nRefStars; }
+
+std::vector<std::shared_ptr<FittedStar>> FitCheckpoint::restoreStarLists(Associations &associations) const {
+    Header const &header = getHeader(_data);
+    auto const *fittedStarRecords = readArray<FittedStarRecord>(_data, _fittedStarOffset);
+    auto const *refStarRecords = readArray<RefStarRecord>(_data, _refStarOffset);
+
+    associations.setCommonTangentPoint(
+            afw::geom::Point2D(header.commonTangentPoint[0], header.commonTangentPoint[1]));
+
+    std::vector<std::shared_ptr<RefStar>> refStars;
+    refStars.reserve(header.nRefStars);
+    associations.refStarList.clear();
+    for (std::size_t i = 0; i < header.nRefStars; ++i) {
+        auto const &record = refStarRecords[i];
+        auto refStar = std::make_shared<RefStar>(record.x, record.y, record.flux, record.fluxErr);
+        restoreStar(record, *refStar);
+        refStars.push_back(refStar);
+        associations.refStarList.push_back(std::move(refStar));
+    }
+
+    std::vector<std::shared_ptr<FittedStar>> fittedStars;
+    fittedStars.reserve(header.nFittedStars);
+    associations.fittedStarList.clear();
+    for (std::size_t i = 0; i < header.nFittedStars; ++i) {
+        auto const &record = fittedStarRecords[i];
+        auto fittedStar = std::make_shared<FittedStar>(BaseStar());
+        restoreStar(record.star, *fittedStar);
+        fittedStar->pmx = record.pmx;
+        fittedStar->pmy = record.pmy;
+        fittedStar->epmx = record.epmx;
+        fittedStar->epmy = record.epmy;
+        fittedStar->epmxy = record.epmxy;
+        fittedStar->color = record.color;
+        fittedStar->mightMove = record.mightMove;
+        fittedStar->setRobustWeight(record.robustWeight);
+        if (record.refStar >= 0) fittedStar->setRefStar(refStars[record.refStar].get());
+        fittedStars.push_back(fittedStar);
+        associations.fittedStarList.push_back(std::move(fittedStar));
+    }
+    associations.fittedStarList.inTangentPlaneCoordinates = header.inTangentPlaneCoordinates;
+    return fittedStars;
+}
+
+void FitCheckpoint::restoreMeasurementCounts(
+        std::vector<std::shared_ptr<FittedStar>> const &fittedStars) const {
+    auto const *fittedStarRecords = readArray<FittedStarRecord>(_data, _fittedStarOffset);
+    for (std::size_t i = 0; i < fittedStars.size(); ++i) {
+        fittedStars[i]->getMeasurementCount() = fittedStarRecords[i].measurementCount;
+    }
+}
+
+}  // namespace jointcal
+}  // namespace lsst
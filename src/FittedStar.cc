@@ -41,7 +41,11 @@ namespace jointcal {
 
 // cannot be in fittedstar.h, because of "crossed includes"
 FittedStar::FittedStar(const MeasuredStar &measuredStar)
-        : BaseStar(measuredStar), _indexInMatrix(-1), _measurementCount(0), _refStar(nullptr) {}
+        : BaseStar(measuredStar),
+          _indexInMatrix(-1),
+          _measurementCount(0),
+          _refStar(nullptr),
+          _robustWeight(1.0) {}
 
 void FittedStar::setRefStar(const RefStar *refStar) {
     if ((_refStar != nullptr) && (refStar != nullptr)) {
@@ -22,12 +22,21 @@
  * along with this program.  If not, see <https://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iterator>
+#include <limits>
+#include <numeric>
+#include <sstream>
 #include <vector>
 #include "Eigen/Core"
 
 #include <boost/math/tools/minima.hpp>
 
 #include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
 
 #include "lsst/jointcal/Chi2.h"
 #include "lsst/jointcal/CcdImage.h"
@@ -35,61 +44,215 @@
 #include "lsst/jointcal/FitterBase.h"
 #include "lsst/jointcal/FittedStar.h"
 #include "lsst/jointcal/MeasuredStar.h"
+#include "lsst/jointcal/Trace.h"
+#include "lsst/jointcal/Parallel.h"
 
 namespace lsst {
 namespace jointcal {
 
+namespace {
+/// Sum partials[begin, end) pairwise, so that the rounding error grows as log(n) instead of n.
+Chi2Statistic pairwiseSum(std::vector<Chi2Statistic> const &partials, std::size_t begin, std::size_t end) {
+    if (end - begin == 1) return partials[begin];
+    std::size_t middle = begin + (end - begin) / 2;
+    Chi2Statistic sum = pairwiseSum(partials, begin, middle);
+    sum += pairwiseSum(partials, middle, end);
+    return sum;
+}
+}  // namespace
+
 Chi2Statistic FitterBase::computeChi2() const {
-    Chi2Statistic chi2;
-    accumulateStatImageList(_associations->getCcdImageList(), chi2);
-    accumulateStatRefStars(chi2);
+    JOINTCAL_TRACE_SPAN("computeChi2");
+    // One partial sum per CcdImage, and one for the reference terms, combined in a fixed order: the result
+    // does not depend on the number of threads.
+    auto ranges = _getCcdImageRanges();
+    std::vector<std::size_t> firstCcdImage(ranges.size() + 1, 0);
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        firstCcdImage[i + 1] = firstCcdImage[i] + ranges[i].size();
+    }
+    std::vector<Chi2Statistic> partials(firstCcdImage.back() + 1);
+    parallelFor(ranges.size() + 1, _nThreads, [&](std::size_t i) {
+        if (i == ranges.size()) {
+            accumulateStatRefStars(partials.back());
+            return;
+        }
+        std::size_t ccdImageIndex = firstCcdImage[i];
+        for (auto const &ccdImage : ranges[i]) {
+            CcdImageList single(1, ccdImage);
+            accumulateStatImageList(single, partials[ccdImageIndex++]);
+        }
+    });
+    Chi2Statistic chi2 = pairwiseSum(partials, 0, partials.size());
     // chi2.ndof contains the number of squares.
     // So subtract the number of parameters.
     chi2.ndof -= _nParTot;
     return chi2;
 }
 
+namespace {
+/// A chi2 contribution, resolved to its contributor.
+struct ResolvedChi2Record {
+    Chi2Record record;
+    std::shared_ptr<MeasuredStar> measuredStar;  // null for a reference term
+    std::shared_ptr<FittedStar> fittedStar;      // only set for a reference term
+};
+
+/**
+ * Resolve the index of each record to its star, walking each catalog at most once.
+ *
+ * @param firstIndex  Global index of the first measurement of each CcdImage, followed by the global index
+ *                    of the first reference term (see FitterBase::_accumulateChi2List).
+ */
+std::vector<ResolvedChi2Record> resolveChi2Records(Chi2List::iterator first, Chi2List::iterator last,
+                                                 CcdImageList const &ccdImageList,
+                                                 FittedStarList const &fittedStarList,
+                                                 std::vector<std::size_t> const &firstIndex) {
+    // sorted in place: the records are scratch, only needed until they are resolved.
+    std::sort(first, last, [](Chi2Record const &a, Chi2Record const &b) { return a.index < b.index; });
+    std::size_t const nRecords = last - first;
+    std::vector<ResolvedChi2Record> candidates(nRecords);
+
+    auto ccdImage = ccdImageList.begin();
+    std::size_t ccdImageIndex = 0;
+    MeasuredStarList::const_iterator measuredStar;
+    std::size_t measuredStarIndex = 0;  // global index of measuredStar, if in the current catalog
+    auto fittedStar = fittedStarList.begin();
+    std::size_t fittedStarIndex = firstIndex.back();
+    for (std::size_t k = 0; k < nRecords; ++k) {
+        std::size_t const index = first[k].index;
+        candidates[k].record = first[k];
+        if (index < firstIndex.back()) {
+            if (index >= firstIndex[ccdImageIndex + 1] || k == 0) {
+                while (index >= firstIndex[ccdImageIndex + 1]) {
+                    ++ccdImageIndex;
+                    ++ccdImage;
+                }
+                measuredStar = (*ccdImage)->getCatalogForFit().cbegin();
+                measuredStarIndex = firstIndex[ccdImageIndex];
+            }
+            std::advance(measuredStar, index - measuredStarIndex);
+            measuredStarIndex = index;
+            candidates[k].measuredStar = *measuredStar;
+        } else {
+            std::advance(fittedStar, index - fittedStarIndex);
+            fittedStarIndex = index;
+            candidates[k].fittedStar = *fittedStar;
+        }
+    }
+    return candidates;
+}
+
+/// Name of ordering, for the logs.
+std::string orderingName(HessianOrdering ordering) {
+    switch (ordering) {
+        case HessianOrdering::AMD:
+            return "AMD";
+        case HessianOrdering::NestedDissection:
+            return "NestedDissection";
+        case HessianOrdering::StarsFirst:
+            return "StarsFirst";
+        default:
+            return "Default";
+    }
+}
+
+/// Weight of a term with normalized residual (square root of its chi2) under a robust loss.
+double computeRobustWeight(RobustLoss loss, double scale, double residual) {
+    switch (loss) {
+        case RobustLoss::Huber:
+            return (residual <= scale) ? 1 : scale / residual;
+        case RobustLoss::Cauchy:
+            return 1 / (1 + std::pow(residual / scale, 2));
+        default:
+            return 1;
+    }
+}
+}  // namespace
+
+void FitterBase::setRobustLoss(RobustLoss loss, double scale) {
+    _robustLoss = loss;
+    _robustScale = scale;
+    _linearHessianValid = false;
+    if (loss != RobustLoss::Quadratic) return;
+    for (auto const &ccdImage : _associations->getCcdImageList()) {
+        for (auto &measuredStar : ccdImage->getCatalogForFit()) measuredStar->setRobustWeight(1);
+    }
+    for (auto &fittedStar : _associations->fittedStarList) fittedStar->setRobustWeight(1);
+}
+
+double FitterBase::_updateRobustWeights() {
+    Chi2List &chi2List = _scratch.getChi2List(_nMeasuredStars + _associations->refStarList.size());
+    std::vector<std::size_t> firstIndex;
+    _accumulateChi2List(chi2List, firstIndex);
+    auto records = resolveChi2Records(chi2List.begin(), chi2List.end(), _associations->getCcdImageList(),
+                                      _associations->fittedStarList, firstIndex);
+
+    double maxChange = 0;
+    std::size_t nDownWeighted = 0;
+    for (auto const &record : records) {
+        double weight = computeRobustWeight(_robustLoss, _robustScale, std::sqrt(record.record.chi2));
+        if (weight < 1) ++nDownWeighted;
+        if (record.measuredStar != nullptr) {
+            maxChange = std::max(maxChange, std::abs(weight - record.measuredStar->getRobustWeight()));
+            record.measuredStar->setRobustWeight(weight);
+        } else {
+            maxChange = std::max(maxChange, std::abs(weight - record.fittedStar->getRobustWeight()));
+            record.fittedStar->setRobustWeight(weight);
+        }
+    }
+    LOGLS_DEBUG(_log, "Robust weights: " << nDownWeighted << " of " << records.size()
+                                         << " terms down-weighted, largest change " << maxChange);
+    return maxChange;
+}
+
 unsigned FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutliers,
                                   FittedStarList &fsOutliers) const {
-    // collect chi2 contributions
-    Chi2List chi2List;
-    chi2List.reserve(_nMeasuredStars + _associations->refStarList.size());
-    // contributions from measurement terms:
-    accumulateStatImageList(_associations->ccdImageList, chi2List);
-    // and from reference terms
-    accumulateStatRefStars(chi2List);
-
-    // compute some statistics
+    JOINTCAL_TRACE_SPAN("findOutliers");
+    // collect chi2 contributions, and their statistics
+    Chi2List &chi2List = _scratch.getChi2List(_nMeasuredStars + _associations->refStarList.size());
+    std::vector<std::size_t> firstIndex;
+    _accumulateChi2List(chi2List, firstIndex);
+
     size_t nval = chi2List.size();
     if (nval == 0) return 0;
-    sort(chi2List.begin(), chi2List.end());
-    double median = (nval & 1) ? chi2List[nval / 2].chi2
-                               : 0.5 * (chi2List[nval / 2 - 1].chi2 + chi2List[nval / 2].chi2);
     auto averageAndSigma = chi2List.computeAverageAndSigma();
+    auto middle = chi2List.begin() + nval / 2;
+    std::nth_element(chi2List.begin(), middle, chi2List.end());
+    double median = middle->chi2;
+    if ((nval & 1) == 0) median = 0.5 * (median + std::max_element(chi2List.begin(), middle)->chi2);
     LOGLS_DEBUG(_log, "findOutliers chi2 stat: mean/median/sigma " << averageAndSigma.first << '/' << median
                                                                    << '/' << averageAndSigma.second);
     double cut = averageAndSigma.first + nSigmaCut * averageAndSigma.second;
+
+    // Only the contributions above the cut need to be resolved to their star, and sorted.
+    auto aboveCut = std::partition(chi2List.begin(), chi2List.end(),
+                                   [cut](Chi2Record const &record) { return record.chi2 >= cut; });
+    auto candidates = resolveChi2Records(chi2List.begin(), aboveCut, _associations->getCcdImageList(),
+                                         _associations->fittedStarList, firstIndex);
+    // start from the strongest outliers.
+    std::sort(candidates.begin(), candidates.end(),
+              [](ResolvedChi2Record const &a, ResolvedChi2Record const &b) {
+                  return (a.record.chi2 > b.record.chi2) ||
+                         (a.record.chi2 == b.record.chi2 && a.record.index < b.record.index);
+              });
+
     /* For each of the parameters, we will not remove more than 1
        measurement that contributes to constraining it. Keep track using
        of what we are touching using an integer vector. This is the
        trick that Marc Betoule came up to for outlier removals in "star
        flats" fits. */
-    Eigen::VectorXi affectedParams(_nParTot);
-    affectedParams.setZero();
+    Eigen::VectorXi &affectedParams = _scratch.getCounters(_nParTot);
 
     unsigned nOutliers = 0;  // returned to the caller
-    // start from the strongest outliers.
-    for (auto chi2 = chi2List.rbegin(); chi2 != chi2List.rend(); ++chi2) {
-        if (chi2->chi2 < cut) break;  // because the array is sorted.
+    for (auto const &candidate : candidates) {
         std::vector<unsigned> indices;
         /* now, we want to get the indices of the parameters this chi2
            term depends on. We have to figure out which kind of term it
-           is; we use for that the type of the star attached to the Chi2Star. */
-        auto measuredStar = std::dynamic_pointer_cast<MeasuredStar>(chi2->star);
-        std::shared_ptr<FittedStar> fittedStar;  // To add to fsOutliers if it is a reference outlier.
+           is, from the star the index was resolved to. */
+        auto const &measuredStar = candidate.measuredStar;
+        auto const &fittedStar = candidate.fittedStar;  // To add to fsOutliers if it is a reference outlier.
         if (measuredStar == nullptr) {
             // it is a reference outlier
-            fittedStar = std::dynamic_pointer_cast<FittedStar>(chi2->star);
             if (fittedStar->getMeasurementCount() == 0) {
                 LOGLS_WARN(_log, "FittedStar with no measuredStars found as an outlier: " << *fittedStar);
                 continue;
@@ -97,7 +260,8 @@ unsigned FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutliers
             // NOTE: Stars contribute twice to astrometry (x,y), but once to photometry (flux),
             // NOTE: but we only need to mark one index here because both will be removed with that star.
             indices.push_back(fittedStar->getIndexInMatrix());
-            LOGLS_TRACE(_log, "Removing refStar " << *(fittedStar->getRefStar()) << " chi2: " << chi2->chi2);
+            LOGLS_TRACE(_log, "Removing refStar " << *(fittedStar->getRefStar())
+                                                  << " chi2: " << candidate.record.chi2);
             /* One might think it would be useful to account for PM
                parameters here, but it is just useless */
         } else {
@@ -109,7 +273,7 @@ unsigned FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutliers
                 continue;
             }
             getIndicesOfMeasuredStar(*measuredStar, indices);
-            LOGLS_TRACE(_log, "Removing measStar " << *measuredStar << " chi2: " << chi2->chi2);
+            LOGLS_TRACE(_log, "Removing measStar " << *measuredStar << " chi2: " << candidate.record.chi2);
         }
 
         /* Find out if we already discarded a stronger outlier
@@ -146,18 +310,39 @@ unsigned FitterBase::findOutliers(double nSigmaCut, MeasuredStarList &msOutliers
 }
 
 namespace {
-/// Return a Hessian matrix filled from tripletList of size nParTot x nParTot.
-SparseMatrixD createHessian(int nParTot, TripletList const &tripletList) {
-    SparseMatrixD jacobian(nParTot, tripletList.getNextFreeIndex());
-    jacobian.setFromTriplets(tripletList.begin(), tripletList.end());
-    return jacobian * jacobian.transpose();
+// Downdating is expected to cost at most this many flops per outlier Jacobian column and non-zero of the
+// factor; above that, refactoring the downdated Hessian is cheaper.
+double const downdateFlopsPerFactorNonZero = 2;
+// A downdated factor may solve the steps this many times less accurately than a fresh one.
+double const downdateDriftGrowth = 100;
+// Number of increases of the Levenberg-Marquardt damping before giving up the step.
+unsigned const maxDampingTrials = 10;
+// The robust weights are converged when none changes by more than this.
+double const robustWeightTolerance = 1e-2;
+
+/// Relative residual |hessian*delta - grad|/|grad| of the normal equations; hessian is a lower triangle.
+double computeRelativeResidual(SparseMatrixD const &hessian, Eigen::VectorXd const &delta,
+                               Eigen::VectorXd const &grad) {
+    return (hessian.selfadjointView<Eigen::Lower>() * delta - grad).norm() / grad.norm();
 }
 
-/// Write matrix and gradient to files built from dumpFile, and log their names.
+/// Set a flag for the lifetime of the guard, or until release().
+class FlagGuard {
+public:
+    explicit FlagGuard(bool &flag) : _flag(flag) { _flag = true; }
+    ~FlagGuard() { release(); }
+    void release() { _flag = false; }
+
+private:
+    bool &_flag;
+};
+
+/// Write matrix (given by its lower triangle) and gradient to files built from dumpFile, and log their names.
 void dumpMatrixAndGradient(SparseMatrixD const &matrix, Eigen::VectorXd const &grad,
                            std::string const &dumpFile, LOG_LOGGER _log) {
     std::string ext = ".txt";
-    Eigen::MatrixXd matrixDense(matrix);
+    SparseMatrixD fullMatrix = matrix.selfadjointView<Eigen::Lower>();
+    Eigen::MatrixXd matrixDense(fullMatrix);
     std::string dumpMatrixPath = dumpFile + "-mat" + ext;
     std::ofstream matfile(dumpMatrixPath);
     matfile << matrixDense << std::endl;
@@ -170,56 +355,152 @@ void dumpMatrixAndGradient(SparseMatrixD const &matrix, Eigen::VectorXd const &g
 
 MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaCut, bool doRankUpdate,
                                     bool const doLineSearch, std::string const &dumpMatrixFile) {
+    StageTimer timer(_metrics);
+    JOINTCAL_TRACE_SPAN_DETAIL("minimize", whatToFit);
+    return _minimize(whatToFit, nSigmaCut, doRankUpdate, doLineSearch, dumpMatrixFile);
+}
+
+MinimizeResult FitterBase::_minimize(std::string const &whatToFit, double nSigmaCut, bool doRankUpdate,
+                                     bool doLineSearch, std::string const &dumpMatrixFile) {
+    // The layout of a given whatToFit does not change: minimizeAlternating() can switch to another one and
+    // back without losing what was cached for it.
+    bool const sameParameters = (whatToFit == _minimizedWhatToFit);
     assignIndices(whatToFit);
+    _minimizedWhatToFit = whatToFit;
+    _scratch.resetNAllocations();
+    _hessianAssembler.resetNAllocations();
+    // the cached Hessian sparsity pattern is only valid for a given parameter layout.
+    if (!sameParameters || _nParTot != _hessianAssembler.getNParTot()) {
+        _hessianAssembler.reset(_nParTot);
+    }
+    bool const robust = _robustLoss != RobustLoss::Quadratic;
+    bool const damped = _initialDamping > 0 && _solverMode != SolverMode::ConjugateGradient && !robust;
+    if (_initialDamping > 0 && !damped) {
+        LOGLS_WARN(_log, "Levenberg-Marquardt damping is not supported by the conjugate gradient solver, "
+                         "nor with a robust loss.");
+    }
+    if (robust) {
+        // weights from the residuals of the starting point.
+        _updateRobustWeights();
+    }
+    if (!sameParameters) {
+        _damping = _initialDamping;
+        _dampingIncrease = 2;
+    }
+    _dampingHistory.clear();
+    // The Hessian of a linear fit does not depend on the parameters: the one left by the previous minimize()
+    // with the same parameters, and its factorization, are still valid.
+    bool const keepHessian = isLinear() && !damped && !robust && _solverMode != SolverMode::ConjugateGradient;
+    bool const reuseHessian = keepHessian && sameParameters && _linearHessianValid &&
+                              _linearHessian.rows() == static_cast<Eigen::Index>(_nParTot) &&
+                              dumpMatrixFile == "";
+    _linearHessianValid = false;
+    if (_solverMode == SolverMode::SchurComplement && !reuseHessian) {
+        std::vector<std::pair<unsigned, unsigned>> blocks;
+        for (auto const &fittedStar : _associations->fittedStarList) {
+            unsigned nPar = getNParFittedStar(*fittedStar);
+            if (nPar > 0) blocks.emplace_back(fittedStar->getIndexInMatrix(), nPar);
+        }
+        _schurComplement.setBlocks(_nParTot, blocks);
+        LOGLS_DEBUG(_log, "Eliminating " << blocks.size() << " FittedStars: reduced system dim="
+                                         << _schurComplement.getNParReduced());
+    }
 
     MinimizeResult returnCode = MinimizeResult::Converged;
 
-    // TODO : write a guesser for the number of triplets
-    unsigned nTrip = (_lastNTrip) ? _lastNTrip : 1e6;
-    TripletList tripletList(nTrip);
     Eigen::VectorXd grad(_nParTot);
     grad.setZero();
     double scale = 1.0;
 
-    // Fill the triplets
-    leastSquareDerivatives(tripletList, grad);
-    _lastNTrip = tripletList.size();
-
-    LOGLS_DEBUG(_log, "End of triplet filling, ntrip = " << tripletList.size());
+    SparseMatrixD hessian;
+    unsigned nDowndates = 0;  // since the last factorization
+    if (reuseHessian) {
+        hessian = std::move(_linearHessian);
+        nDowndates = _linearNDowndates;
+        _computeGradient(grad);
+        LOGLS_DEBUG(_log, "Reusing the factorized hessian of the previous linear fit: dim="
+                                  << hessian.rows() << " downdates=" << nDowndates);
+    } else if (_solverMode == SolverMode::ConjugateGradient) {
+        if (dumpMatrixFile != "") {
+            LOGLS_WARN(_log, "The Hessian is not computed by the conjugate gradient solver: not dumping it.");
+        }
+        _prepareConjugateGradient(grad);
+    } else {
+        leastSquareDerivatives(hessian, grad);
 
-    SparseMatrixD hessian = createHessian(_nParTot, tripletList);
-    tripletList.clear();  // we don't need it any more after we have the hessian.
+        LOGLS_DEBUG(_log, "Starting factorization, hessian: dim="
+                                  << hessian.rows() << " non-zeros=" << hessian.nonZeros()
+                                  << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
 
-    LOGLS_DEBUG(_log, "Starting factorization, hessian: dim="
-                              << hessian.rows() << " non-zeros=" << hessian.nonZeros()
-                              << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
+        if (!sameParameters) _reportComponents(hessian);
 
-    if (dumpMatrixFile != "") {
-        if (hessian.rows() * hessian.cols() > 2e8) {
-            LOGLS_WARN(_log, "Hessian matrix is too big to dump to file, with rows, columns: "
-                                     << hessian.rows() << ", " << hessian.cols());
-        } else {
-            dumpMatrixAndGradient(hessian, grad, dumpMatrixFile, _log);
+        if (dumpMatrixFile != "") {
+            if (hessian.rows() * hessian.cols() > 2e8) {
+                LOGLS_WARN(_log, "Hessian matrix is too big to dump to file, with rows, columns: "
+                                         << hessian.rows() << ", " << hessian.cols());
+            } else {
+                dumpMatrixAndGradient(hessian, grad, dumpMatrixFile, _log);
+            }
         }
-    }
 
-    CholmodSimplicialLDLT2<SparseMatrixD> chol(hessian);
-    if (chol.info() != Eigen::Success) {
-        LOGLS_ERROR(_log, "minimize: factorization failed ");
-        return MinimizeResult::Failed;
+        // The damped Hessian is factorized by each Levenberg-Marquardt step.
+        if (!damped && !_prepareSolver(hessian)) {
+            LOGLS_ERROR(_log, "minimize: factorization failed ");
+            return MinimizeResult::Failed;
+        }
     }
 
     unsigned totalMeasOutliers = 0;
     unsigned totalRefOutliers = 0;
-    double oldChi2 = computeChi2().chi2;
+    unsigned nRobustSolves = 0;
+    bool const mayDowndate = doRankUpdate && nSigmaCut != 0 && _solverMode == SolverMode::Direct;
+    Chi2Statistic currentChi2(computeChi2());
+    double oldChi2 = currentChi2.chi2;
 
     while (true) {
-        Eigen::VectorXd delta = chol.solve(grad);
-        if (doLineSearch) {
-            scale = _lineSearch(delta);
+        if (damped) {
+            MinimizeResult stepResult = _dampedStep(hessian, grad, currentChi2);
+            if (stepResult == MinimizeResult::Failed) {
+                LOGLS_ERROR(_log, "minimize: damped step failed ");
+                return MinimizeResult::Failed;
+            }
+            if (stepResult == MinimizeResult::Chi2Increased) {
+                // the parameters are unchanged: this is not a converged fit.
+                returnCode = MinimizeResult::Chi2Increased;
+                break;
+            }
+        } else {
+            Eigen::VectorXd delta;
+            if (!_solve(grad, delta)) {
+                LOGLS_ERROR(_log, "minimize: solution failed ");
+                return MinimizeResult::Failed;
+            }
+            if (nDowndates > 0) {
+                // Check that the downdated factor still solves the (downdated) Hessian accurately enough,
+                // compared with what a fresh factor of this Hessian achieves.
+                double drift = computeRelativeResidual(hessian, delta, grad);
+                double maxDrift = std::max(_maxDowndateDrift, downdateDriftGrowth * _factorResidual);
+                if (drift > maxDrift) {
+                    LOGLS_DEBUG(_log, "Refactoring after " << nDowndates
+                                                           << " downdates: relative residual of the step "
+                                                           << drift << " above " << maxDrift);
+                    if (!_prepareSolver(hessian) || !_solve(grad, delta)) {
+                        LOGLS_ERROR(_log, "minimize: factorization failed ");
+                        return MinimizeResult::Failed;
+                    }
+                    nDowndates = 0;
+                }
+            }
+            if (nDowndates == 0 && _factorResidual < 0 && mayDowndate) {
+                // the accuracy of the fresh factor, which the downdated ones are judged against.
+                _factorResidual = computeRelativeResidual(hessian, delta, grad);
+            }
+            if (doLineSearch && !robust) {
+                scale = _lineSearch(delta, grad);
+            }
+            offsetParams(scale * delta);
+            currentChi2 = computeChi2();
         }
-        offsetParams(scale * delta);
-        Chi2Statistic currentChi2(computeChi2());
         LOGLS_DEBUG(_log, currentChi2);
         if (!isfinite(currentChi2.chi2)) {
             LOGL_ERROR(_log, "chi2 is not finite. Aborting outlier rejection.");
@@ -233,6 +514,26 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
         }
         oldChi2 = currentChi2.chi2;
 
+        if (robust && nRobustSolves < _robustMaxIterations) {
+            ++nRobustSolves;
+            if (_updateRobustWeights() > robustWeightTolerance) {
+                // Solve again with the new weights: the Hessian pattern, hence the symbolic analysis, is
+                // unchanged.
+                grad.setZero();
+                if (_solverMode == SolverMode::ConjugateGradient) {
+                    _prepareConjugateGradient(grad);
+                } else {
+                    leastSquareDerivatives(hessian, grad);
+                    if (!_prepareSolver(hessian)) {
+                        LOGLS_ERROR(_log, "minimize: factorization failed ");
+                        return MinimizeResult::Failed;
+                    }
+                }
+                nDowndates = 0;
+                continue;
+            }
+        }
+
         if (nSigmaCut == 0) break;  // no rejection step to perform
         MeasuredStarList msOutliers;
         FittedStarList fsOutliers;
@@ -241,6 +542,7 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
         totalMeasOutliers += msOutliers.size();
         totalRefOutliers += fsOutliers.size();
         if (nOutliers == 0) break;
+        JOINTCAL_TRACE_SPAN("removeOutliers");
         TripletList outlierTriplets(nOutliers);
         grad.setZero();  // recycle the gradient
         // compute the contributions of outliers to derivatives
@@ -248,38 +550,85 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
         // Remove significant outliers
         removeMeasOutliers(msOutliers);
         removeRefOutliers(fsOutliers);
-        if (doRankUpdate) {
+        if (doRankUpdate && _solverMode == SolverMode::ConjugateGradient) {
+            // The Hessian products are recomputed from the remaining measurements, so only the gradient
+            // needs updating; the preconditioner, which only affects convergence, is kept.
+            grad *= -1;
+        } else if (doRankUpdate) {
             // convert triplet list to eigen internal format
             SparseMatrixD H(_nParTot, outlierTriplets.getNextFreeIndex());
             H.setFromTriplets(outlierTriplets.begin(), outlierTriplets.end());
-            chol.update(H, false /* means downdate */);
+            // The Hessian is kept in sync with the factor, to monitor the drift of the downdates and
+            // to refactor it. Its pattern is unchanged, so only the numeric phase of a refactorization is
+            // redone.
+            SparseMatrixD outlierHessian = H * H.transpose();
+            hessian -= SparseMatrixD(outlierHessian.triangularView<Eigen::Lower>());
+            // A supernodal factor, a Schur complement, a split system or a damped Hessian cannot be
+            // downdated.
+            bool downdate = !damped && _solverMode == SolverMode::Direct && _cholesky.canUpdate() &&
+                            _components.getNComponents() <= 1;
+            if (downdate) {
+                double downdateFlops =
+                        downdateFlopsPerFactorNonZero * H.cols() * _cholesky.getFactorNonZeros();
+                downdate = downdateFlops < _cholesky.getFactorizationFlops();
+                if (!downdate) {
+                    LOGLS_DEBUG(_log, "Refactoring instead of downdating " << H.cols()
+                                                                           << " outlier Jacobian columns");
+                }
+            }
+            if (downdate) {
+                if (_borderedSystem.getNBorder() > 0) {
+                    // Only the interior is factorized: it is downdated by the interior rows of the
+                    // outliers, and the border is reduced again with the downdated couplings.
+                    _cholesky.update(_borderedSystem.getInteriorRows(H), false /* means downdate */);
+                    _borderedSystem.updateCouplings(hessian);
+                    downdate = _borderedSystem.reduce(_cholesky);
+                } else {
+                    _cholesky.update(H, false /* means downdate */);
+                }
+                ++nDowndates;
+                ++_metrics.nRankUpdates;
+            }
+            if (!downdate && !damped) {
+                if (!_prepareSolver(hessian)) {
+                    LOGLS_ERROR(_log, "minimize: factorization failed ");
+                    return MinimizeResult::Failed;
+                }
+                nDowndates = 0;
+            }
             // The contribution of outliers to the gradient is the opposite
             // of the contribution of all other terms, because they add up to 0
             grad *= -1;
+        } else if (_solverMode == SolverMode::ConjugateGradient) {
+            grad.setZero();
+            _prepareConjugateGradient(grad);
         } else {
-            // don't reuse tripletList because we want a new nextFreeIndex.
-            TripletList nextTripletList(_lastNTrip);
             grad.setZero();
             // Rebuild the matrix and gradient
-            leastSquareDerivatives(nextTripletList, grad);
-            _lastNTrip = nextTripletList.size();
-            LOGLS_DEBUG(_log, "Triplets recomputed, ntrip = " << nextTripletList.size());
-
-            hessian = createHessian(_nParTot, nextTripletList);
-            nextTripletList.clear();  // we don't need it any more after we have the hessian.
+            leastSquareDerivatives(hessian, grad);
 
             LOGLS_DEBUG(_log,
                         "Restarting factorization, hessian: dim="
                                 << hessian.rows() << " non-zeros=" << hessian.nonZeros()
                                 << " filling-frac = " << hessian.nonZeros() / std::pow(hessian.rows(), 2));
-            chol.compute(hessian);
-            if (chol.info() != Eigen::Success) {
+            if (!damped && !_prepareSolver(hessian)) {
                 LOGLS_ERROR(_log, "minimize: factorization failed ");
                 return MinimizeResult::Failed;
             }
         }
+        // the next damped step is judged against the chi2 without the outliers.
+        if (damped) currentChi2 = computeChi2();
+    }
+
+    if (keepHessian && returnCode != MinimizeResult::NonFinite) {
+        _linearHessian = std::move(hessian);
+        _linearNDowndates = nDowndates;
+        _linearHessianValid = true;
     }
 
+    LOGLS_DEBUG(_log, "Work buffers: " << getNScratchAllocations() << " allocations, " << getScratchBytes()
+                                       << " bytes kept");
+
     // only print the outlier summary if outlier rejection was turned on.
     if (nSigmaCut != 0) {
         LOGLS_INFO(_log, "Number of outliers (Measured + Reference = Total): "
@@ -289,18 +638,150 @@ MinimizeResult FitterBase::minimize(std::string const &whatToFit, double nSigmaC
     return returnCode;
 }
 
+MinimizeResult FitterBase::minimizeAlternating(std::string const &whatToFit, double nSigmaCut,
+                                               bool doLineSearch, bool finishJointly) {
+    StageTimer timer(_metrics);
+    JOINTCAL_TRACE_SPAN_DETAIL("minimizeAlternating", whatToFit);
+    std::string starWhatToFit, modelWhatToFit;
+    splitWhatToFit(whatToFit, starWhatToFit, modelWhatToFit);
+    if (starWhatToFit.empty() || modelWhatToFit.empty()) {
+        LOGLS_DEBUG(_log, "Nothing to alternate in '" << whatToFit << "': minimizing it jointly");
+        return _minimize(whatToFit, nSigmaCut, true, doLineSearch, "");
+    }
+
+    LOGLS_INFO(_log, "Alternating between fitting " << starWhatToFit << " and " << modelWhatToFit);
+    FlagGuard switching(_switchingIndices);
+    // The star layout is the same at each iteration, and so are its blocks.
+    assignIndices(starWhatToFit);
+    _setFittedStarBlocks();
+
+    MinimizeResult returnCode = MinimizeResult::Converged;
+    unsigned totalMeasOutliers = 0;
+    unsigned totalRefOutliers = 0;
+    double oldChi2 = computeChi2().chi2;
+    while (true) {
+        double chi2 = oldChi2;
+        unsigned iteration = 0;
+        bool converged = false;
+        while (!converged && iteration < _alternatingMaxIterations) {
+            ++iteration;
+            assignIndices(starWhatToFit);
+            _updateFittedStars();
+            MinimizeResult modelResult = _minimize(modelWhatToFit, 0, false, doLineSearch, "");
+            if (modelResult == MinimizeResult::Failed || modelResult == MinimizeResult::NonFinite) {
+                assignIndices(whatToFit);
+                return modelResult;
+            }
+            double const newChi2 = computeChi2().chi2;
+            if (!std::isfinite(newChi2)) {
+                LOGL_ERROR(_log, "chi2 is not finite. Aborting the alternating fit.");
+                assignIndices(whatToFit);
+                return MinimizeResult::NonFinite;
+            }
+            converged = chi2 - newChi2 <= _alternatingTolerance * newChi2;
+            chi2 = newChi2;
+        }
+        if (converged) {
+            LOGLS_DEBUG(_log, "Alternating fit converged after " << iteration
+                                                                 << " iterations: chi2=" << chi2);
+        } else {
+            LOGLS_WARN(_log, "Alternating fit did not converge after " << iteration << " iterations: chi2="
+                                                                       << chi2);
+        }
+        if (chi2 > oldChi2 && totalMeasOutliers + totalRefOutliers != 0) {
+            LOGL_WARN(_log, "chi2 went up, skipping outlier rejection loop");
+            returnCode = MinimizeResult::Chi2Increased;
+            break;
+        }
+        oldChi2 = chi2;
+
+        if (nSigmaCut == 0) break;
+        // the outliers are searched with the indices of the joint fit.
+        assignIndices(whatToFit);
+        MeasuredStarList msOutliers;
+        FittedStarList fsOutliers;
+        int nOutliers = findOutliers(nSigmaCut, msOutliers, fsOutliers);
+        totalMeasOutliers += msOutliers.size();
+        totalRefOutliers += fsOutliers.size();
+        if (nOutliers == 0) break;
+        removeMeasOutliers(msOutliers);
+        removeRefOutliers(fsOutliers);
+        // the Hessian kept by the model steps still has the outlier terms.
+        _linearHessianValid = false;
+    }
+
+    if (finishJointly && returnCode == MinimizeResult::Converged) {
+        switching.release();
+        returnCode = _minimize(whatToFit, 0, false, doLineSearch, "");
+    } else {
+        assignIndices(whatToFit);
+    }
+    if (nSigmaCut != 0) {
+        LOGLS_INFO(_log, "Number of outliers (Measured + Reference = Total): "
+                                 << totalMeasOutliers << " + " << totalRefOutliers << " = "
+                                 << totalMeasOutliers + totalRefOutliers);
+    }
+    return returnCode;
+}
+
+void FitterBase::_splitWords(std::string const &whatToFit, std::vector<std::string> const &starWords,
+                             std::string &starWhatToFit, std::string &modelWhatToFit) {
+    starWhatToFit.clear();
+    modelWhatToFit.clear();
+    std::istringstream words(whatToFit);
+    std::string word;
+    while (words >> word) {
+        bool const isStar = std::find(starWords.begin(), starWords.end(), word) != starWords.end();
+        std::string &part = isStar ? starWhatToFit : modelWhatToFit;
+        if (!part.empty()) part += " ";
+        part += word;
+    }
+}
+
+void FitterBase::_setFittedStarBlocks() {
+    std::vector<std::vector<unsigned>> blocks;
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        unsigned nPar = getNParFittedStar(*fittedStar);
+        if (nPar == 0) continue;
+        blocks.emplace_back(nPar);
+        for (unsigned k = 0; k < nPar; ++k) blocks.back()[k] = fittedStar->getIndexInMatrix() + k;
+    }
+    _starPreconditioner.setBlocks(_nParTot, blocks);
+}
+
+void FitterBase::_updateFittedStars() {
+    JOINTCAL_TRACE_SPAN("updateFittedStars");
+    // Each term only involves the parameters of one star: the Hessian is its diagonal blocks, so that the
+    // block-Jacobi "preconditioner" solves it exactly.
+    auto ranges = _getCcdImageRanges();
+    auto &rangeGrads = _scratch.getGradients(ranges.size(), _nParTot);
+    _starPreconditioner.start(ranges.size());
+    _streamDerivatives(ranges, &rangeGrads,
+                       [this](std::size_t slot, std::size_t, TripletList const &jacobian) {
+                           _starPreconditioner.add(jacobian, slot);
+                       });
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);
+    for (auto const &rangeGrad : rangeGrads) grad += rangeGrad;
+    // unconstrained stars fall back to their diagonal, i.e. do not move.
+    std::size_t nUnconstrained = _starPreconditioner.finish();
+    offsetParams(_starPreconditioner.apply(grad));
+    LOGLS_DEBUG(_log, "Updated " << _starPreconditioner.getNBlocks() << " FittedStars, " << nUnconstrained
+                                 << " not positive definite");
+}
+
 void FitterBase::outliersContributions(MeasuredStarList &msOutliers, FittedStarList &fsOutliers,
                                        TripletList &tripletList, Eigen::VectorXd &grad) {
     for (auto &outlier : msOutliers) {
         MeasuredStarList tmp;
         tmp.push_back(outlier);
         const CcdImage &ccdImage = outlier->getCcdImage();
-        leastSquareDerivativesMeasurement(ccdImage, tripletList, grad, &tmp);
+        leastSquareDerivativesMeasurement(ccdImage, tripletList, &grad, &tmp);
     }
-    leastSquareDerivativesReference(fsOutliers, tripletList, grad);
+    leastSquareDerivativesReference(fsOutliers, tripletList, &grad);
 }
 
 void FitterBase::removeMeasOutliers(MeasuredStarList &outliers) {
+    _metrics.nMeasOutliers += outliers.size();
     for (auto &measuredStar : outliers) {
         auto fittedStar = measuredStar->getFittedStar();
         measuredStar->setValid(false);
@@ -309,17 +790,390 @@ void FitterBase::removeMeasOutliers(MeasuredStarList &outliers) {
 }
 
 void FitterBase::removeRefOutliers(FittedStarList &outliers) {
+    _metrics.nRefOutliers += outliers.size();
     for (auto &fittedStar : outliers) {
         fittedStar->setRefStar(nullptr);
     }
 }
 
+namespace {
+/**
+ * Split ccdImageList into at most nRanges contiguous ranges holding roughly the same number of
+ * measurements, preserving the order of the CcdImages.
+ */
+std::vector<CcdImageList> splitCcdImageList(CcdImageList const &ccdImageList, std::size_t nRanges) {
+    std::size_t nMeasurements = 0;
+    for (auto const &ccdImage : ccdImageList) nMeasurements += ccdImage->getCatalogForFit().size();
+    std::size_t target = nMeasurements / nRanges + 1;
+
+    std::vector<CcdImageList> ranges(1);
+    std::size_t count = 0;
+    for (auto const &ccdImage : ccdImageList) {
+        if (count >= target && ranges.size() < nRanges) {
+            ranges.emplace_back();
+            count = 0;
+        }
+        ranges.back().push_back(ccdImage);
+        count += ccdImage->getCatalogForFit().size();
+    }
+    return ranges;
+}
+
+/**
+ * Maximum number of chunks of CcdImages summed separately by _getCcdImageChunks(): more chunks allow more
+ * threads, but each adds a pass over the Hessian accumulators.
+ */
+std::size_t const maxCcdImageChunks = 64;
+
+/// Add the gradients of slots [0, nSlots) to grad, in slot order, and zero them.
+void foldGradients(std::vector<Eigen::VectorXd> &slotGrads, std::size_t nSlots, Eigen::VectorXd &grad) {
+    for (std::size_t i = 0; i < nSlots; ++i) {
+        grad += slotGrads[i];
+        slotGrads[i].setZero();
+    }
+}
+}  // namespace
+
 void FitterBase::leastSquareDerivatives(TripletList &tripletList, Eigen::VectorXd &grad) const {
     auto ccdImageList = _associations->getCcdImageList();
-    for (auto const &ccdImage : ccdImageList) {
-        leastSquareDerivativesMeasurement(*ccdImage, tripletList, grad);
+    // Size the triplets exactly beforehand, rather than letting them grow (and transiently double).
+    DerivativesCount count;
+    countDerivativesReference(count);
+    if (_nThreads <= 1 || ccdImageList.size() <= 1) {
+        for (auto const &ccdImage : ccdImageList) countDerivativesMeasurement(*ccdImage, count);
+        tripletList.reserve(tripletList.size() + count.nNonZeros);
+        for (auto const &ccdImage : ccdImageList) {
+            leastSquareDerivativesMeasurement(*ccdImage, tripletList, &grad);
+        }
+    } else {
+        // Each range of CcdImages fills its own triplets (with Jacobian columns starting at 0) and gradient.
+        auto ranges = splitCcdImageList(ccdImageList, _nThreads);
+        std::vector<TripletList> rangeTriplets;
+        rangeTriplets.reserve(ranges.size());
+        for (auto const &range : ranges) {
+            DerivativesCount rangeCount;
+            for (auto const &ccdImage : range) countDerivativesMeasurement(*ccdImage, rangeCount);
+            rangeTriplets.emplace_back(rangeCount.nNonZeros);
+            count.nNonZeros += rangeCount.nNonZeros;
+        }
+        tripletList.reserve(tripletList.size() + count.nNonZeros);
+        std::vector<Eigen::VectorXd> rangeGrads(ranges.size(), Eigen::VectorXd::Zero(grad.size()));
+        parallelFor(ranges.size(), _nThreads, [&](std::size_t i) {
+            for (auto const &ccdImage : ranges[i]) {
+                leastSquareDerivativesMeasurement(*ccdImage, rangeTriplets[i], &rangeGrads[i]);
+            }
+        });
+        // Merge in CcdImage order, shifting the columns so they match what a serial pass would produce.
+        for (std::size_t i = 0; i < ranges.size(); ++i) {
+            unsigned offset = tripletList.getNextFreeIndex();
+            for (auto const &trip : rangeTriplets[i]) {
+                tripletList.addTriplet(trip.row(), trip.col() + offset, trip.value());
+            }
+            tripletList.setNextFreeIndex(offset + rangeTriplets[i].getNextFreeIndex());
+            rangeTriplets[i].clear();
+            rangeTriplets[i].shrink_to_fit();
+            grad += rangeGrads[i];
+        }
+    }
+    leastSquareDerivativesReference(_associations->fittedStarList, tripletList, &grad);
+}
+
+ProblemSize FitterBase::computeProblemSize(std::string const &whatToFit) {
+    // The indices of whatToFit are only assigned to count the parameters, then those of the current setting
+    // are restored: as the layout of a whatToFit does not change, the state kept by minimize() stays valid.
+    std::string const previousWhatToFit = _whatToFit;
+    FlagGuard switching(_switchingIndices);
+    assignIndices(whatToFit);
+
+    DerivativesCount count;
+    for (auto const &ccdImage : _associations->getCcdImageList()) {
+        countDerivativesMeasurement(*ccdImage, count);
+    }
+    countDerivativesReference(count);
+
+    ProblemSize size;
+    size.nParameters = _nParTot;
+    // The FittedStar blocks are dense, and only coupled to each other through the model parameters.
+    std::size_t nStarPairs = 0;
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        std::size_t nPar = getNParFittedStar(*fittedStar);
+        size.nStarParameters += nPar;
+        nStarPairs += nPar * (nPar + 1) / 2;
+    }
+    std::size_t nModelParameters = size.nParameters - size.nStarParameters;
+    std::size_t nDenseModelPairs = nModelParameters * (nModelParameters + 1) / 2;
+    size.nJacobianColumns = count.nColumns;
+    size.nJacobianNonZeros = count.nNonZeros;
+    size.nHessianNonZeros =
+            nStarPairs + count.nStarModelPairs + std::min(count.nModelModelPairs, nDenseModelPairs);
+    // Eliminating the stars first fills at most the whole model block.
+    size.nFactorNonZeros = nStarPairs + count.nStarModelPairs + nDenseModelPairs;
+
+    LOGLS_DEBUG(_log, "Problem size for " << whatToFit << ": " << size.nParameters << " parameters, "
+                                          << size.nJacobianColumns << " Jacobian columns, "
+                                          << size.nJacobianNonZeros << " Jacobian non-zeros, "
+                                          << size.nHessianNonZeros << " Hessian non-zeros, "
+                                          << size.nFactorNonZeros << " factor non-zeros");
+    assignIndices(previousWhatToFit);
+    return size;
+}
+
+void FitterBase::leastSquareDerivatives(SparseMatrixD &hessian, Eigen::VectorXd &grad) {
+    JOINTCAL_TRACE_SPAN("assembleHessian");
+    auto start = std::chrono::steady_clock::now();
+    // Each chunk folds the Jacobian of one CcdImage at a time into the Hessian accumulator of its slot, and
+    // the slots are added in chunk order after each wave: the sums do not depend on the number of threads.
+    auto chunks = _getCcdImageChunks();
+    std::size_t const nSlots = std::min<std::size_t>(_nThreads, chunks.size());
+    _hessianAssembler.start(nSlots);
+    auto &slotGrads = _scratch.getGradients(nSlots, grad.size());
+    _streamDerivatives(chunks, &slotGrads,
+                       [this](std::size_t slot, std::size_t, TripletList const &jacobian) {
+                           _hessianAssembler.add(jacobian, slot);
+                       },
+                       [&](std::size_t nFilled) {
+                           foldGradients(slotGrads, nFilled, grad);
+                           _hessianAssembler.fold(nFilled);
+                       });
+    hessian = _hessianAssembler.finish();
+    _metrics.nHessianNonZeros = hessian.nonZeros();
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    LOGLS_DEBUG(_log, "Hessian assembled in " << elapsed.count() << " s");
+}
+
+void FitterBase::_computeGradient(Eigen::VectorXd &grad) const {
+    // summed as in leastSquareDerivatives(), so that a reused Hessian goes with the same gradient.
+    auto chunks = _getCcdImageChunks();
+    std::size_t const nSlots = std::min<std::size_t>(_nThreads, chunks.size());
+    auto &slotGrads = _scratch.getGradients(nSlots, grad.size());
+    _streamDerivatives(chunks, &slotGrads, [](std::size_t, std::size_t, TripletList const &) {},
+                       [&](std::size_t nFilled) { foldGradients(slotGrads, nFilled, grad); });
+}
+
+void FitterBase::_accumulateChi2List(Chi2List &chi2List, std::vector<std::size_t> &firstIndex) const {
+    auto ranges = _getCcdImageRanges();
+    firstIndex.assign(1, 0);
+    for (auto const &range : ranges) {
+        for (auto const &ccdImage : range) {
+            firstIndex.push_back(firstIndex.back() + ccdImage->getCatalogForFit().size());
+        }
+    }
+    std::size_t const nIndices = firstIndex.back() + _associations->fittedStarList.size();
+    if (nIndices > std::numeric_limits<std::uint32_t>::max()) {
+        throw LSST_EXCEPT(pex::exceptions::LengthError,
+                          "Too many measurements and FittedStars to index the chi2 contributions.");
+    }
+    std::vector<std::size_t> firstCcdImage(ranges.size() + 1, 0);
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        firstCcdImage[i + 1] = firstCcdImage[i] + ranges[i].size();
+    }
+
+    // the last one holds the reference terms.
+    auto &partials = _scratch.getPartialChi2Lists(ranges.size() + 1);
+    parallelFor(ranges.size() + 1, _nThreads, [&](std::size_t i) {
+        if (i == ranges.size()) {
+            partials[i].setIndexOffset(firstIndex.back());
+            accumulateStatRefStars(partials[i]);
+            return;
+        }
+        std::size_t ccdImageIndex = firstCcdImage[i];
+        for (auto const &ccdImage : ranges[i]) {
+            CcdImageList single(1, ccdImage);
+            partials[i].setIndexOffset(firstIndex[ccdImageIndex++]);
+            accumulateStatImageList(single, partials[i]);
+        }
+    });
+    for (auto const &partial : partials) chi2List.append(partial);
+}
+
+std::vector<CcdImageList> FitterBase::_getCcdImageRanges() const {
+    auto ccdImageList = _associations->getCcdImageList();
+    if (_nThreads <= 1 || ccdImageList.size() <= 1) {
+        return std::vector<CcdImageList>(1, ccdImageList);
+    }
+    return splitCcdImageList(ccdImageList, _nThreads);
+}
+
+std::vector<CcdImageList> FitterBase::_getCcdImageChunks() const {
+    auto ccdImageList = _associations->getCcdImageList();
+    std::size_t const nChunks = std::min(ccdImageList.size(), maxCcdImageChunks);
+    return splitCcdImageList(ccdImageList, std::max<std::size_t>(nChunks, 1));
+}
+
+void FitterBase::_streamDerivatives(std::vector<CcdImageList> const &ranges,
+                                    std::vector<Eigen::VectorXd> *grads, JacobianVisitor const &visit,
+                                    WaveFolder const &fold) const {
+    std::vector<std::size_t> firstCcdImage(ranges.size() + 1, 0);
+    for (std::size_t i = 0; i < ranges.size(); ++i) {
+        firstCcdImage[i + 1] = firstCcdImage[i] + ranges[i].size();
+    }
+    std::size_t const nSlots = fold ? std::min<std::size_t>(_nThreads, ranges.size()) : ranges.size();
+    // The Jacobian buffers keep their storage between passes.
+    auto &jacobians = _scratch.getJacobians(nSlots);
+    std::size_t nJacobianNonZeros = 0;
+    for (std::size_t first = 0; first < ranges.size(); first += nSlots) {
+        std::size_t const nWave = std::min(nSlots, ranges.size() - first);
+        std::vector<std::size_t> nTriplets(nWave, 0);
+        parallelFor(nWave, _nThreads, [&](std::size_t slot) {
+            TripletList &tripletList = jacobians[slot];
+            std::size_t ccdImageIndex = firstCcdImage[first + slot];
+            for (auto const &ccdImage : ranges[first + slot]) {
+                JOINTCAL_TRACE_SPAN_DETAIL("derivatives", ccdImage->getName());
+                tripletList.clear();
+                tripletList.setNextFreeIndex(0);
+                leastSquareDerivativesMeasurement(*ccdImage, tripletList,
+                                                  grads ? &(*grads)[slot] : nullptr);
+                nTriplets[slot] += tripletList.size();
+                visit(slot, ccdImageIndex++, tripletList);
+            }
+        });
+        nJacobianNonZeros = std::accumulate(nTriplets.begin(), nTriplets.end(), nJacobianNonZeros);
+
+        if (first + nWave == ranges.size()) {
+            // the reference terms close the last range.
+            TripletList &tripletList = jacobians[nWave - 1];
+            tripletList.clear();
+            tripletList.setNextFreeIndex(0);
+            leastSquareDerivativesReference(_associations->fittedStarList, tripletList,
+                                            grads ? &(*grads)[nWave - 1] : nullptr);
+            nJacobianNonZeros += tripletList.size();
+            visit(nWave - 1, firstCcdImage.back(), tripletList);
+        }
+        if (fold) fold(nWave);
+    }
+
+    _metrics.nTriplets += nJacobianNonZeros;
+    _metrics.nJacobianNonZeros = nJacobianNonZeros;
+}
+
+namespace {
+/// A well-mixed 64 bit value for i (splitmix64 finalizer), to build order-independent signatures.
+std::uint64_t mixBits(std::uint64_t i) {
+    i = (i ^ (i >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    i = (i ^ (i >> 27)) * 0x94d049bb133111ebULL;
+    return i ^ (i >> 31);
+}
+}  // namespace
+
+void FitterBase::_prepareConjugateGradient(Eigen::VectorXd &grad) {
+    auto ranges = _getCcdImageRanges();
+    auto &rangeGrads = _scratch.getGradients(ranges.size(), grad.size());
+
+    std::vector<std::vector<unsigned>> blocks;
+    std::vector<bool> inStarBlock(_nParTot, false);
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        unsigned nPar = getNParFittedStar(*fittedStar);
+        if (nPar == 0) continue;
+        blocks.emplace_back(nPar);
+        for (unsigned k = 0; k < nPar; ++k) {
+            blocks.back()[k] = fittedStar->getIndexInMatrix() + k;
+            inStarBlock[blocks.back()[k]] = true;
+        }
+    }
+
+    // First pass: the gradient, and a signature of the CcdImages whose Jacobian involves each parameter.
+    // The signatures are sums, so that the slots can be combined in any order.
+    std::size_t const nCcdImages = _associations->getCcdImageList().size();
+    std::vector<std::vector<std::uint64_t>> signatures(ranges.size(),
+                                                       std::vector<std::uint64_t>(_nParTot, 0));
+    _streamDerivatives(ranges, &rangeGrads,
+                       [&](std::size_t slot, std::size_t ccdImageIndex, TripletList const &jacobian) {
+                           if (ccdImageIndex == nCcdImages) return;  // reference terms only involve stars
+                           std::uint64_t const key = mixBits(ccdImageIndex + 1);
+                           for (auto const &trip : jacobian) signatures[slot][trip.row()] += key;
+                       });
+    for (auto const &rangeGrad : rangeGrads) grad += rangeGrad;
+
+    std::vector<std::pair<std::uint64_t, unsigned>> modelParameters;
+    for (unsigned i = 0; i < _nParTot; ++i) {
+        if (inStarBlock[i]) continue;
+        std::uint64_t signature = 0;
+        for (auto const &slotSignatures : signatures) signature += slotSignatures[i];
+        modelParameters.emplace_back(signature, i);
+    }
+    signatures.clear();
+    std::sort(modelParameters.begin(), modelParameters.end());
+    for (std::size_t k = 0; k < modelParameters.size(); ++k) {
+        // parameters that no measurement involves are left in blocks of their own.
+        std::uint64_t const signature = modelParameters[k].first;
+        if (k == 0 || signature == 0 || signature != modelParameters[k - 1].first) {
+            blocks.emplace_back();
+        }
+        blocks.back().push_back(modelParameters[k].second);
+    }
+    _preconditioner.setBlocks(_nParTot, blocks);
+
+    // Second pass: the diagonal blocks of the Hessian, without the gradient.
+    _preconditioner.start(ranges.size());
+    _streamDerivatives(ranges, nullptr,
+                       [this](std::size_t slot, std::size_t, TripletList const &jacobian) {
+                           _preconditioner.add(jacobian, slot);
+                       });
+    std::size_t nFallbacks = _preconditioner.finish();
+    LOGLS_DEBUG(_log, "Conjugate gradient preconditioner: " << _preconditioner.getNBlocks()
+                                                            << " blocks, largest has "
+                                                            << _preconditioner.getMaxBlockSize()
+                                                            << " parameters, " << nFallbacks
+                                                            << " not positive definite");
+}
+
+Eigen::VectorXd FitterBase::_multiplyHessian(std::vector<CcdImageList> const &ranges,
+                                             Eigen::VectorXd const &vector) const {
+    // H * v = sum over the Jacobian columns j of j * (j^T v); the gradient was computed once, by
+    // _prepareConjugateGradient().
+    auto &rangeProducts = _scratch.getProducts(ranges.size(), vector.size());
+    auto &projections = _scratch.getProjections(ranges.size());
+    _streamDerivatives(ranges, nullptr, [&](std::size_t slot, std::size_t, TripletList const &jacobian) {
+        auto &projection = projections[slot];
+        projection.assign(jacobian.getNextFreeIndex(), 0);
+        for (auto const &trip : jacobian) projection[trip.col()] += trip.value() * vector[trip.row()];
+        auto &product = rangeProducts[slot];
+        for (auto const &trip : jacobian) product[trip.row()] += trip.value() * projection[trip.col()];
+    });
+    for (std::size_t i = 1; i < ranges.size(); ++i) rangeProducts[0] += rangeProducts[i];
+    return rangeProducts[0];
+}
+
+bool FitterBase::_solveConjugateGradient(Eigen::VectorXd const &grad, Eigen::VectorXd &delta) const {
+    auto ranges = _getCcdImageRanges();
+    delta = Eigen::VectorXd::Zero(grad.size());
+    double const gradNorm = grad.norm();
+    if (gradNorm == 0) return true;
+
+    Eigen::VectorXd residual = grad;
+    Eigen::VectorXd direction = _preconditioner.apply(residual);
+    double rz = residual.dot(direction);
+    double relativeResidual = 1;
+    unsigned iteration = 0;
+    while (iteration < _conjugateGradientMaxIterations && relativeResidual > _conjugateGradientTolerance) {
+        Eigen::VectorXd product = _multiplyHessian(ranges, direction);
+        double curvature = direction.dot(product);
+        if (!std::isfinite(curvature)) {
+            LOGLS_ERROR(_log, "Conjugate gradient: non-finite Hessian product at iteration " << iteration);
+            return false;
+        }
+        // The Krylov space is exhausted: the current iterate is the solution.
+        if (curvature <= 0) break;
+        double alpha = rz / curvature;
+        delta += alpha * direction;
+        residual -= alpha * product;
+        ++iteration;
+        relativeResidual = residual.norm() / gradNorm;
+        Eigen::VectorXd z = _preconditioner.apply(residual);
+        double rzNew = residual.dot(z);
+        direction = z + (rzNew / rz) * direction;
+        rz = rzNew;
     }
-    leastSquareDerivativesReference(_associations->fittedStarList, tripletList, grad);
+    if (relativeResidual > _conjugateGradientTolerance) {
+        LOGLS_WARN(_log, "Conjugate gradient did not converge after " << iteration
+                                                                      << " iterations: relative residual "
+                                                                      << relativeResidual);
+    } else {
+        LOGLS_DEBUG(_log, "Conjugate gradient converged after " << iteration
+                                                                << " iterations: relative residual "
+                                                                << relativeResidual);
+    }
+    return true;
 }
 
 void FitterBase::saveChi2Contributions(std::string const &baseName) const {
@@ -333,7 +1187,311 @@ void FitterBase::saveChi2Contributions(std::string const &baseName) const {
     saveChi2RefContributions(refFilename);
 }
 
-double FitterBase::_lineSearch(Eigen::VectorXd const &delta) {
+bool FitterBase::_prepareSolver(SparseMatrixD const &hessian) {
+    std::vector<unsigned> candidates = getDenseBorderCandidates();
+    if (_solverMode == SolverMode::SchurComplement) {
+        JOINTCAL_TRACE_SPAN("schurComplement");
+        SparseMatrixD reduced;
+        if (!_schurComplement.compute(hessian, _nThreads, reduced)) {
+            LOGLS_ERROR(_log, "A FittedStar block of the Hessian is not positive definite.");
+            return false;
+        }
+        std::vector<unsigned> reducedCandidates;
+        for (unsigned i : candidates) {
+            int const reducedIndex = _schurComplement.getReducedIndex(i);
+            if (reducedIndex >= 0) reducedCandidates.push_back(reducedIndex);
+        }
+        return _factorizeSystem(reduced, reducedCandidates);
+    }
+    return _factorizeSystem(hessian, candidates);
+}
+
+bool FitterBase::_factorizeSystem(SparseMatrixD const &matrix, std::vector<unsigned> const &candidates) {
+    SparseMatrixD interior;
+    if (!_borderedSystem.split(matrix, candidates, interior)) {
+        if (_splitComponents && _nThreads > 1 && _components.find(matrix) > 1) {
+            // one part per thread: many tiny factorizations would cost more than a single one.
+            _components.merge(_nThreads);
+            return _factorizeComponents(matrix);
+        }
+        _components.clear();
+        _factorizeHessian(matrix);
+        return _cholesky.info() == Eigen::Success;
+    }
+    _components.clear();
+    LOGLS_DEBUG(_log, "Factorizing without " << _borderedSystem.getNBorder() << " dense parameters: dim="
+                                             << interior.rows() << " non-zeros=" << interior.nonZeros());
+    _factorizeHessian(interior);
+    if (_cholesky.info() != Eigen::Success) return false;
+    if (!_borderedSystem.reduce(_cholesky)) {
+        LOGLS_ERROR(_log, "The Hessian block of the dense parameters is not positive definite.");
+        return false;
+    }
+    return true;
+}
+
+bool FitterBase::_factorizeComponents(SparseMatrixD const &matrix) {
+    JOINTCAL_TRACE_SPAN("factorize");
+    std::size_t const nComponents = _components.getNComponents();
+    _componentCholesky.resize(nComponents);
+    for (auto &cholesky : _componentCholesky) {
+        if (!cholesky) cholesky.reset(new CholmodSimplicialLDLT2<SparseMatrixD>());
+        // setMode() discards the symbolic analysis, even if the mode is unchanged.
+        if (cholesky->getMode() != _cholesky.getMode()) cholesky->setMode(_cholesky.getMode());
+    }
+    auto start = std::chrono::steady_clock::now();
+    std::vector<char> success(nComponents, false);
+    parallelFor(nComponents, _nThreads, [&](std::size_t i) {
+        JOINTCAL_TRACE_SPAN("factorizeComponent");
+        SparseMatrixD block = _components.extract(matrix, i);
+        auto &cholesky = *_componentCholesky[i];
+        _applyOrdering(cholesky, _ordering, block.rows(), &_components.getComponent(i));
+        cholesky.computeReusingAnalysis(block);
+        success[i] = cholesky.info() == Eigen::Success;
+    });
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    double factorNonZeros = 0;
+    for (auto const &cholesky : _componentCholesky) {
+        factorNonZeros += cholesky->getFactorNonZeros();
+        _metrics.factorizationFlops += cholesky->getFactorizationFlops();
+    }
+    _metrics.nFactorNonZeros = factorNonZeros;
+    ++_metrics.nFactorizations;
+    LOGLS_DEBUG(_log, "Hessian factorized in " << elapsed.count() << " s, as " << nComponents
+                                               << " independent components: factor non-zeros="
+                                               << factorNonZeros);
+    return std::all_of(success.begin(), success.end(), [](char ok) { return ok; });
+}
+
+Eigen::VectorXd FitterBase::_solveSystem(Eigen::VectorXd const &rhs) const {
+    if (_borderedSystem.getNBorder() > 0) return _borderedSystem.solve(_cholesky, rhs);
+    if (_components.getNComponents() > 1) {
+        Eigen::VectorXd delta(rhs.size());
+        // each component sets its own entries of delta.
+        parallelFor(_components.getNComponents(), _nThreads, [&](std::size_t i) {
+            _components.scatter(_componentCholesky[i]->solve(_components.gather(rhs, i)), i, delta);
+        });
+        return delta;
+    }
+    return _cholesky.solve(rhs);
+}
+
+void FitterBase::_reportComponents(SparseMatrixD const &hessian) const {
+    HessianComponents components;
+    std::size_t const nComponents = components.find(hessian);
+    if (nComponents <= 1) return;
+    LOGLS_DEBUG(_log, "The Hessian has " << nComponents << " independent components");
+    // A component that fits stars and model parameters together is only anchored by reference stars.
+    std::vector<unsigned> nStarParameters(nComponents, 0);
+    std::vector<bool> hasReference(nComponents, false);
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        unsigned nPar = getNParFittedStar(*fittedStar);
+        if (nPar == 0) continue;
+        unsigned component = components.getComponentOf(fittedStar->getIndexInMatrix());
+        nStarParameters[component] += nPar;
+        if (fittedStar->getRefStar()) hasReference[component] = true;
+    }
+    std::size_t nDegenerate = 0;
+    std::size_t nDegenerateParameters = 0;
+    for (std::size_t i = 0; i < nComponents; ++i) {
+        std::size_t const size = components.getComponent(i).size();
+        if (nStarParameters[i] > 0 && nStarParameters[i] < size && !hasReference[i]) {
+            ++nDegenerate;
+            nDegenerateParameters += size;
+        }
+    }
+    if (nDegenerate > 0) {
+        LOGLS_WARN(_log, nDegenerate << " of " << nComponents << " independent components of the fit ("
+                                     << nDegenerateParameters << " parameters) have no reference star: "
+                                     << "their parameters are degenerate.");
+    }
+}
+
+bool FitterBase::_solve(Eigen::VectorXd const &grad, Eigen::VectorXd &delta) {
+    JOINTCAL_TRACE_SPAN("solve");
+    if (_solverMode == SolverMode::ConjugateGradient) {
+        return _solveConjugateGradient(grad, delta);
+    }
+    if (_solverMode == SolverMode::SchurComplement) {
+        Eigen::VectorXd reducedDelta = _solveSystem(_schurComplement.reduceGradient(grad));
+        delta = _schurComplement.backSubstitute(grad, reducedDelta);
+    } else {
+        delta = _solveSystem(grad);
+    }
+    return true;
+}
+
+MinimizeResult FitterBase::_dampedStep(SparseMatrixD const &hessian, Eigen::VectorXd const &grad,
+                                       Chi2Statistic &chi2) {
+    Eigen::VectorXd const diagonal = hessian.diagonal();
+    Eigen::VectorXd const start = getParameters();
+    for (unsigned trial = 0; trial < maxDampingTrials; ++trial) {
+        // The pattern is that of the Hessian with its full diagonal, the same for all the trials, so that
+        // they all reuse the symbolic analysis.
+        SparseMatrixD damped = hessian + SparseMatrixD((_damping * diagonal).asDiagonal());
+        Eigen::VectorXd delta;
+        if (!_prepareSolver(damped) || !_solve(grad, delta)) return MinimizeResult::Failed;
+        // The Gauss-Newton model of the chi2 is chi2 - 2*grad.delta + delta.H.delta, with
+        // (H + damping*D) delta = grad.
+        double const predicted = grad.dot(delta) + _damping * delta.dot(diagonal.cwiseProduct(delta));
+        offsetParams(delta);
+        Chi2Statistic trialChi2 = computeChi2();
+        double const actual = chi2.chi2 - trialChi2.chi2;
+        double const ratio = actual / predicted;
+        bool const accepted = std::isfinite(trialChi2.chi2) && actual > 0 && predicted > 0;
+        _dampingHistory.emplace_back(_damping, predicted, actual, accepted);
+        LOGLS_DEBUG(_log, "Damped step with damping " << _damping << ": chi2 reduction " << actual
+                                                      << " for " << predicted << " predicted"
+                                                      << (accepted ? "" : ", rejected"));
+        if (accepted) {
+            chi2 = trialChi2;
+            // Nielsen's update: decrease the damping more when the model predicted the reduction well.
+            _damping *= std::max(1. / 3., 1 - std::pow(2 * ratio - 1, 3));
+            _dampingIncrease = 2;
+            return MinimizeResult::Converged;
+        }
+        setParameters(start);  // exactly, even if the trial chi2 was not finite
+        _damping *= _dampingIncrease;
+        _dampingIncrease *= 2;
+    }
+    LOGLS_WARN(_log, "No damped step reduced the chi2 after " << maxDampingTrials << " trials.");
+    // the next minimize() starts again from the initial damping, not from the inflated one.
+    _damping = _initialDamping;
+    _dampingIncrease = 2;
+    return MinimizeResult::Chi2Increased;
+}
+
+void FitterBase::_factorizeHessian(SparseMatrixD const &hessian) {
+    JOINTCAL_TRACE_SPAN("factorize");
+    bool const orderingDowngraded = _applyOrdering(_cholesky, _ordering, hessian.rows());
+    _factorResidual = -1;
+    auto start = std::chrono::steady_clock::now();
+    bool reused = _cholesky.computeReusingAnalysis(hessian);
+    std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+    _metrics.nFactorNonZeros = _cholesky.getFactorNonZeros();
+    _metrics.factorizationFlops += _cholesky.getFactorizationFlops();
+    ++_metrics.nFactorizations;
+    LOGLS_DEBUG(_log, "Hessian factorized in " << elapsed.count() << " s, "
+                                               << (reused ? "reusing" : "recomputing")
+                                               << " the symbolic analysis: factor non-zeros="
+                                               << _cholesky.getFactorNonZeros()
+                                               << " flops=" << _cholesky.getFactorizationFlops());
+    if (!reused && _ordering == HessianOrdering::NestedDissection &&
+        _cholesky.getOrderingUsed() != CholmodOrdering::NestedDissection) {
+        LOGLS_WARN(_log, "Nested dissection ordering not available (cholmod built without METIS): used AMD.");
+    }
+    if (!reused && _cholesky.getModeUsed() != _cholesky.getMode()) {
+        LOGLS_WARN(_log, "Supernodal factorization not available (cholmod built with NSUPERNODAL): used the "
+                         "simplicial one.");
+    }
+    if (!reused && orderingDowngraded) {
+        LOGLS_WARN(_log, "The stars-first ordering does not apply to a system whose stars were eliminated by "
+                         "the Schur complement: used AMD.");
+    }
+}
+
+bool FitterBase::_applyOrdering(CholmodSimplicialLDLT2<SparseMatrixD> &cholesky, HessianOrdering ordering,
+                                Eigen::Index dim, std::vector<unsigned> const *component) const {
+    switch (ordering) {
+        case HessianOrdering::AMD:
+            cholesky.setOrdering(CholmodOrdering::AMD);
+            return false;
+        case HessianOrdering::NestedDissection:
+            cholesky.setOrdering(CholmodOrdering::NestedDissection);
+            return false;
+        case HessianOrdering::StarsFirst:
+            break;
+        default:
+            cholesky.setOrdering(CholmodOrdering::Default);
+            return false;
+    }
+    // The interior of a full Hessian whose dense border was split off is permuted as the full Hessian.
+    bool const bordered = _solverMode != SolverMode::SchurComplement && _borderedSystem.getNBorder() > 0 &&
+                          dim + _borderedSystem.getNBorder() == _nParTot;
+    if (component == nullptr && dim != static_cast<Eigen::Index>(_nParTot) && !bordered) {
+        // a reduced system: the stars are already eliminated.
+        cholesky.setOrdering(CholmodOrdering::AMD);
+        return true;
+    }
+    std::vector<bool> isStar(_nParTot, false);
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        unsigned nPar = getNParFittedStar(*fittedStar);
+        for (unsigned k = 0; k < nPar; ++k) isStar[fittedStar->getIndexInMatrix() + k] = true;
+    }
+    std::vector<int> permutation;
+    permutation.reserve(dim);
+    if (component != nullptr) {
+        // the parameters of a component are numbered in the order of their full Hessian indices.
+        for (std::size_t k = 0; k < component->size(); ++k) {
+            if (isStar[(*component)[k]]) permutation.push_back(k);
+        }
+        for (std::size_t k = 0; k < component->size(); ++k) {
+            if (!isStar[(*component)[k]]) permutation.push_back(k);
+        }
+    } else {
+        auto index = [this, bordered](unsigned i) {
+            return bordered ? _borderedSystem.getInteriorIndex(i) : static_cast<int>(i);
+        };
+        for (auto const &fittedStar : _associations->fittedStarList) {
+            unsigned nPar = getNParFittedStar(*fittedStar);
+            for (unsigned k = 0; k < nPar; ++k) {
+                int const i = index(fittedStar->getIndexInMatrix() + k);
+                if (i >= 0) permutation.push_back(i);
+            }
+        }
+        for (unsigned i = 0; i < _nParTot; ++i) {
+            if (!isStar[i] && index(i) >= 0) permutation.push_back(index(i));
+        }
+    }
+    cholesky.setOrdering(CholmodOrdering::Given);
+    cholesky.setPermutation(std::move(permutation));
+    return false;
+}
+
+std::vector<OrderingCost> FitterBase::compareOrderings(std::string const &whatToFit) {
+    bool const sameParameters = (whatToFit == _minimizedWhatToFit);
+    assignIndices(whatToFit);
+    if (!sameParameters || _nParTot != _hessianAssembler.getNParTot()) {
+        _hessianAssembler.reset(_nParTot);
+        // the next minimize() must start afresh, whatever its whatToFit.
+        _minimizedWhatToFit.clear();
+        _linearHessianValid = false;
+    }
+    SparseMatrixD hessian;
+    Eigen::VectorXd grad = Eigen::VectorXd::Zero(_nParTot);
+    leastSquareDerivatives(hessian, grad);
+
+    std::vector<OrderingCost> costs;
+    for (auto ordering : {HessianOrdering::Default, HessianOrdering::AMD, HessianOrdering::NestedDissection,
+                          HessianOrdering::StarsFirst}) {
+        CholmodSimplicialLDLT2<SparseMatrixD> cholesky;
+        cholesky.setMode(_cholesky.getMode());
+        _applyOrdering(cholesky, ordering, hessian.rows());
+        auto start = std::chrono::steady_clock::now();
+        cholesky.analyzePattern(hessian);
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        OrderingCost cost;
+        cost.ordering = ordering;
+        cost.available = cholesky.info() == Eigen::Success &&
+                         (ordering != HessianOrdering::NestedDissection ||
+                          cholesky.getOrderingUsed() == CholmodOrdering::NestedDissection);
+        cost.factorNonZeros = cholesky.getFactorNonZeros();
+        cost.factorizationFlops = cholesky.getFactorizationFlops();
+        cost.analysisSeconds = elapsed.count();
+        LOGLS_DEBUG(_log, orderingName(ordering) << " ordering" << (cost.available ? "" : " (unavailable)")
+                                      << ": factor non-zeros=" << cost.factorNonZeros
+                                      << " flops=" << cost.factorizationFlops << " analysis "
+                                      << cost.analysisSeconds << " s");
+        costs.push_back(cost);
+    }
+    return costs;
+}
+
+double FitterBase::_lineSearch(Eigen::VectorXd const &delta, Eigen::VectorXd const &grad) {
+    // Maximum relative deviation from the Gauss-Newton prediction of chi2(1) for which the chi2 is
+    // considered quadratic along delta.
+    double const maxNonLinearity = 1e-2;
     auto func = [this, &delta](double scale) {
         auto offset = scale * delta;
         offsetParams(offset);
@@ -342,6 +1500,27 @@ double FitterBase::_lineSearch(Eigen::VectorXd const &delta) {
         offsetParams(-offset);
         return chi2.chi2;
     };
+
+    // Along delta, the Gauss-Newton model of the chi2 is chi2(0) - 2*s*q + s^2*q, with q = grad.delta,
+    // i.e. its slope at 0 is -2*q and its minimum is at s=1.
+    double const q = grad.dot(delta);
+    if (q > 0) {
+        double const chi2Start = func(0);
+        double const chi2Full = func(1);
+        // parabola through chi2(0) and chi2(1) with the slope at 0.
+        double const curvature = chi2Full - chi2Start + 2 * q;
+        double const scale = q / curvature;
+        if (std::abs(chi2Full - (chi2Start - q)) <= maxNonLinearity * q) {
+            LOGLS_DEBUG(_log, "Line search scale factor (quadratic): " << scale);
+            return scale;
+        }
+        // Mildly non-linear: accept the minimum of the parabola if it improves on both ends.
+        if (curvature > 0 && scale >= -1 && scale <= 2 && func(scale) <= std::min(chi2Start, chi2Full)) {
+            LOGLS_DEBUG(_log, "Line search scale factor (parabolic): " << scale);
+            return scale;
+        }
+    }
+
     // The maximum theoretical precision is half the number of bits in the mantissa (see boost docs).
     auto bits = std::numeric_limits<double>::digits / 2;
     auto result = boost::math::tools::brent_find_minima(func, -1.0, 2.0, bits);
@@ -0,0 +1,152 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include "lsst/jointcal/FitterScratch.h"
+
+namespace lsst {
+namespace jointcal {
+
+std::vector<Eigen::VectorXd> &FitterScratch::getGradients(std::size_t nSlots, Eigen::Index nPar) {
+    _resize(_gradients, nSlots, nPar);
+    return _gradients;
+}
+
+std::vector<Eigen::VectorXd> &FitterScratch::getProducts(std::size_t nSlots, Eigen::Index nPar) {
+    _resize(_products, nSlots, nPar);
+    return _products;
+}
+
+std::vector<TripletList> &FitterScratch::getJacobians(std::size_t nSlots) {
+    _recordCapacities();
+    _jacobians.resize(nSlots, TripletList(0));
+    _recordCapacities();
+    return _jacobians;
+}
+
+std::vector<std::vector<double>> &FitterScratch::getProjections(std::size_t nSlots) {
+    _recordCapacities();
+    _projections.resize(nSlots);
+    _recordCapacities();
+    return _projections;
+}
+
+std::vector<Chi2List> &FitterScratch::getPartialChi2Lists(std::size_t nLists) {
+    _recordCapacities();
+    _partialChi2Lists.resize(nLists);
+    for (auto &chi2List : _partialChi2Lists) chi2List.reset();
+    _recordCapacities();
+    return _partialChi2Lists;
+}
+
+Chi2List &FitterScratch::getChi2List(std::size_t capacity) {
+    _recordCapacities();
+    _chi2List.reset();
+    _chi2List.reserve(capacity);
+    _recordCapacities();
+    return _chi2List;
+}
+
+Eigen::VectorXi &FitterScratch::getCounters(Eigen::Index nPar) {
+    if (_counters.size() != nPar) {
+        _counters.resize(nPar);
+        ++_nAllocations;
+    }
+    _counters.setZero();
+    return _counters;
+}
+
+void FitterScratch::resetNAllocations() {
+    _recordCapacities();
+    _nAllocations = 0;
+}
+
+std::size_t FitterScratch::getBytes() const {
+    std::size_t nBytes = _counters.size() * sizeof(int) + _chi2List.capacity() * sizeof(Chi2Record);
+    for (auto const &vector : _gradients) nBytes += vector.size() * sizeof(double);
+    for (auto const &vector : _products) nBytes += vector.size() * sizeof(double);
+    for (auto const &jacobian : _jacobians) nBytes += jacobian.capacity() * sizeof(Trip);
+    for (auto const &projection : _projections) nBytes += projection.capacity() * sizeof(double);
+    for (auto const &chi2List : _partialChi2Lists) nBytes += chi2List.capacity() * sizeof(Chi2Record);
+    return nBytes;
+}
+
+void FitterScratch::release() {
+    std::vector<Eigen::VectorXd>().swap(_gradients);
+    std::vector<Eigen::VectorXd>().swap(_products);
+    std::vector<TripletList>().swap(_jacobians);
+    std::vector<std::vector<double>>().swap(_projections);
+    std::vector<Chi2List>().swap(_partialChi2Lists);
+    Chi2List().swap(_chi2List);
+    _counters.resize(0);
+    _jacobianCapacities.clear();
+    _projectionCapacities.clear();
+    _partialChi2ListCapacities.clear();
+    _chi2ListCapacity = 0;
+}
+
+void FitterScratch::_resize(std::vector<Eigen::VectorXd> &vectors, std::size_t nSlots, Eigen::Index nPar) {
+    vectors.resize(nSlots);
+    for (auto &vector : vectors) {
+        if (vector.size() != nPar) {
+            vector.resize(nPar);
+            ++_nAllocations;
+        }
+        vector.setZero();
+    }
+}
+
+namespace {
+// The number of buffers that grew beyond the capacity recorded for their slot; new slots had none.
+template <typename Buffers>
+std::size_t countGrowth(Buffers const &buffers, std::vector<std::size_t> const &capacities) {
+    std::size_t nGrown = 0;
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        if (buffers[i].capacity() > (i < capacities.size() ? capacities[i] : 0)) ++nGrown;
+    }
+    return nGrown;
+}
+
+template <typename Buffers>
+void recordCapacities(Buffers const &buffers, std::vector<std::size_t> &capacities) {
+    capacities.resize(buffers.size());
+    for (std::size_t i = 0; i < buffers.size(); ++i) capacities[i] = buffers[i].capacity();
+}
+}  // namespace
+
+std::size_t FitterScratch::_countGrowth() const {
+    return countGrowth(_jacobians, _jacobianCapacities) + countGrowth(_projections, _projectionCapacities) +
+           countGrowth(_partialChi2Lists, _partialChi2ListCapacities) +
+           (_chi2List.capacity() > _chi2ListCapacity ? 1 : 0);
+}
+
+void FitterScratch::_recordCapacities() {
+    _nAllocations += _countGrowth();
+    recordCapacities(_jacobians, _jacobianCapacities);
+    recordCapacities(_projections, _projectionCapacities);
+    recordCapacities(_partialChi2Lists, _partialChi2ListCapacities);
+    _chi2ListCapacity = _chi2List.capacity();
+}
+
+}  // namespace jointcal
+}  // namespace lsst
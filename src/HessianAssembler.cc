@@ -0,0 +1,211 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include "lsst/jointcal/HessianAssembler.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+// Minimum number of buffered triplets before they get folded into the partial matrix.
+std::size_t const minBufferSize = 1 << 20;
+}  // namespace
+
+void HessianAssembler::reset(unsigned nParTot) {
+    _nParTot = nParTot;
+    _outerIndex.clear();
+    _outerIndex.shrink_to_fit();
+    _innerIndex.clear();
+    _innerIndex.shrink_to_fit();
+}
+
+void HessianAssembler::start(std::size_t nSlots) {
+    if (_slots.size() < nSlots) {
+        _nAllocations += nSlots - _slots.size();
+        _slots.resize(nSlots);
+    }
+    for (std::size_t i = 0; i < nSlots; ++i) _clear(_slots[i]);
+    _totalOnPattern = hasPattern();
+    if (_totalOnPattern) {
+        _assignZeros(_totalValues, _innerIndex.size());
+    } else {
+        _total = SparseMatrixD(_nParTot, _nParTot);
+    }
+}
+
+void HessianAssembler::add(TripletList const &tripletList, std::size_t slotIndex) {
+    Slot &slot = _slots[slotIndex];
+    slot.used = true;
+    std::size_t nColumns = tripletList.getNextFreeIndex();
+
+    // counting sort of the (row, value) pairs by Jacobian column.
+    slot.columnStart.assign(nColumns + 1, 0);
+    for (auto const &trip : tripletList) slot.columnStart[trip.col() + 1]++;
+    for (std::size_t k = 0; k < nColumns; ++k) slot.columnStart[k + 1] += slot.columnStart[k];
+    slot.entries.resize(tripletList.size());
+    for (auto const &trip : tripletList) {
+        slot.entries[slot.columnStart[trip.col()]++] = std::make_pair(trip.row(), trip.value());
+    }
+    // the loop above shifted the start of each column to the start of the next one.
+    for (std::size_t k = nColumns; k > 0; --k) slot.columnStart[k] = slot.columnStart[k - 1];
+    slot.columnStart[0] = 0;
+
+    for (std::size_t k = 0; k < nColumns; ++k) {
+        auto begin = slot.entries.begin() + slot.columnStart[k];
+        auto end = slot.entries.begin() + slot.columnStart[k + 1];
+        std::sort(begin, end);
+        // each pair (a, b) with row(a) >= row(b) contributes to H(row(a), row(b)).
+        for (auto b = begin; b != end; ++b) {
+            StorageIndex const col = b->first;
+            auto patternBegin = _innerIndex.begin();
+            auto pos = patternBegin;
+            auto last = patternBegin;
+            if (slot.usePattern) {
+                pos = patternBegin + _outerIndex[col];
+                last = patternBegin + _outerIndex[col + 1];
+            }
+            for (auto a = b; a != end; ++a) {
+                double value = a->second * b->second;
+                // a repeated row shows up in both orders on the diagonal.
+                if (a != b && a->first == b->first) value *= 2;
+                if (slot.usePattern) {
+                    pos = std::lower_bound(pos, last, a->first);
+                    if (pos != last && *pos == a->first) {
+                        slot.values[pos - patternBegin] += value;
+                        continue;
+                    }
+                    _leavePattern(slot);
+                }
+                slot.buffer.emplace_back(a->first, col, value);
+            }
+        }
+        if (!slot.usePattern &&
+            slot.buffer.size() >= std::max<std::size_t>(minBufferSize, slot.partial.nonZeros())) {
+            _compress(slot);
+        }
+    }
+}
+
+void HessianAssembler::fold(std::size_t nSlots) {
+    for (std::size_t i = 0; i < nSlots; ++i) {
+        Slot &slot = _slots[i];
+        if (!slot.used) continue;
+        if (_totalOnPattern && slot.usePattern) {
+            Eigen::Map<Eigen::VectorXd>(_totalValues.data(), _totalValues.size()) +=
+                    Eigen::Map<Eigen::VectorXd const>(slot.values.data(), slot.values.size());
+        } else {
+            if (_totalOnPattern) {
+                _total = Eigen::Map<SparseMatrixD const>(_nParTot, _nParTot, _innerIndex.size(),
+                                                         _outerIndex.data(), _innerIndex.data(),
+                                                         _totalValues.data());
+                _totalOnPattern = false;
+            }
+            if (slot.usePattern) {
+                _total += Eigen::Map<SparseMatrixD const>(_nParTot, _nParTot, _innerIndex.size(),
+                                                          _outerIndex.data(), _innerIndex.data(),
+                                                          slot.values.data());
+            } else {
+                _compress(slot);
+                _total += slot.partial;
+            }
+        }
+        _clear(slot);
+    }
+}
+
+SparseMatrixD HessianAssembler::finish() {
+    fold(_slots.size());
+    if (_totalOnPattern) {
+        return Eigen::Map<SparseMatrixD const>(_nParTot, _nParTot, _innerIndex.size(), _outerIndex.data(),
+                                               _innerIndex.data(), _totalValues.data());
+    }
+    SparseMatrixD hessian;
+    hessian.swap(_total);
+    hessian.makeCompressed();
+    _outerIndex.assign(hessian.outerIndexPtr(), hessian.outerIndexPtr() + _nParTot + 1);
+    _innerIndex.assign(hessian.innerIndexPtr(), hessian.innerIndexPtr() + hessian.nonZeros());
+    return hessian;
+}
+
+std::size_t HessianAssembler::getBytes() const {
+    std::size_t nBytes = _totalValues.capacity() * sizeof(double);
+    for (auto const &slot : _slots) {
+        nBytes += slot.values.capacity() * sizeof(double) + slot.buffer.capacity() * sizeof(Trip) +
+                  slot.columnStart.capacity() * sizeof(std::size_t) +
+                  slot.entries.capacity() * sizeof(std::pair<StorageIndex, double>) +
+                  slot.partial.data().allocatedSize() * (sizeof(double) + sizeof(StorageIndex));
+    }
+    return nBytes;
+}
+
+void HessianAssembler::release() {
+    std::vector<Slot>().swap(_slots);
+    std::vector<double>().swap(_totalValues);
+    _total = SparseMatrixD();
+}
+
+void HessianAssembler::_clear(Slot &slot) {
+    // an unused slot is already empty, unless the pattern or the dimension changed since.
+    bool const usePattern = hasPattern();
+    if (!slot.used && slot.usePattern == usePattern &&
+        (usePattern ? slot.values.size() == _innerIndex.size() : slot.partial.rows() == _nParTot)) {
+        return;
+    }
+    slot.used = false;
+    slot.usePattern = usePattern;
+    if (usePattern) _assignZeros(slot.values, _innerIndex.size());
+    slot.buffer.clear();
+    slot.partial.resize(_nParTot, _nParTot);
+    std::size_t const capacity =
+            slot.buffer.capacity() + slot.columnStart.capacity() + slot.entries.capacity();
+    if (capacity > slot.capacity) ++_nAllocations;
+    slot.capacity = capacity;
+}
+
+void HessianAssembler::_assignZeros(std::vector<double> &values, std::size_t size) {
+    if (values.capacity() < size) ++_nAllocations;
+    values.assign(size, 0.0);
+}
+
+void HessianAssembler::_leavePattern(Slot &slot) const {
+    for (unsigned col = 0; col < _nParTot; ++col) {
+        for (StorageIndex k = _outerIndex[col]; k < _outerIndex[col + 1]; ++k) {
+            if (slot.values[k] != 0) slot.buffer.emplace_back(_innerIndex[k], col, slot.values[k]);
+        }
+    }
+    slot.usePattern = false;
+}
+
+void HessianAssembler::_compress(Slot &slot) const {
+    if (slot.buffer.empty()) return;
+    SparseMatrixD block(_nParTot, _nParTot);
+    block.setFromTriplets(slot.buffer.begin(), slot.buffer.end());
+    slot.partial += block;
+    slot.buffer.clear();
+}
+
+}  // namespace jointcal
+}  // namespace lsst
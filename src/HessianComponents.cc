@@ -0,0 +1,160 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <numeric>
+
+#include "lsst/jointcal/HessianComponents.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+/// Root of the tree of index in a union-find forest, compressing the path to it.
+unsigned findRoot(std::vector<unsigned> &parent, unsigned index) {
+    unsigned root = index;
+    while (parent[root] != root) root = parent[root];
+    while (parent[index] != root) {
+        unsigned next = parent[index];
+        parent[index] = root;
+        index = next;
+    }
+    return root;
+}
+}  // namespace
+
+std::size_t HessianComponents::find(SparseMatrixD const &matrix) {
+    _dim = matrix.cols();
+    std::vector<unsigned> parent(_dim);
+    std::iota(parent.begin(), parent.end(), 0);
+    for (Eigen::Index j = 0; j < _dim; ++j) {
+        for (SparseMatrixD::InnerIterator it(matrix, j); it; ++it) {
+            if (it.row() == j) continue;
+            unsigned const a = findRoot(parent, j);
+            unsigned const b = findRoot(parent, it.row());
+            // the smallest index is the root, so that the components come out sorted.
+            if (a < b) {
+                parent[b] = a;
+            } else if (b < a) {
+                parent[a] = b;
+            }
+        }
+    }
+    _components.clear();
+    _nonZeros.clear();
+    _label.assign(_dim, 0);
+    _localIndex.assign(_dim, 0);
+    for (Eigen::Index j = 0; j < _dim; ++j) {
+        unsigned const root = findRoot(parent, j);
+        if (root == static_cast<unsigned>(j)) {
+            _label[j] = _components.size();
+            _components.emplace_back();
+            _nonZeros.push_back(0);
+        } else {
+            _label[j] = _label[root];
+        }
+        auto &component = _components[_label[j]];
+        _localIndex[j] = component.size();
+        component.push_back(j);
+        _nonZeros[_label[j]] += matrix.col(j).nonZeros();
+    }
+    return _components.size();
+}
+
+void HessianComponents::merge(std::size_t maxParts) {
+    maxParts = std::max<std::size_t>(maxParts, 1);
+    if (_components.size() <= maxParts) return;
+    // Largest first, each into the lightest part.
+    std::vector<std::size_t> order(_components.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(),
+                     [this](std::size_t a, std::size_t b) { return _nonZeros[a] > _nonZeros[b]; });
+    std::vector<std::vector<unsigned>> parts(maxParts);
+    std::vector<std::size_t> partNonZeros(maxParts, 0);
+    for (std::size_t i : order) {
+        std::size_t const part =
+                std::min_element(partNonZeros.begin(), partNonZeros.end()) - partNonZeros.begin();
+        parts[part].insert(parts[part].end(), _components[i].begin(), _components[i].end());
+        partNonZeros[part] += _nonZeros[i];
+    }
+    for (auto &part : parts) std::sort(part.begin(), part.end());
+    // keep the parts sorted by their first parameter.
+    std::vector<std::size_t> partOrder(maxParts);
+    std::iota(partOrder.begin(), partOrder.end(), 0);
+    std::sort(partOrder.begin(), partOrder.end(),
+              [&parts](std::size_t a, std::size_t b) { return parts[a].front() < parts[b].front(); });
+    _components.clear();
+    _nonZeros.clear();
+    for (std::size_t part : partOrder) {
+        _components.push_back(std::move(parts[part]));
+        _nonZeros.push_back(partNonZeros[part]);
+    }
+    for (std::size_t i = 0; i < _components.size(); ++i) {
+        for (std::size_t k = 0; k < _components[i].size(); ++k) {
+            _label[_components[i][k]] = i;
+            _localIndex[_components[i][k]] = k;
+        }
+    }
+}
+
+void HessianComponents::clear() {
+    _dim = 0;
+    _label.clear();
+    _localIndex.clear();
+    _components.clear();
+    _nonZeros.clear();
+}
+
+SparseMatrixD HessianComponents::extract(SparseMatrixD const &matrix, std::size_t i) const {
+    auto const &component = _components[i];
+    // The local indices preserve the order of the parameters, so the columns and their rows come out
+    // sorted and can be appended directly; all the entries of a column belong to its component.
+    SparseMatrixD block(component.size(), component.size());
+    std::size_t nonZeros = 0;
+    for (unsigned j : component) nonZeros += matrix.col(j).nonZeros();
+    block.reserve(nonZeros);
+    for (unsigned j : component) {
+        block.startVec(_localIndex[j]);
+        for (SparseMatrixD::InnerIterator it(matrix, j); it; ++it) {
+            block.insertBack(_localIndex[it.row()], _localIndex[j]) = it.value();
+        }
+    }
+    block.finalize();
+    return block;
+}
+
+Eigen::VectorXd HessianComponents::gather(Eigen::VectorXd const &full, std::size_t i) const {
+    auto const &component = _components[i];
+    Eigen::VectorXd part(component.size());
+    for (std::size_t k = 0; k < component.size(); ++k) part(k) = full(component[k]);
+    return part;
+}
+
+void HessianComponents::scatter(Eigen::VectorXd const &part, std::size_t i, Eigen::VectorXd &full) const {
+    auto const &component = _components[i];
+    for (std::size_t k = 0; k < component.size(); ++k) full(component[k]) = part(k);
+}
+}  // namespace jointcal
+}  // namespace lsst
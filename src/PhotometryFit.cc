@@ -43,7 +43,7 @@ namespace lsst {
 namespace jointcal {
 
 void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage, TripletList &tripletList,
-                                                      Eigen::VectorXd &grad,
+                                                      Eigen::VectorXd *grad,
                                                       MeasuredStarList const *measuredStarList) const {
     /**********************************************************************/
     /* @note the math in this method and accumulateStatImageList() must be kept consistent,
@@ -70,8 +70,10 @@ void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
         if (!measuredStar->isValid()) continue;
         H.setZero();  // we cannot be sure that all entries will be overwritten.
 
-        double residual = _photometryModel->computeResidual(ccdImage, *measuredStar);
-        double inverseSigma = 1.0 / _photometryModel->transformError(ccdImage, *measuredStar);
+        // the residual is only needed by the gradient.
+        double residual = grad ? _photometryModel->computeResidual(ccdImage, *measuredStar) : 0;
+        double inverseSigma = std::sqrt(measuredStar->getRobustWeight()) /
+                              _photometryModel->transformError(ccdImage, *measuredStar);
         double W = std::pow(inverseSigma, 2);
 
         if (_fittingModel) {
@@ -79,14 +81,14 @@ void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
             for (unsigned k = 0; k < indices.size(); k++) {
                 unsigned l = indices[k];
                 tripletList.addTriplet(l, kTriplets, H[k] * inverseSigma);
-                grad[l] += H[k] * W * residual;
+                if (grad) (*grad)[l] += H[k] * W * residual;
             }
         }
         if (_fittingFluxes) {
             unsigned index = measuredStar->getFittedStar()->getIndexInMatrix();
             // Note: H = dR/dFittedStarFlux == -1
             tripletList.addTriplet(index, kTriplets, -1.0 * inverseSigma);
-            grad[index] += -1.0 * W * residual;
+            if (grad) (*grad)[index] += -1.0 * W * residual;
         }
         kTriplets += 1;  // each measurement contributes 1 column in the Jacobian
     }
@@ -95,7 +97,7 @@ void PhotometryFit::leastSquareDerivativesMeasurement(CcdImage const &ccdImage,
 }
 
 void PhotometryFit::leastSquareDerivativesReference(FittedStarList const &fittedStarList,
-                                                    TripletList &tripletList, Eigen::VectorXd &grad) const {
+                                                    TripletList &tripletList, Eigen::VectorXd *grad) const {
     /**********************************************************************/
     /** @note the math in this method and accumulateStatReference() must be kept consistent,
      * in terms of +/- convention, definition of model, etc. */
@@ -118,14 +120,15 @@ void PhotometryFit::leastSquareDerivativesReference(FittedStarList const &fitted
 
         // W == inverseSigma^2
 
-        double inverseSigma = 1.0 / _photometryModel->getRefError(*refStar);
+        double inverseSigma =
+                std::sqrt(fittedStar->getRobustWeight()) / _photometryModel->getRefError(*refStar);
         // Residual is fittedStar - refStar for consistency with measurement terms.
         double residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
 
         unsigned index = fittedStar->getIndexInMatrix();
         // Note: H = dR/dFittedStar == 1
         tripletList.addTriplet(index, kTriplets, 1.0 * inverseSigma);
-        grad(index) += 1.0 * std::pow(inverseSigma, 2) * residual;
+        if (grad) (*grad)(index) += 1.0 * std::pow(inverseSigma, 2) * residual;
         kTriplets += 1;
     }
     tripletList.setNextFreeIndex(kTriplets);
@@ -139,13 +142,15 @@ void PhotometryFit::accumulateStatImageList(CcdImageList const &ccdImageList, Ch
     for (auto const &ccdImage : ccdImageList) {
         auto &catalog = ccdImage->getCatalogForFit();
 
+        std::size_t position = 0;
         for (auto const &measuredStar : catalog) {
+            std::size_t const index = position++;
             if (!measuredStar->isValid()) continue;
             double sigma = _photometryModel->transformError(*ccdImage, *measuredStar);
             double residual = _photometryModel->computeResidual(*ccdImage, *measuredStar);
 
             double chi2Val = std::pow(residual / sigma, 2);
-            accum.addEntry(chi2Val, 1, measuredStar);
+            accum.addEntry(chi2Val, 1, index);
         }  // end loop on measurements
     }
 }
@@ -157,16 +162,52 @@ void PhotometryFit::accumulateStatRefStars(Chi2Accumulator &accum) const {
     /**********************************************************************/
 
     FittedStarList &fittedStarList = _associations->fittedStarList;
+    std::size_t position = 0;
     for (auto const &fittedStar : fittedStarList) {
+        std::size_t const index = position++;
         auto refStar = fittedStar->getRefStar();
         if (refStar == nullptr) continue;
         double sigma = _photometryModel->getRefError(*refStar);
         double residual = _photometryModel->computeRefResidual(*fittedStar, *refStar);
         double chi2 = std::pow(residual / sigma, 2);
-        accum.addEntry(chi2, 1, fittedStar);
+        accum.addEntry(chi2, 1, index);
     }
 }
 
+bool PhotometryFit::isLinear() const {
+    // The residuals are always linear in the FittedStar fluxes or magnitudes.
+    return !_fittingModel || _photometryModel->isLinear();
+}
+
+void PhotometryFit::countDerivativesMeasurement(CcdImage const &ccdImage, DerivativesCount &count) const {
+    // must match leastSquareDerivativesMeasurement()
+    unsigned nParModel = (_fittingModel) ? _photometryModel->getNpar(ccdImage) : 0;
+    unsigned nParFlux = (_fittingFluxes) ? 1 : 0;
+    std::size_t nValid = 0;
+    for (auto const &measuredStar : ccdImage.getCatalogForFit()) {
+        if (measuredStar->isValid()) ++nValid;
+    }
+    count.nColumns += nValid;
+    count.nNonZeros += nValid * (nParModel + nParFlux);
+    count.nStarModelPairs += nValid * nParFlux * nParModel;
+    if (nValid > 0) count.nModelModelPairs += nParModel * (nParModel + 1) / 2;
+}
+
+void PhotometryFit::countDerivativesReference(DerivativesCount &count) const {
+    // must match leastSquareDerivativesReference()
+    if (!_fittingFluxes || _associations->refStarList.size() == 0) return;
+    for (auto const &fittedStar : _associations->fittedStarList) {
+        if (fittedStar->getRefStar() == nullptr) continue;
+        count.nColumns += 1;
+        count.nNonZeros += 1;
+    }
+}
+
+unsigned PhotometryFit::getNParFittedStar(FittedStar const &fittedStar) const {
+    // must match the layout in assignIndices()
+    return (_fittingFluxes) ? 1 : 0;
+}
+
 //! this routine is to be used only in the framework of outlier removal
 /*! it fills the array of indices of parameters that a Measured star
     constrains. Not really all of them if you check. */
@@ -183,9 +224,19 @@ void PhotometryFit::getIndicesOfMeasuredStar(MeasuredStar const &measuredStar,
     }
 }
 
+void PhotometryFit::splitWhatToFit(std::string const &whatToFit, std::string &starWhatToFit,
+                                   std::string &modelWhatToFit) const {
+    _splitWords(whatToFit, {"Fluxes"}, starWhatToFit, modelWhatToFit);
+}
+
 void PhotometryFit::assignIndices(std::string const &whatToFit) {
     _whatToFit = whatToFit;
-    LOGLS_INFO(_log, "assignIndices: now fitting: " << whatToFit);
+    // minimizeAlternating() and computeProblemSize() switch back and forth between settings quietly.
+    if (_switchingIndices) {
+        LOGLS_DEBUG(_log, "assignIndices: now fitting: " << whatToFit);
+    } else {
+        LOGLS_INFO(_log, "assignIndices: now fitting: " << whatToFit);
+    }
     _fittingModel = (_whatToFit.find("Model") != std::string::npos);
     _fittingFluxes = (_whatToFit.find("Fluxes") != std::string::npos);
     // When entering here, we assume that whatToFit has already been interpreted.
@@ -227,6 +278,33 @@ void PhotometryFit::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+Eigen::VectorXd PhotometryFit::getParameters() const {
+    Eigen::VectorXd parameters(_nParTot);
+    if (_fittingModel) _photometryModel->getParameters(parameters);
+
+    if (_fittingFluxes) {
+        for (auto const &fittedStar : _associations->fittedStarList) {
+            // same layout as offsetParams()
+            parameters(fittedStar->getIndexInMatrix()) = _photometryModel->getFittedStarValue(*fittedStar);
+        }
+    }
+    return parameters;
+}
+
+void PhotometryFit::setParameters(Eigen::VectorXd const &parameters) {
+    if (parameters.size() != _nParTot)
+        throw LSST_EXCEPT(pex::exceptions::InvalidParameterError,
+                          "PhotometryFit::setParameters : the provided vector length is not compatible with "
+                          "the current whatToFit setting");
+    if (_fittingModel) _photometryModel->setParameters(parameters);
+
+    if (_fittingFluxes) {
+        for (auto &fittedStar : _associations->fittedStarList) {
+            _photometryModel->setFittedStarValue(*fittedStar, parameters(fittedStar->getIndexInMatrix()));
+        }
+    }
+}
+
 void PhotometryFit::saveChi2MeasContributions(std::string const &filename) const {
     std::ofstream ofile(filename.c_str());
     std::string separator = "\t";
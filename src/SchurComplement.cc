@@ -0,0 +1,248 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <atomic>
+
+#include "Eigen/Cholesky"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/jointcal/Parallel.h"
+#include "lsst/jointcal/SchurComplement.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+// One (model parameter, row in the block, value) entry of H_MS, before grouping.
+struct RawCoupling {
+    unsigned index;
+    unsigned row;
+    double value;
+    bool operator<(RawCoupling const &other) const {
+        return (index < other.index) || (index == other.index && row < other.row);
+    }
+};
+
+/// Split [0, n) into at most nRanges contiguous ranges of similar sizes.
+std::vector<std::pair<std::size_t, std::size_t>> splitRange(std::size_t n, std::size_t nRanges) {
+    nRanges = std::max<std::size_t>(1, std::min(n, nRanges));
+    std::vector<std::pair<std::size_t, std::size_t>> ranges;
+    for (std::size_t i = 0; i < nRanges; ++i) ranges.emplace_back(n * i / nRanges, n * (i + 1) / nRanges);
+    return ranges;
+}
+}  // namespace
+
+void SchurComplement::setBlocks(unsigned nParTot, std::vector<std::pair<unsigned, unsigned>> const &blocks) {
+    bool const sameLayout = (nParTot == _nParTot && blocks == _layout);
+    _nParTot = nParTot;
+    _layout = blocks;
+    _paramBlock.assign(nParTot, -1);
+    _blocks.clear();
+    _blocks.reserve(blocks.size());
+    for (auto const &block : blocks) {
+        for (unsigned k = block.first; k < block.first + block.second; ++k) _paramBlock[k] = _blocks.size();
+        _blocks.push_back(Block{block.first, block.second, false, 0, 0, 0, 0});
+    }
+    _reducedIndex.assign(nParTot, 0);
+    _nParReduced = 0;
+    for (unsigned k = 0; k < nParTot; ++k) {
+        if (_paramBlock[k] < 0) _reducedIndex[k] = _nParReduced++;
+    }
+    if (!sameLayout || _reductionAssembler.getNParTot() != _nParReduced) {
+        _reductionAssembler.reset(_nParReduced);
+    }
+}
+
+bool SchurComplement::compute(SparseMatrixD const &hessian, unsigned nThreads, SparseMatrixD &reduced) {
+    using StorageIndex = SparseMatrixD::StorageIndex;
+    std::size_t const nBlocks = _blocks.size();
+
+    // First pass: count the H_MS entries of each block, and size the diagonal blocks.
+    std::vector<std::size_t> rawStart(nBlocks + 1, 0);
+    std::size_t nFactors = 0;
+    for (auto &block : _blocks) {
+        block.factorOffset = nFactors;
+        nFactors += block.size * block.size;
+    }
+    for (unsigned col = 0; col < _nParTot; ++col) {
+        for (SparseMatrixD::InnerIterator it(hessian, col); it; ++it) {
+            int rowBlock = _paramBlock[it.row()];
+            int colBlock = _paramBlock[col];
+            if (rowBlock >= 0 && colBlock < 0) rawStart[rowBlock + 1]++;
+            if (rowBlock < 0 && colBlock >= 0) rawStart[colBlock + 1]++;
+        }
+    }
+    for (std::size_t b = 0; b < nBlocks; ++b) rawStart[b + 1] += rawStart[b];
+
+    // Second pass: sort the entries of hessian into H_MM (in CSC form), H_SS and H_MS.
+    _factors.assign(nFactors, 0.0);
+    std::vector<RawCoupling> raw(rawStart[nBlocks]);
+    std::vector<std::size_t> rawEnd(rawStart.begin(), rawStart.end() - 1);
+    std::vector<StorageIndex> outerIndex(_nParReduced + 1, 0);
+    std::vector<StorageIndex> innerIndex;
+    std::vector<double> values;
+    for (unsigned col = 0; col < _nParTot; ++col) {
+        int colBlock = _paramBlock[col];
+        for (SparseMatrixD::InnerIterator it(hessian, col); it; ++it) {
+            unsigned row = it.row();
+            int rowBlock = _paramBlock[row];
+            if (rowBlock < 0 && colBlock < 0) {
+                innerIndex.push_back(_reducedIndex[row]);
+                values.push_back(it.value());
+            } else if (rowBlock < 0) {
+                unsigned blockRow = col - _blocks[colBlock].first;
+                raw[rawEnd[colBlock]++] = RawCoupling{_reducedIndex[row], blockRow, it.value()};
+            } else if (colBlock < 0) {
+                unsigned blockRow = row - _blocks[rowBlock].first;
+                raw[rawEnd[rowBlock]++] = RawCoupling{_reducedIndex[col], blockRow, it.value()};
+            } else if (rowBlock == colBlock) {
+                Block const &block = _blocks[rowBlock];
+                Eigen::Map<Eigen::MatrixXd> diagonal(&_factors[block.factorOffset], block.size, block.size);
+                diagonal(row - block.first, col - block.first) = it.value();
+                diagonal(col - block.first, row - block.first) = it.value();
+            } else if (it.value() != 0) {
+                throw LSST_EXCEPT(pex::exceptions::LogicError,
+                                  "SchurComplement: the Hessian couples parameters " + std::to_string(row) +
+                                          " and " + std::to_string(col) + " of two different blocks.");
+            }
+        }
+        if (colBlock < 0) outerIndex[_reducedIndex[col] + 1] = innerIndex.size();
+    }
+    SparseMatrixD modelHessian = Eigen::Map<SparseMatrixD const>(_nParReduced, _nParReduced, values.size(),
+                                                                 outerIndex.data(), innerIndex.data(),
+                                                                 values.data());
+
+    // Group the couplings of each block by model parameter.
+    auto ranges = splitRange(nBlocks, nThreads);
+    parallelFor(ranges.size(), nThreads, [&](std::size_t i) {
+        for (std::size_t b = ranges[i].first; b < ranges[i].second; ++b) {
+            std::sort(raw.begin() + rawStart[b], raw.begin() + rawStart[b + 1]);
+            std::size_t nCoupled = 0;
+            for (std::size_t k = rawStart[b]; k < rawStart[b + 1]; ++k) {
+                if (k == rawStart[b] || raw[k].index != raw[k - 1].index) nCoupled++;
+            }
+            _blocks[b].nCoupled = nCoupled;
+        }
+    });
+    std::size_t nCoupledTotal = 0;
+    std::size_t nValuesTotal = 0;
+    for (auto &block : _blocks) {
+        block.couplingStart = nCoupledTotal;
+        block.valueStart = nValuesTotal;
+        nCoupledTotal += block.nCoupled;
+        nValuesTotal += block.nCoupled * block.size;
+    }
+    _coupledIndices.assign(nCoupledTotal, 0);
+    _couplings.assign(nValuesTotal, 0.0);
+
+    // Factor each diagonal block and accumulate H_MS H_SS^-1 H_SM = (H_MS L^-T) (H_MS L^-T)^T.
+    std::atomic<bool> success(true);
+    _reductionAssembler.start(ranges.size());
+    parallelFor(ranges.size(), nThreads, [&](std::size_t i) {
+        TripletList tripletList(0);
+        for (std::size_t b = ranges[i].first; b < ranges[i].second; ++b) {
+            Block &block = _blocks[b];
+            Eigen::Map<Eigen::MatrixXd> factor(&_factors[block.factorOffset], block.size, block.size);
+            block.active = !factor.isZero(0);
+            if (!block.active) continue;
+            Eigen::LLT<Eigen::Ref<Eigen::MatrixXd>> llt(factor);
+            if (llt.info() != Eigen::Success) {
+                success = false;
+                continue;
+            }
+            Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>> coupling(
+                    &_couplings[block.valueStart], block.nCoupled, block.size);
+            std::size_t k = block.couplingStart;
+            for (std::size_t r = rawStart[b]; r < rawStart[b + 1]; ++r) {
+                if (r != rawStart[b] && raw[r].index != raw[r - 1].index) ++k;
+                _coupledIndices[k] = raw[r].index;
+                coupling(k - block.couplingStart, raw[r].row) = raw[r].value;
+            }
+            // transpose(H_MS L^-T) = L^-1 H_SM
+            Eigen::MatrixXd columns = coupling.transpose();
+            factor.triangularView<Eigen::Lower>().solveInPlace(columns);
+            tripletList.clear();
+            for (unsigned c = 0; c < block.size; ++c) {
+                for (std::size_t t = 0; t < block.nCoupled; ++t) {
+                    tripletList.addTriplet(_coupledIndices[block.couplingStart + t], c, columns(c, t));
+                }
+            }
+            tripletList.setNextFreeIndex(block.size);
+            _reductionAssembler.add(tripletList, i);
+        }
+    });
+    if (!success) return false;
+    reduced = modelHessian - _reductionAssembler.finish();
+    return true;
+}
+
+Eigen::VectorXd SchurComplement::reduceGradient(Eigen::VectorXd const &grad) const {
+    Eigen::VectorXd reducedGrad(_nParReduced);
+    for (unsigned k = 0; k < _nParTot; ++k) {
+        if (_paramBlock[k] < 0) reducedGrad[_reducedIndex[k]] = grad[k];
+    }
+    for (auto const &block : _blocks) {
+        if (!block.active) continue;
+        Eigen::Map<Eigen::MatrixXd const> factor(&_factors[block.factorOffset], block.size, block.size);
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> const> coupling(
+                &_couplings[block.valueStart], block.nCoupled, block.size);
+        // H_SS^-1 g_S
+        Eigen::VectorXd y = grad.segment(block.first, block.size);
+        factor.triangularView<Eigen::Lower>().solveInPlace(y);
+        factor.transpose().triangularView<Eigen::Upper>().solveInPlace(y);
+        Eigen::VectorXd correction = coupling * y;
+        for (std::size_t t = 0; t < block.nCoupled; ++t) {
+            reducedGrad[_coupledIndices[block.couplingStart + t]] -= correction[t];
+        }
+    }
+    return reducedGrad;
+}
+
+Eigen::VectorXd SchurComplement::backSubstitute(Eigen::VectorXd const &grad,
+                                                Eigen::VectorXd const &reducedDelta) const {
+    Eigen::VectorXd delta = Eigen::VectorXd::Zero(_nParTot);
+    for (unsigned k = 0; k < _nParTot; ++k) {
+        if (_paramBlock[k] < 0) delta[k] = reducedDelta[_reducedIndex[k]];
+    }
+    for (auto const &block : _blocks) {
+        if (!block.active) continue;
+        Eigen::Map<Eigen::MatrixXd const> factor(&_factors[block.factorOffset], block.size, block.size);
+        Eigen::Map<Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor> const> coupling(
+                &_couplings[block.valueStart], block.nCoupled, block.size);
+        // H_SS^-1 (g_S - H_SM delta_M)
+        Eigen::VectorXd y = grad.segment(block.first, block.size);
+        for (std::size_t t = 0; t < block.nCoupled; ++t) {
+            y -= coupling.row(t).transpose() * reducedDelta[_coupledIndices[block.couplingStart + t]];
+        }
+        factor.triangularView<Eigen::Lower>().solveInPlace(y);
+        factor.transpose().triangularView<Eigen::Upper>().solveInPlace(y);
+        delta.segment(block.first, block.size) = y;
+    }
+    return delta;
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -34,6 +34,7 @@
 #include "lsst/jointcal/ProjectionHandler.h"
 #include "lsst/pex/exceptions.h"
 #include "lsst/jointcal/AstrometryTransform.h"
+#include "lsst/jointcal/Trace.h"
 
 namespace {
 LOG_LOGGER _log = LOG_GET("jointcal.SimpleAstrometryModel");
@@ -45,7 +46,7 @@ namespace jointcal {
 SimpleAstrometryModel::SimpleAstrometryModel(CcdImageList const &ccdImageList,
                                              const std::shared_ptr<ProjectionHandler const> projectionHandler,
                                              bool initFromWcs, unsigned nNotFit, unsigned order)
-        : _skyToTangentPlane(projectionHandler)
+        : _skyToTangentPlane(projectionHandler), _errorTransformFrozen(false)
 
 {
     unsigned count = 0;
@@ -123,8 +124,23 @@ void SimpleAstrometryModel::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+void SimpleAstrometryModel::getParameters(Eigen::VectorXd &parameters) const {
+    for (auto const &i : _myMap) {
+        auto mapping = i.second.get();
+        parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+    }
+}
+
+void SimpleAstrometryModel::setParameters(Eigen::VectorXd const &parameters) {
+    for (auto &i : _myMap) {
+        auto mapping = i.second.get();
+        mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+    }
+}
+
 void SimpleAstrometryModel::freezeErrorTransform() {
     for (auto &i : _myMap) i.second->freezeErrorTransform();
+    _errorTransformFrozen = true;
 }
 
 int SimpleAstrometryModel::getTotalParameters() const {
@@ -140,6 +156,7 @@ const AstrometryTransform &SimpleAstrometryModel::getTransform(CcdImage const &c
 }
 
 std::shared_ptr<afw::geom::SkyWcs> SimpleAstrometryModel::makeSkyWcs(CcdImage const &ccdImage) const {
+    JOINTCAL_TRACE_SPAN_DETAIL("makeSkyWcs", ccdImage.getName());
     auto proj = std::dynamic_pointer_cast<const TanRaDecToPixel>(getSkyToTangentPlane(ccdImage));
     jointcal::Point tangentPoint(proj->getTangentPoint());
 
@@ -52,10 +52,25 @@ void SimplePhotometryModel::offsetParams(Eigen::VectorXd const &delta) {
     }
 }
 
+void SimplePhotometryModel::getParameters(Eigen::VectorXd &parameters) const {
+    for (auto const &i : _myMap) {
+        auto mapping = i.second.get();
+        parameters.segment(mapping->getIndex(), mapping->getNpar()) = mapping->getParameters();
+    }
+}
+
+void SimplePhotometryModel::setParameters(Eigen::VectorXd const &parameters) {
+    for (auto &i : _myMap) {
+        auto mapping = i.second.get();
+        mapping->setParameters(parameters.segment(mapping->getIndex(), mapping->getNpar()));
+    }
+}
+
 void SimplePhotometryModel::freezeErrorTransform() {
     for (auto &i : _myMap) {
         i.second->freezeErrorTransform();
     }
+    _errorTransformFrozen = true;
 }
 
 void SimplePhotometryModel::getMappingIndices(CcdImage const &ccdImage,
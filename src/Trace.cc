@@ -0,0 +1,141 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+#include <iomanip>
+#include <mutex>
+#include <vector>
+
+#include <unistd.h>
+
+#include "lsst/log/Log.h"
+#include "lsst/pex/exceptions.h"
+
+#include "lsst/jointcal/Trace.h"
+
+namespace lsst {
+namespace jointcal {
+
+namespace {
+LOG_LOGGER _log = LOG_GET("jointcal.Trace");
+
+struct TraceEvent {
+    char const *name;
+    std::string detail;
+    double begin;     // microseconds since Trace::start()
+    double duration;  // microseconds
+    unsigned thread;
+};
+
+std::mutex traceMutex;
+std::vector<TraceEvent> traceEvents;
+Trace::Clock::time_point traceOrigin;
+std::atomic<unsigned> nTraceThreads(0);
+
+/// A small, stable id of the calling thread, numbered in the order the threads first record a span.
+unsigned getThreadIndex() {
+    thread_local unsigned const index = nTraceThreads++;
+    return index;
+}
+
+/// Write value as a JSON string, with its quotes.
+void writeJsonString(std::ostream &out, std::string const &value) {
+    out << '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            char escaped[8];
+            std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            out << escaped;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+}  // namespace
+
+std::atomic<bool> Trace::_enabled(false);
+
+void Trace::start() {
+    std::lock_guard<std::mutex> lock(traceMutex);
+    traceEvents.clear();
+    traceOrigin = Clock::now();
+    _enabled = true;
+}
+
+void Trace::stop(std::string const &path) {
+    _enabled = false;
+    std::vector<TraceEvent> events;
+    {
+        std::lock_guard<std::mutex> lock(traceMutex);
+        events.swap(traceEvents);
+    }
+
+    std::ofstream out(path, std::ios::trunc);
+    if (!out) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Could not open " + path + " for writing.");
+    }
+    long const pid = ::getpid();
+    // nanosecond resolution whatever the time since start(): the default 6 significant digits would
+    // round the timestamps to 100 microseconds after 10 seconds.
+    out << std::fixed << std::setprecision(3);
+    out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+    for (std::size_t i = 0; i < events.size(); ++i) {
+        auto const &event = events[i];
+        out << "{\"name\": ";
+        writeJsonString(out, event.name);
+        out << ", \"cat\": \"jointcal\", \"ph\": \"X\", \"ts\": " << event.begin
+            << ", \"dur\": " << event.duration << ", \"pid\": " << pid << ", \"tid\": " << event.thread;
+        if (!event.detail.empty()) {
+            out << ", \"args\": {\"detail\": ";
+            writeJsonString(out, event.detail);
+            out << "}";
+        }
+        out << (i + 1 < events.size() ? "},\n" : "}\n");
+    }
+    out << "]}\n";
+    out.close();
+    if (!out) {
+        throw LSST_EXCEPT(pex::exceptions::IoError, "Could not write the trace " + path);
+    }
+    LOGLS_INFO(_log, "Wrote " << events.size() << " trace spans to " << path);
+}
+
+void Trace::record(char const *name, std::string const &detail, Clock::time_point begin,
+                   Clock::time_point end) {
+    std::chrono::duration<double, std::micro> const duration = end - begin;
+    unsigned const thread = getThreadIndex();
+    std::lock_guard<std::mutex> lock(traceMutex);
+    // a span that began before the last start() is shown as starting with it.
+    std::chrono::duration<double, std::micro> const offset = begin - traceOrigin;
+    traceEvents.push_back({name, detail, std::max(offset.count(), 0.), duration.count(), thread});
+}
+
+}  // namespace jointcal
+}  // namespace lsst
@@ -204,6 +204,22 @@ class JointcalTestBase:
 
         return result
 
+    def _getMetrics(self, result):
+        """Return the metrics measured by a jointcal run.
+
+        Parameters
+        ----------
+        result : pipe.base.Struct
+            The structure returned by `_runJointcalTask`.
+
+        Returns
+        -------
+        dict
+            The value of each measured metric, by metric name.
+        """
+        measurements = result.resultList[0].result.job.measurements
+        return {key.metric: measurements[key].quantity.value for key in measurements}
+
     def _plotJointcalTask(self, data_refs, oldWcsList, caller):
         """
         Plot the results of a jointcal run.
@@ -36,6 +36,7 @@ import lsst.afw.table
 import lsst.afw.image
 import lsst.afw.image.utils
 import lsst.daf.persistence
+import lsst.pex.exceptions
 import lsst.jointcal
 from lsst.jointcal import astrometryModels
 from lsst.meas.algorithms import astrometrySourceSelector
@@ -390,6 +391,23 @@ class ConstrainedAstrometryModelTestCase(AstrometryModelTestBase, lsst.utils.tes
         self.checkGetVisitTransform(self.model1)
         self.checkGetVisitTransform(self.model2)
 
+    def testSetChipParameters(self):
+        """setChipParameters should set the chips of a model of the same
+        chipOrder, and raise if a chip is missing or has another order.
+        """
+        chipParameters = self.model1.getChipParameters()
+        self.assertEqual(sorted(chipParameters), sorted(self.ccds))
+        shifted = {ccd: parameters + 1e-3 for ccd, parameters in chipParameters.items()}
+        self.assertEqual(self.model1.setChipParameters(shifted), len(self.ccds))
+        for ccd, parameters in self.model1.getChipParameters().items():
+            self.assertFloatsEqual(parameters, shifted[ccd], msg=str(ccd))
+
+        del shifted[self.ccds[0]]
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            self.model1.setChipParameters(shifted)
+        with self.assertRaises(lsst.pex.exceptions.LengthError):
+            self.model2.setChipParameters(chipParameters)
+
 
 class MemoryTester(lsst.utils.tests.MemoryTestCase):
     pass
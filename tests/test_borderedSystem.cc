@@ -0,0 +1,203 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_borderedSystem
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <vector>
+
+#include "Eigen/Cholesky"
+#include "Eigen/Core"
+
+#include "lsst/jointcal/BorderedSystem.h"
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+// Far more parameters than the dense row threshold, max(16, 10*sqrt(nParTot)) = 200.
+unsigned const nParTot = 400;
+unsigned const denseBorder = 100;    // coupled to all the other parameters
+unsigned const sparserBorder = 300;  // coupled to 300 of them
+unsigned const sparseCandidate = 7;   // a candidate that is not dense
+std::vector<unsigned> const candidates = {sparserBorder, sparseCandidate, denseBorder};
+
+/*
+ * A diagonally dominant matrix: a tridiagonal interior, as a chain of parameters each coupled to the next,
+ * with the couplings of the two border parameters, if withBorder, standing for refraction coefficients.
+ */
+Eigen::MatrixXd makeHessian(bool withBorder) {
+    Eigen::MatrixXd hessian = Eigen::MatrixXd::Zero(nParTot, nParTot);
+    for (unsigned i = 0; i < nParTot; ++i) {
+        hessian(i, i) = 4 + 0.001 * i;
+        if (i + 1 < nParTot) hessian(i + 1, i) = hessian(i, i + 1) = -1;
+    }
+    if (withBorder) {
+        for (unsigned i = 0; i < nParTot; ++i) {
+            if (i != denseBorder) hessian(i, denseBorder) = hessian(denseBorder, i) = 0.01 * (1 + i % 3);
+            if (i != sparserBorder && i % 4 != 0) {
+                hessian(i, sparserBorder) = hessian(sparserBorder, i) = -0.01;
+            }
+        }
+        hessian(denseBorder, denseBorder) = hessian(sparserBorder, sparserBorder) = 10;
+    }
+    return hessian;
+}
+
+SparseMatrixD lowerTriangle(Eigen::MatrixXd const &dense) {
+    SparseMatrixD lower = dense.sparseView();
+    lower = lower.triangularView<Eigen::Lower>();
+    lower.makeCompressed();
+    return lower;
+}
+
+void checkClose(Eigen::VectorXd const &result, Eigen::VectorXd const &expect) {
+    BOOST_CHECK_SMALL((result - expect).lpNorm<Eigen::Infinity>(), 1e-12 * expect.lpNorm<Eigen::Infinity>());
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_borderedSystem)
+
+/* The dense parameters are split off, and the bordered solution is that of the full system. */
+BOOST_AUTO_TEST_CASE(test_solve) {
+    Eigen::MatrixXd hessian = makeHessian(true);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, -1, 2);
+
+    jointcal::BorderedSystem borderedSystem(4);
+    SparseMatrixD interior;
+    BOOST_REQUIRE(borderedSystem.split(lowerTriangle(hessian), candidates, interior));
+    BOOST_CHECK(borderedSystem.getBorder() == std::vector<unsigned>({denseBorder, sparserBorder}));
+    BOOST_CHECK_EQUAL(interior.rows(), nParTot - 2);
+    BOOST_CHECK_EQUAL(borderedSystem.getInteriorIndex(denseBorder), -1);
+    BOOST_CHECK_EQUAL(borderedSystem.getInteriorIndex(denseBorder + 1), static_cast<int>(denseBorder));
+
+    CholmodSimplicialLDLT2<SparseMatrixD> interiorFactor;
+    interiorFactor.compute(interior);
+    BOOST_REQUIRE(borderedSystem.reduce(interiorFactor));
+    checkClose(borderedSystem.solve(interiorFactor, grad), hessian.ldlt().solve(grad));
+}
+
+/* Only the densest parameters are kept in a border limited to fewer parameters. */
+BOOST_AUTO_TEST_CASE(test_maxBorder) {
+    Eigen::MatrixXd hessian = makeHessian(true);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, 2, -1);
+
+    jointcal::BorderedSystem borderedSystem(1);
+    SparseMatrixD interior;
+    BOOST_REQUIRE(borderedSystem.split(lowerTriangle(hessian), candidates, interior));
+    BOOST_CHECK(borderedSystem.getBorder() == std::vector<unsigned>({denseBorder}));
+
+    CholmodSimplicialLDLT2<SparseMatrixD> interiorFactor;
+    interiorFactor.compute(interior);
+    BOOST_REQUIRE(borderedSystem.reduce(interiorFactor));
+    checkClose(borderedSystem.solve(interiorFactor, grad), hessian.ldlt().solve(grad));
+}
+
+/* There is no border without dense candidates, nor when it is disabled. */
+BOOST_AUTO_TEST_CASE(test_noBorder) {
+    SparseMatrixD interior;
+    jointcal::BorderedSystem borderedSystem(4);
+    BOOST_CHECK(!borderedSystem.split(lowerTriangle(makeHessian(false)), candidates, interior));
+    BOOST_CHECK_EQUAL(borderedSystem.getNBorder(), 0u);
+
+    // the dense parameters are not candidates.
+    BOOST_CHECK(!borderedSystem.split(lowerTriangle(makeHessian(true)), {sparseCandidate}, interior));
+    BOOST_CHECK(!borderedSystem.split(lowerTriangle(makeHessian(true)), {}, interior));
+    BOOST_CHECK_EQUAL(borderedSystem.getNBorder(), 0u);
+
+    borderedSystem.setMaxBorder(0);
+    BOOST_CHECK(!borderedSystem.split(lowerTriangle(makeHessian(true)), candidates, interior));
+    BOOST_CHECK_EQUAL(borderedSystem.getNBorder(), 0u);
+}
+
+/* A rank downdate of the interior factor and of the couplings solves the downdated system. */
+BOOST_AUTO_TEST_CASE(test_rankUpdate) {
+    Eigen::MatrixXd hessian = makeHessian(true);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, -2, 1);
+
+    jointcal::BorderedSystem borderedSystem(4);
+    SparseMatrixD interior;
+    BOOST_REQUIRE(borderedSystem.split(lowerTriangle(hessian), candidates, interior));
+    CholmodSimplicialLDLT2<SparseMatrixD> interiorFactor;
+    interiorFactor.compute(interior);
+
+    // Two "outlier" Jacobian columns, each coupling a few interior parameters to both border parameters.
+    Eigen::MatrixXd outliers = Eigen::MatrixXd::Zero(nParTot, 2);
+    outliers(10, 0) = outliers(11, 0) = 0.5;
+    outliers(250, 1) = outliers(251, 1) = -0.5;
+    outliers(denseBorder, 0) = outliers(sparserBorder, 1) = 0.1;
+    outliers(denseBorder, 1) = 0.2;
+    SparseMatrixD outlierColumns = outliers.sparseView();
+    hessian -= outliers * outliers.transpose();
+
+    interiorFactor.update(borderedSystem.getInteriorRows(outlierColumns), false);
+    borderedSystem.updateCouplings(lowerTriangle(hessian));
+    BOOST_REQUIRE(borderedSystem.reduce(interiorFactor));
+    checkClose(borderedSystem.solve(interiorFactor, grad), hessian.ldlt().solve(grad));
+}
+
+/*
+ * The factor of a fit with a refraction coefficient, coupled to every other parameter, is that of the same
+ * fit without refraction once the coefficient is in the border.
+ */
+BOOST_AUTO_TEST_CASE(test_refractionFill) {
+    // stars of 2 parameters, each measured in 3 of the visits of 6 parameters.
+    unsigned const nVisits = 20;
+    unsigned const nStars = 500;
+    unsigned const nParVisits = 6 * nVisits;
+    unsigned const nPar = nParVisits + 2 * nStars;
+    auto makeFit = [&](bool withRefraction) {
+        unsigned const n = nPar + (withRefraction ? 1 : 0);
+        Eigen::MatrixXd hessian = Eigen::MatrixXd::Identity(n, n) * 100;
+        for (unsigned s = 0; s < nStars; ++s) {
+            unsigned const star = nParVisits + 2 * s;
+            for (unsigned m = 0; m < 3; ++m) {
+                unsigned const visit = 6 * ((s + 7 * m) % nVisits);
+                for (unsigned i = 0; i < 2; ++i) {
+                    for (unsigned k = 0; k < 6; ++k) hessian(star + i, visit + k) = -0.1;
+                }
+            }
+            hessian(star + 1, star) = 0.5;
+        }
+        if (withRefraction) hessian.row(nPar).head(nPar).setConstant(0.01);
+        return lowerTriangle(hessian);
+    };
+
+    CholmodSimplicialLDLT2<SparseMatrixD> plainFactor;
+    plainFactor.compute(makeFit(false));
+
+    jointcal::BorderedSystem borderedSystem;
+    SparseMatrixD interior;
+    BOOST_REQUIRE(borderedSystem.split(makeFit(true), {nPar}, interior));
+    BOOST_CHECK(borderedSystem.getBorder() == std::vector<unsigned>({nPar}));
+    CholmodSimplicialLDLT2<SparseMatrixD> interiorFactor;
+    interiorFactor.compute(interior);
+    BOOST_CHECK_LE(interiorFactor.getFactorNonZeros(), 1.01 * plainFactor.getFactorNonZeros());
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,88 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_chi2
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <cmath>
+#include <vector>
+
+#include "lsst/jointcal/Chi2.h"
+
+namespace jointcal = lsst::jointcal;
+
+BOOST_AUTO_TEST_SUITE(test_chi2)
+
+/* A record keeps its chi2 in double precision, and its index shifted by the offset of its list. */
+BOOST_AUTO_TEST_CASE(test_record) {
+    jointcal::Chi2List chi2List;
+    chi2List.addEntry(1 + 1e-12, 2, 3);
+    chi2List.setIndexOffset(100);
+    chi2List.addEntry(2.5, 1, 3);
+    BOOST_REQUIRE_EQUAL(chi2List.size(), 2u);
+    BOOST_CHECK_EQUAL(chi2List[0].chi2, 1 + 1e-12);
+    BOOST_CHECK_EQUAL(chi2List[0].index, 3u);
+    BOOST_CHECK_EQUAL(chi2List[1].index, 103u);
+
+    chi2List.reset();
+    BOOST_CHECK(chi2List.empty());
+    chi2List.addEntry(1, 2, 3);
+    BOOST_CHECK_EQUAL(chi2List[0].index, 3u);
+}
+
+/* The average and sigma of appended lists are those of all their records. */
+BOOST_AUTO_TEST_CASE(test_appendAverageAndSigma) {
+    std::vector<double> values = {0.5, 1.5, 2., 7., 3.25, 0.1};
+    jointcal::Chi2List first, second;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+        (i < 2 ? first : second).addEntry(values[i], 2, i);
+    }
+    first.append(second);
+    BOOST_REQUIRE_EQUAL(first.size(), values.size());
+    for (std::size_t i = 0; i < values.size(); ++i) BOOST_CHECK_EQUAL(first[i].chi2, values[i]);
+
+    double sum = 0, sum2 = 0;
+    for (double value : values) sum += value;
+    double const average = sum / values.size();
+    for (double value : values) sum2 += std::pow(value - average, 2);
+    auto averageAndSigma = first.computeAverageAndSigma();
+    BOOST_CHECK_CLOSE(averageAndSigma.first, average, 1e-10);
+    BOOST_CHECK_CLOSE(averageAndSigma.second, std::sqrt(sum2 / values.size()), 1e-10);
+}
+
+/* A Chi2Statistic sums the chi2 and the degrees of freedom. */
+BOOST_AUTO_TEST_CASE(test_statistic) {
+    jointcal::Chi2Statistic chi2, other;
+    chi2.addEntry(1.5, 2, 0);
+    other.addEntry(2., 1, 7);
+    chi2 += other;
+    BOOST_CHECK_EQUAL(chi2.chi2, 3.5);
+    BOOST_CHECK_EQUAL(chi2.ndof, 3u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,79 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_eigenstuff
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+
+namespace {
+/*
+ * The lower triangle of a diagonally dominant tridiagonal matrix, with one extra coupling between
+ * parameters 0 and farIndex.
+ */
+SparseMatrixD makeLower(int size, int farIndex) {
+    Eigen::MatrixXd dense = Eigen::MatrixXd::Zero(size, size);
+    for (int i = 0; i < size; ++i) {
+        dense(i, i) = 4;
+        if (i > 0) dense(i, i - 1) = -1;
+    }
+    dense(farIndex, 0) = 0.5;
+    SparseMatrixD lower = dense.sparseView();
+    lower.makeCompressed();
+    return lower;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_eigenstuff)
+
+/* The symbolic analysis is reused for the same pattern only, whatever the values. */
+BOOST_AUTO_TEST_CASE(test_computeReusingAnalysis) {
+    CholmodSimplicialLDLT2<SparseMatrixD> factor;
+    SparseMatrixD first = makeLower(20, 10);
+    BOOST_CHECK(!factor.computeReusingAnalysis(first));
+    BOOST_CHECK(factor.info() == Eigen::Success);
+
+    SparseMatrixD scaled = 2 * first;
+    scaled.makeCompressed();
+    BOOST_CHECK(factor.computeReusingAnalysis(scaled));
+
+    // Same size and number of non-zeros, different pattern.
+    SparseMatrixD moved = makeLower(20, 11);
+    BOOST_REQUIRE_EQUAL(moved.nonZeros(), first.nonZeros());
+    BOOST_CHECK(!factor.computeReusingAnalysis(moved));
+    BOOST_CHECK(factor.computeReusingAnalysis(moved));
+
+    Eigen::VectorXd rhs = Eigen::VectorXd::LinSpaced(20, -1, 1);
+    SparseMatrixD full = moved.selfadjointView<Eigen::Lower>();
+    Eigen::VectorXd solution = factor.solve(rhs);
+    BOOST_CHECK_SMALL((full * solution - rhs).lpNorm<Eigen::Infinity>(), 1e-12);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
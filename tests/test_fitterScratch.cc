@@ -0,0 +1,106 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_fitterScratch
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/FitterScratch.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+Eigen::Index const nPar = 20;
+std::size_t const nSlots = 2;
+
+/// One pass of a fitter: fill the buffers of each slot, with nTriplets[slot] Jacobian triplets.
+void pass(jointcal::FitterScratch &scratch, std::vector<std::size_t> const &nTriplets) {
+    auto &gradients = scratch.getGradients(nSlots, nPar);
+    auto &jacobians = scratch.getJacobians(nSlots);
+    for (std::size_t slot = 0; slot < nSlots; ++slot) {
+        gradients[slot].setOnes();
+        jacobians[slot].clear();
+        for (std::size_t k = 0; k < nTriplets[slot]; ++k) jacobians[slot].addTriplet(k % nPar, k, 1.);
+    }
+    auto &chi2List = scratch.getChi2List(50);
+    for (std::size_t k = 0; k < 50; ++k) chi2List.addEntry(1., 2, k);
+    scratch.getCounters(nPar).setOnes();
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_fitterScratch)
+
+/* The first pass allocates every buffer, and a pass of the same size allocates none. */
+BOOST_AUTO_TEST_CASE(test_steadyState) {
+    jointcal::FitterScratch scratch;
+    pass(scratch, {100, 100});
+    // the gradients and Jacobians of both slots, the chi2 list and the counters.
+    BOOST_CHECK_EQUAL(scratch.getNAllocations(), 6u);
+    BOOST_CHECK_GT(scratch.getBytes(), 0u);
+
+    scratch.resetNAllocations();
+    BOOST_CHECK_EQUAL(scratch.getNAllocations(), 0u);
+    pass(scratch, {100, 100});
+    pass(scratch, {50, 100});
+    BOOST_CHECK_EQUAL(scratch.getNAllocations(), 0u);
+}
+
+/* Growth is counted per slot: a slot that outgrows its own buffer counts, whatever the other slots hold. */
+BOOST_AUTO_TEST_CASE(test_growth) {
+    jointcal::FitterScratch scratch;
+    pass(scratch, {1000, 10});
+    scratch.resetNAllocations();
+    pass(scratch, {10, 500});
+    BOOST_CHECK_EQUAL(scratch.getNAllocations(), 1u);
+    BOOST_CHECK_EQUAL(scratch.getJacobians(nSlots)[1].size(), 500u);
+}
+
+/* The getters return emptied buffers. */
+BOOST_AUTO_TEST_CASE(test_reset) {
+    jointcal::FitterScratch scratch;
+    pass(scratch, {100, 100});
+    for (auto const &gradient : scratch.getGradients(nSlots, nPar)) BOOST_CHECK(gradient.isZero(0));
+    BOOST_CHECK(scratch.getCounters(nPar).isZero(0));
+    BOOST_CHECK(scratch.getChi2List(50).empty());
+}
+
+/* Released buffers are freed, and allocated again on the next pass. */
+BOOST_AUTO_TEST_CASE(test_release) {
+    jointcal::FitterScratch scratch;
+    pass(scratch, {100, 100});
+    scratch.resetNAllocations();
+    scratch.release();
+    BOOST_CHECK_EQUAL(scratch.getBytes(), 0u);
+    pass(scratch, {100, 100});
+    BOOST_CHECK_EQUAL(scratch.getNAllocations(), 6u);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
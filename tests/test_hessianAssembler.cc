@@ -0,0 +1,200 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_hessianAssembler
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/HessianAssembler.h"
+#include "lsst/jointcal/Tripletlist.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+unsigned const nParTot = 40;
+
+/*
+ * Jacobian blocks standing for the measurements of a few CcdImages: each column (a measurement) depends on
+ * a few parameters shared by its block (the mappings), one of its own (the star), and sometimes the same
+ * parameter twice, as the derivatives of both coordinates of a measurement do.
+ */
+std::vector<jointcal::TripletList> makeJacobianBlocks(unsigned seed, unsigned nBlocks = 5) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::uniform_int_distribution<unsigned> star(10, nParTot - 1);
+    std::vector<jointcal::TripletList> blocks;
+    for (unsigned block = 0; block < nBlocks; ++block) {
+        jointcal::TripletList tripletList(0);
+        unsigned const nColumns = 30;
+        for (unsigned col = 0; col < nColumns; ++col) {
+            tripletList.addTriplet(2 * (block % 5), col, value(generator));
+            tripletList.addTriplet(2 * (block % 5) + 1, col, value(generator));
+            unsigned const starIndex = star(generator);
+            tripletList.addTriplet(starIndex, col, value(generator));
+            if (col % 7 == 0) tripletList.addTriplet(starIndex, col, value(generator));
+        }
+        tripletList.setNextFreeIndex(nColumns);
+        blocks.push_back(std::move(tripletList));
+    }
+    return blocks;
+}
+
+/// The dense J*J^T of the Jacobian made of all the blocks, side by side.
+Eigen::MatrixXd computeDenseHessian(std::vector<jointcal::TripletList> const &blocks) {
+    std::size_t nColumns = 0;
+    for (auto const &block : blocks) nColumns += block.getNextFreeIndex();
+    Eigen::MatrixXd jacobian = Eigen::MatrixXd::Zero(nParTot, nColumns);
+    std::size_t firstColumn = 0;
+    for (auto const &block : blocks) {
+        for (auto const &trip : block) jacobian(trip.row(), firstColumn + trip.col()) += trip.value();
+        firstColumn += block.getNextFreeIndex();
+    }
+    return jacobian * jacobian.transpose();
+}
+
+/// Assemble the blocks, dealt to nSlots slots in contiguous ranges as the fitter does.
+Eigen::MatrixXd assemble(jointcal::HessianAssembler &assembler,
+                         std::vector<jointcal::TripletList> const &blocks, std::size_t nSlots) {
+    assembler.start(nSlots);
+    for (std::size_t i = 0; i < blocks.size(); ++i) {
+        assembler.add(blocks[i], i * nSlots / blocks.size());
+    }
+    Eigen::MatrixXd lower(assembler.finish());
+    return lower.selfadjointView<Eigen::Lower>();
+}
+
+/// Assemble the blocks as the fitter does: one chunk per slot, in waves of nSlots chunks folded in order.
+Eigen::MatrixXd assembleInWaves(jointcal::HessianAssembler &assembler,
+                                std::vector<jointcal::TripletList> const &blocks, std::size_t nSlots) {
+    assembler.start(nSlots);
+    for (std::size_t first = 0; first < blocks.size(); first += nSlots) {
+        std::size_t const nWave = std::min(nSlots, blocks.size() - first);
+        for (std::size_t slot = 0; slot < nWave; ++slot) assembler.add(blocks[first + slot], slot);
+        assembler.fold(nWave);
+    }
+    Eigen::MatrixXd lower(assembler.finish());
+    return lower.selfadjointView<Eigen::Lower>();
+}
+
+void checkClose(Eigen::MatrixXd const &result, Eigen::MatrixXd const &expect) {
+    BOOST_CHECK_SMALL((result - expect).lpNorm<Eigen::Infinity>(), 1e-12 * expect.lpNorm<Eigen::Infinity>());
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_hessianAssembler)
+
+/* The assembled lower triangle is that of J*J^T, with one slot or several. */
+BOOST_AUTO_TEST_CASE(test_assemble) {
+    auto blocks = makeJacobianBlocks(1);
+    Eigen::MatrixXd expect = computeDenseHessian(blocks);
+    for (std::size_t nSlots : {1, 2, 3}) {
+        jointcal::HessianAssembler assembler;
+        assembler.reset(nParTot);
+        BOOST_CHECK(!assembler.hasPattern());
+        checkClose(assemble(assembler, blocks, nSlots), expect);
+        BOOST_CHECK(assembler.hasPattern());
+    }
+}
+
+/* A pass on the cached pattern refills the values of the new Jacobian. */
+BOOST_AUTO_TEST_CASE(test_refill) {
+    auto blocks = makeJacobianBlocks(1);
+    jointcal::HessianAssembler assembler;
+    assembler.reset(nParTot);
+    assemble(assembler, blocks, 2);
+
+    // same pattern, other values.
+    for (auto &block : blocks) {
+        for (auto &trip : block) trip = jointcal::Trip(trip.row(), trip.col(), 2 * trip.value() + 0.5);
+    }
+    checkClose(assemble(assembler, blocks, 2), computeDenseHessian(blocks));
+    // the same slots add the same values in the same order.
+    BOOST_CHECK(assemble(assembler, blocks, 2) == assemble(assembler, blocks, 2));
+}
+
+/* A pass that leaves the cached pattern is assembled from scratch, and caches its own pattern. */
+BOOST_AUTO_TEST_CASE(test_leavePattern) {
+    jointcal::HessianAssembler assembler;
+    assembler.reset(nParTot);
+    assemble(assembler, makeJacobianBlocks(1), 3);
+
+    auto blocks = makeJacobianBlocks(2);
+    checkClose(assemble(assembler, blocks, 3), computeDenseHessian(blocks));
+    checkClose(assemble(assembler, blocks, 3), computeDenseHessian(blocks));
+}
+
+/* Chunks folded in waves give the same matrix bit for bit whatever the number of slots. */
+BOOST_AUTO_TEST_CASE(test_wavesBitIdentical) {
+    auto blocks = makeJacobianBlocks(3, 11);
+    auto otherBlocks = makeJacobianBlocks(4, 11);
+    std::vector<Eigen::MatrixXd> firstPass, refill, leavePattern;
+    for (std::size_t nSlots : {1, 2, 3, 4, 11}) {
+        jointcal::HessianAssembler assembler;
+        assembler.reset(nParTot);
+        firstPass.push_back(assembleInWaves(assembler, blocks, nSlots));
+        refill.push_back(assembleInWaves(assembler, blocks, nSlots));
+        leavePattern.push_back(assembleInWaves(assembler, otherBlocks, nSlots));
+    }
+    checkClose(firstPass[0], computeDenseHessian(blocks));
+    checkClose(leavePattern[0], computeDenseHessian(otherBlocks));
+    for (std::size_t i = 1; i < firstPass.size(); ++i) {
+        BOOST_CHECK(firstPass[i] == firstPass[0]);
+        BOOST_CHECK(refill[i] == refill[0]);
+        BOOST_CHECK(leavePattern[i] == leavePattern[0]);
+    }
+}
+
+/* The accumulators are kept between passes: a pass on the cached pattern allocates nothing. */
+BOOST_AUTO_TEST_CASE(test_keepStorage) {
+    auto blocks = makeJacobianBlocks(1);
+    jointcal::HessianAssembler assembler;
+    assembler.reset(nParTot);
+    assembleInWaves(assembler, blocks, 2);
+    assembleInWaves(assembler, blocks, 2);
+    BOOST_CHECK_GT(assembler.getNAllocations(), 0u);
+    std::size_t const nBytes = assembler.getBytes();
+    BOOST_CHECK_GT(nBytes, 0u);
+
+    assembler.resetNAllocations();
+    assembleInWaves(assembler, blocks, 2);
+    assembleInWaves(assembler, blocks, 1);
+    BOOST_CHECK_EQUAL(assembler.getNAllocations(), 0u);
+    BOOST_CHECK_EQUAL(assembler.getBytes(), nBytes);
+
+    assembler.release();
+    BOOST_CHECK_EQUAL(assembler.getBytes(), 0u);
+    BOOST_CHECK(assembler.hasPattern());
+    checkClose(assembleInWaves(assembler, blocks, 2), computeDenseHessian(blocks));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,145 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_hessianComponents
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <vector>
+
+#include "Eigen/Cholesky"
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/HessianComponents.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+unsigned const nParTot = 30;
+unsigned const nComponents = 3;
+
+/*
+ * A matrix that is block diagonal up to a permutation: parameter i belongs to component i % nComponents,
+ * and is coupled to the next parameter of its component, as interleaved groups of CcdImages would be.
+ */
+Eigen::MatrixXd makeHessian() {
+    Eigen::MatrixXd hessian = Eigen::MatrixXd::Zero(nParTot, nParTot);
+    for (unsigned i = 0; i < nParTot; ++i) {
+        hessian(i, i) = 3 + 0.1 * i;
+        unsigned const next = i + nComponents;
+        if (next < nParTot) hessian(next, i) = hessian(i, next) = -1 - 0.05 * i;
+    }
+    return hessian;
+}
+
+SparseMatrixD lowerTriangle(Eigen::MatrixXd const &dense) {
+    SparseMatrixD lower = dense.sparseView();
+    lower = lower.triangularView<Eigen::Lower>();
+    lower.makeCompressed();
+    return lower;
+}
+
+/// Solve each component of lower on its own, and gather the solutions into the full solution.
+Eigen::VectorXd solveByComponent(jointcal::HessianComponents const &components, SparseMatrixD const &lower,
+                                 Eigen::VectorXd const &grad) {
+    Eigen::VectorXd delta = Eigen::VectorXd::Zero(grad.size());
+    for (std::size_t i = 0; i < components.getNComponents(); ++i) {
+        Eigen::MatrixXd block(components.extract(lower, i));
+        Eigen::MatrixXd full = block.selfadjointView<Eigen::Lower>();
+        components.scatter(full.ldlt().solve(components.gather(grad, i)), i, delta);
+    }
+    return delta;
+}
+
+void checkClose(Eigen::VectorXd const &result, Eigen::VectorXd const &expect) {
+    BOOST_CHECK_SMALL((result - expect).lpNorm<Eigen::Infinity>(), 1e-12 * expect.lpNorm<Eigen::Infinity>());
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_hessianComponents)
+
+/* The interleaved components are found, sorted by their first parameter. */
+BOOST_AUTO_TEST_CASE(test_find) {
+    jointcal::HessianComponents components;
+    BOOST_REQUIRE_EQUAL(components.find(lowerTriangle(makeHessian())), nComponents);
+    for (unsigned c = 0; c < nComponents; ++c) {
+        std::vector<unsigned> expect;
+        for (unsigned i = c; i < nParTot; i += nComponents) expect.push_back(i);
+        BOOST_CHECK(components.getComponent(c) == expect);
+    }
+    for (unsigned i = 0; i < nParTot; ++i) BOOST_CHECK_EQUAL(components.getComponentOf(i), i % nComponents);
+
+    components.clear();
+    BOOST_CHECK_EQUAL(components.getNComponents(), 0u);
+}
+
+/* Solving the components on their own gives the solution of the whole matrix. */
+BOOST_AUTO_TEST_CASE(test_solve) {
+    Eigen::MatrixXd hessian = makeHessian();
+    SparseMatrixD lower = lowerTriangle(hessian);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, -1, 2);
+
+    jointcal::HessianComponents components;
+    components.find(lower);
+    checkClose(solveByComponent(components, lower, grad), hessian.ldlt().solve(grad));
+}
+
+/* Scattering the gathered entries of every component restores the full vector. */
+BOOST_AUTO_TEST_CASE(test_gatherScatter) {
+    jointcal::HessianComponents components;
+    components.find(lowerTriangle(makeHessian()));
+    Eigen::VectorXd full = Eigen::VectorXd::LinSpaced(nParTot, 1, nParTot);
+    Eigen::VectorXd result = Eigen::VectorXd::Zero(nParTot);
+    for (std::size_t i = 0; i < components.getNComponents(); ++i) {
+        components.scatter(components.gather(full, i), i, result);
+    }
+    BOOST_CHECK(result == full);
+}
+
+/* Merged parts cover every parameter once, and still solve the whole matrix. */
+BOOST_AUTO_TEST_CASE(test_merge) {
+    Eigen::MatrixXd hessian = makeHessian();
+    SparseMatrixD lower = lowerTriangle(hessian);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, 2, -1);
+
+    jointcal::HessianComponents components;
+    components.find(lower);
+    components.merge(2);
+    BOOST_REQUIRE_EQUAL(components.getNComponents(), 2u);
+    std::vector<unsigned> count(nParTot, 0);
+    for (std::size_t i = 0; i < components.getNComponents(); ++i) {
+        for (unsigned index : components.getComponent(i)) {
+            ++count[index];
+            BOOST_CHECK_EQUAL(components.getComponentOf(index), i);
+        }
+    }
+    BOOST_CHECK(count == std::vector<unsigned>(nParTot, 1));
+    checkClose(solveByComponent(components, lower, grad), hessian.ldlt().solve(grad));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
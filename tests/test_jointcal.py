@@ -108,16 +108,15 @@ class TestJointcalIterateFit(JointcalTestBase, lsst.utils.tests.TestCase):
         chi2 = self.jointcal._iterate_fit(self.associations, self.fitter,
                                           self.maxSteps, self.name, self.whatToFit)
         self.assertEqual(chi2, self.goodChi2)
-        # Once for the for loop, the second time for the rank update.
-        self.assertEqual(self.fitter.minimize.call_count, 2)
+        # minimize() monitors the accuracy of its rank updates: no extra call at convergence.
+        self.assertEqual(self.fitter.minimize.call_count, 1)
 
     def test_iterateFit_writeChi2Outer(self):
         chi2 = self.jointcal._iterate_fit(self.associations, self.fitter,
                                           self.maxSteps, self.name, self.whatToFit,
                                           dataName=self.dataName)
         self.assertEqual(chi2, self.goodChi2)
-        # Once for the for loop, the second time for the rank update.
-        self.assertEqual(self.fitter.minimize.call_count, 2)
+        self.assertEqual(self.fitter.minimize.call_count, 1)
         # Default config should not call saveChi2Contributions
         self.fitter.saveChi2Contributions.assert_not_called()
 
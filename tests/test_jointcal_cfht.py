@@ -19,9 +19,15 @@
 # You should have received a copy of the GNU General Public License
 # along with this program.  If not, see <https://www.gnu.org/licenses/>.
 
+import inspect
+import json
 import unittest
 import os
+import struct
+import tempfile
+from unittest import mock
 
+import numpy as np
 from astropy import units as u
 
 import lsst.afw.geom
@@ -154,6 +160,317 @@ class JointcalTestCFHT(jointcalTestBase.JointcalTestBase, lsst.utils.tests.TestC
 
         self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
 
+    def test_jointcalTask_2_visits_constrainedAstrometry_nThreads(self):
+        """Computing the derivatives on several threads only changes the
+        rounding of the Hessian, so the fit results must not change.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.nThreads = 3
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_supernodal(self):
+        """The supernodal factorization solves the same system, so the fit
+        results must not change, including after removing outliers. Cholmod
+        must also have actually used the supernodal kernel, rather than fallen
+        back to the simplicial one.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.factorizationMode = "supernodalLLT"
+
+        minimize = lsst.jointcal.AstrometryFit.minimize
+        modesUsed = []
+
+        def recordModeUsed(fit, *args, **kwargs):
+            outcome = minimize(fit, *args, **kwargs)
+            modesUsed.append(fit.getFactorizationModeUsed())
+            return outcome
+
+        with mock.patch.object(lsst.jointcal.AstrometryFit, "minimize", recordModeUsed):
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+        self.assertGreater(len(modesUsed), 0)
+        self.assertEqual(set(modesUsed), {lsst.jointcal.CholmodMode.SupernodalLLT})
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_starsFirst(self):
+        """A different fill-reducing ordering factorizes the same system, so
+        the fit results must not change.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.factorizationOrdering = "starsFirst"
+        self.config.compareOrderings = True
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_sortStarsSpatially(self):
+        """Reordering the stars only permutes the parameters of the fit, so
+        the fit results must not change.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.sortStarsSpatially = True
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_noDenseBorder(self):
+        """Factorizing the dense chip parameters with the rest of the Hessian
+        solves the same system, so the fit results must not change.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.maxDenseBorder = 0
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_checkpoint(self):
+        """A run restored from the checkpoint of a previous run must give the
+        same results, without associating or fitting again.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        with tempfile.TemporaryDirectory() as checkpointDir:
+            self.config.checkpointDir = checkpointDir
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+            self.assertEqual(len(os.listdir(checkpointDir)), 1)
+
+            # The restored run does not measure the associated and collected stars.
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_checkpoint_corrupt(self):
+        """A checkpoint whose records do not match its header, or refer to
+        stars it does not have, is refused when it is loaded.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        caller = inspect.stack()[0].function
+        # Byte offsets of the file layout in FitCheckpoint.cc.
+        headerSize = 104
+        nRefStarsOffset = 40
+        ccdImageRecordSize = 16
+        fittedStarIndexOffset = 120
+
+        with tempfile.TemporaryDirectory() as checkpointDir:
+            self.config.checkpointDir = checkpointDir
+            self._runJointcalTask(2, caller, metrics=metrics)
+            path = os.path.join(checkpointDir, os.listdir(checkpointDir)[0])
+            with open(path, "rb") as checkpointFile:
+                data = checkpointFile.read()
+            checkpoint = lsst.jointcal.FitCheckpoint(path)
+            nCcdImages = checkpoint.getNCcdImages()
+            nFittedStars = checkpoint.getNFittedStars()
+            del checkpoint
+
+            def corrupt(offset, fmt, value):
+                corruptPath = os.path.join(checkpointDir, "corrupt.bin")
+                with open(corruptPath, "wb") as corruptFile:
+                    corruptFile.write(data[:offset] + struct.pack(fmt, value) +
+                                      data[offset + struct.calcsize(fmt):])
+                return corruptPath
+
+            with self.assertRaises(lsst.pex.exceptions.LengthError):
+                lsst.jointcal.FitCheckpoint(corrupt(nRefStarsOffset, "=Q", 2**61))
+            # The measuredStars of the first ccdImage do not add up anymore.
+            nMeasuredStars = struct.unpack_from("=Q", data, headerSize + 8)[0]
+            with self.assertRaises(lsst.pex.exceptions.RuntimeError):
+                lsst.jointcal.FitCheckpoint(corrupt(headerSize + 8, "=Q", nMeasuredStars + 1))
+            measuredStarOffset = headerSize + nCcdImages*ccdImageRecordSize
+            with self.assertRaises(lsst.pex.exceptions.RuntimeError):
+                lsst.jointcal.FitCheckpoint(corrupt(measuredStarOffset + fittedStarIndexOffset, "=q",
+                                                    nFittedStars))
+            truncatedPath = os.path.join(checkpointDir, "truncated.bin")
+            with open(truncatedPath, "wb") as truncatedFile:
+                truncatedFile.write(data[:-8])
+            with self.assertRaises(lsst.pex.exceptions.LengthError):
+                lsst.jointcal.FitCheckpoint(truncatedPath)
+            # An unchanged copy still loads.
+            lsst.jointcal.FitCheckpoint(corrupt(0, "=B", data[0]))
+
+    def _testIncremental(self, name, visitWhatToFit, starWhatToFit, metrics, caller):
+        """Fit the first visit and save its solution, then add the second
+        visit to it: only the new visit and the stars are fit, with the chips
+        of the saved solution, and the fit is about as good as a full fit of
+        both visits.
+
+        Parameters
+        ----------
+        name : `str`
+            Name of the fit stage: "astrometry" or "photometry".
+        visitWhatToFit, starWhatToFit : `str`
+            What the incremental fit must fit.
+        metrics : `dict`
+            The metrics of a full fit of both visits.
+        caller : `str`
+            Name of the calling test, for the output directory.
+        """
+        fullReducedChi2 = metrics[f'{name}_final_chi2']/metrics[f'{name}_final_ndof']
+        with tempfile.TemporaryDirectory() as checkpointDir:
+            self.config.checkpointDir = checkpointDir
+            self._runJointcalTask(1, caller, metrics={key: None for key in metrics})
+            checkpoints = os.listdir(checkpointDir)
+            self.assertEqual(len(checkpoints), 1)
+            savedChips = lsst.jointcal.FitCheckpoint(
+                os.path.join(checkpointDir, checkpoints[0])).getChipParameters()
+
+            self.config.incremental = True
+            self.all_visits = self.all_visits[1:]
+            # No association from scratch and no reference catalog in an incremental fit: the saved
+            # stars are held by priors instead.
+            metrics = {f'selected_{name}_priorStars': None,
+                       f'selected_{name}_fittedStars': None,
+                       f'selected_{name}_ccdImages': 6,
+                       f'{name}_final_chi2': None,
+                       f'{name}_final_ndof': None,
+                       }
+            task = lsst.jointcal.jointcal.JointcalTask
+            with mock.patch.object(task, "_fit_new_visits", autospec=True,
+                                   side_effect=task._fit_new_visits) as fitNewVisits, \
+                    mock.patch.object(task, "_iterate_fit", autospec=True,
+                                      side_effect=task._iterate_fit) as iterateFit:
+                incremental = self._getMetrics(self._runJointcalTask(1, caller, metrics=metrics))
+            # The saved solution is not modified.
+            self.assertEqual(os.listdir(checkpointDir), checkpoints)
+
+        # Only the visits and the stars were fit...
+        fitNewVisits.assert_called_once()
+        iterateFit.assert_called_once()
+        self.assertEqual(iterateFit.call_args[0][5], f"{visitWhatToFit} {starWhatToFit}")
+        # ...so the chips are those of the saved solution.
+        model = fitNewVisits.call_args[0][3]
+        chips = model.getChipParameters()
+        self.assertEqual(sorted(chips), sorted(savedChips))
+        for chip, parameters in chips.items():
+            self.assertFloatsEqual(parameters, savedChips[chip], msg=str(chip))
+
+        self.assertGreater(incremental[f'selected_{name}_priorStars'], 0)
+        self.assertGreater(incremental[f'{name}_final_ndof'], 0)
+        # Frozen chips and priors can only make the fit a little worse than a full fit.
+        reducedChi2 = incremental[f'{name}_final_chi2']/incremental[f'{name}_final_ndof']
+        self.assertLess(reducedChi2, 1.5*fullReducedChi2)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_incremental(self):
+        """Adding the second visit to the saved solution of the first one fits
+        only the new visit and the stars it measures.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        caller = inspect.stack()[0].function
+        self._testIncremental("astrometry", "DistortionsVisit", "Positions", metrics, caller)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_problemSize(self):
+        """The predicted size of each fit must match the sizes of its Jacobian
+        and Hessian, and predicting the size of other fits in between must
+        not change the fit results.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+
+        minimize = lsst.jointcal.AstrometryFit.minimize
+        sizes = []
+
+        def predictingMinimize(fit, whatToFit, *args, **kwargs):
+            predicted = fit.computeProblemSize(whatToFit)
+            result = minimize(fit, whatToFit, *args, **kwargs)
+            actual = fit.getMetrics()
+            nSigmaCut = args[0] if args else kwargs.get("nSigRejCut", 0)
+            sizes.append((whatToFit, nSigmaCut, predicted, actual.nJacobianNonZeros,
+                          actual.nHessianNonZeros))
+            fit.computeProblemSize("Positions")
+            self.assertEqual(fit.getWhatToFit(), whatToFit)
+            return result
+
+        with mock.patch.object(lsst.jointcal.AstrometryFit, "minimize", predictingMinimize):
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+        nChecked = 0
+        for whatToFit, nSigmaCut, predicted, nJacobianNonZeros, nHessianNonZeros in sizes:
+            # Without outlier rejection, the last Jacobian has the measurements of the prediction...
+            if nSigmaCut == 0:
+                self.assertLessEqual(nJacobianNonZeros, predicted.nJacobianNonZeros, msg=whatToFit)
+                self.assertGreater(nJacobianNonZeros, 0.99*predicted.nJacobianNonZeros, msg=whatToFit)
+                nChecked += 1
+            # ...and the predicted Hessian is an upper bound in any case.
+            self.assertLessEqual(nHessianNonZeros, predicted.nHessianNonZeros, msg=whatToFit)
+            self.assertGreater(nHessianNonZeros, 0, msg=whatToFit)
+        self.assertGreater(nChecked, 0)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_parameters(self):
+        """Setting the parameters copied by getParameters() restores the fit
+        state exactly, after they were offset, without changing the fit.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+
+        minimize = lsst.jointcal.AstrometryFit.minimize
+        nChecked = 0
+
+        def roundTripMinimize(fit, *args, **kwargs):
+            nonlocal nChecked
+            result = minimize(fit, *args, **kwargs)
+            parameters = fit.getParameters()
+            chi2 = fit.computeChi2()
+            fit.offsetParams(np.full(len(parameters), 1e-3))
+            self.assertNotEqual(fit.computeChi2().chi2, chi2.chi2)
+            fit.setParameters(parameters)
+            np.testing.assert_array_equal(fit.getParameters(), parameters)
+            self.assertEqual(fit.computeChi2().chi2, chi2.chi2)
+            nChecked += 1
+            return result
+
+        with mock.patch.object(lsst.jointcal.AstrometryFit, "minimize", roundTripMinimize):
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+        self.assertGreater(nChecked, 0)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_stageMetrics(self):
+        """The performance counters of each stage are recorded in the Job,
+        without changing the fit.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.recordStageMetrics = True
+        caller = inspect.stack()[0].function
+        stages = ['load_catalog', 'associate_catalogs', 'collect_refstars', 'astrometry_fit']
+        for stage in stages:
+            for suffix, _ in lsst.jointcal.jointcal.STAGE_TIME_METRICS.values():
+                metrics[f'{stage}_{suffix}'] = None
+        for suffix, _ in lsst.jointcal.jointcal.STAGE_FIT_METRICS.values():
+            metrics[f'astrometry_fit_{suffix}'] = None
+
+        result = self._runJointcalTask(2, caller, metrics=metrics)
+        stageMetrics = result.resultList[0].result.stageMetrics
+        self.assertEqual(sorted(stageMetrics), sorted(stages))
+        self.assertEqual(stageMetrics['load_catalog'].nCalls, 12)
+        fit = stageMetrics['astrometry_fit']
+        self.assertGreater(fit.nFactorizations, 0)
+        self.assertGreater(fit.nHessianNonZeros, 0)
+        self.assertGreaterEqual(fit.nTriplets, fit.nJacobianNonZeros)
+        self.assertGreater(fit.nMeasOutliers + fit.nRefOutliers, 0)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_trace(self):
+        """The timeline of the fit is written as Chrome trace events, without
+        changing the fit.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        with tempfile.TemporaryDirectory() as traceDir:
+            self.config.traceFile = os.path.join(traceDir, "jointcal.trace.json")
+            self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+            with open(self.config.traceFile) as traceFile:
+                events = json.load(traceFile)["traceEvents"]
+        self.assertFalse(lsst.jointcal.Trace.isEnabled())
+        names = {event["name"] for event in events}
+        for name in ["loadCatalog", "associateCatalog", "collectRefStars", "minimize", "derivatives",
+                     "factorize", "solve", "findOutliers", "makeSkyWcs"]:
+            self.assertIn(name, names)
+        self.assertTrue(all(event["ph"] == "X" and event["dur"] >= 0 for event in events))
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_schurComplement(self):
+        """Eliminating the star positions by Schur complement solves the same
+        system, so the fit results must not change.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.solverMode = "schurComplement"
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedAstrometry_conjugateGradient(self):
+        """Solving the normal equations iteratively to a tight tolerance must
+        not change the fit results.
+        """
+        dist_rms_relative, metrics = self.setup_jointcalTask_2_visits_constrainedAstrometry()
+        self.config.solverMode = "conjugateGradient"
+
+        self._testJointcalTask(2, dist_rms_relative, self.dist_rms_absolute, None, metrics=metrics)
+
     def setup_jointcalTask_2_visits_constrainedPhotometry(self):
         """Set default values for the constrainedPhotometry tests, and make
         the differences between each test and the defaults more obvious.
@@ -181,6 +498,14 @@ class JointcalTestCFHT(jointcalTestBase.JointcalTestBase, lsst.utils.tests.TestC
 
         self._testJointcalTask(2, None, None, pa1, metrics=metrics)
 
+    def test_jointcalTask_2_visits_constrainedPhotometry_incremental(self):
+        """Adding the second visit to the saved solution of the first one fits
+        only the new visit and the fluxes of the stars it measures.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        caller = inspect.stack()[0].function
+        self._testIncremental("photometry", "ModelVisit", "Fluxes", metrics, caller)
+
     def test_jointcalTask_2_visits_constrainedPhotometry_no_rank_update(self):
         """Demonstrate that skipping the rank update doesn't substantially affect photometry.
         """
@@ -193,6 +518,53 @@ class JointcalTestCFHT(jointcalTestBase.JointcalTestBase, lsst.utils.tests.TestC
 
         self._testJointcalTask(2, None, None, pa1, metrics=metrics)
 
+    def test_jointcalTask_2_visits_constrainedPhotometry_nThreads(self):
+        """Computing the derivatives on several threads only changes the
+        rounding of the Hessian, so the fit results must not change.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.nThreads = 3
+
+        self._testJointcalTask(2, None, None, pa1, metrics=metrics)
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_nThreads_noSplit(self):
+        """The Hessian and gradient are summed over the same chunks of
+        CcdImages whatever the number of threads: without a Hessian split in
+        one part per thread, every step is bit-identical on one thread and on
+        several.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.splitComponents = False
+        caller = inspect.stack()[0].function
+
+        minimize = lsst.jointcal.PhotometryFit.minimize
+        parameters = {}
+
+        def recordingMinimize(fit, *args, **kwargs):
+            result = minimize(fit, *args, **kwargs)
+            parameters[fit.getNThreads()].append(fit.getParameters())
+            return result
+
+        with mock.patch.object(lsst.jointcal.PhotometryFit, "minimize", recordingMinimize):
+            for nThreads in (1, 3):
+                self.config.nThreads = nThreads
+                parameters[nThreads] = []
+                self._runJointcalTask(2, caller, metrics=metrics)
+
+        self.assertGreater(len(parameters[1]), 0)
+        self.assertEqual(len(parameters[3]), len(parameters[1]))
+        for serial, threaded in zip(parameters[1], parameters[3]):
+            np.testing.assert_array_equal(threaded, serial)
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_schurComplement(self):
+        """Eliminating the star fluxes by Schur complement solves the same
+        system, so the fit results must not change.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.solverMode = "schurComplement"
+
+        self._testJointcalTask(2, None, None, pa1, metrics=metrics)
+
     def test_jointcalTask_2_visits_constrainedPhotometry_lineSearch(self):
         """Activating the line search should only slightly change the chi2.
         """
@@ -208,6 +580,151 @@ class JointcalTestCFHT(jointcalTestBase.JointcalTestBase, lsst.utils.tests.TestC
 
         self._testJointcalTask(2, None, None, pa1, metrics=metrics)
 
+    def test_jointcalTask_2_visits_constrainedPhotometry_levenbergMarquardt(self):
+        """Damping the steps of this somewhat non-linear fit changes the path
+        to the minimum, but not the minimum reached.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.levenbergMarquardtDamping = 1e-3
+        undamped = dict(metrics)
+
+        # The outliers rejected along the way may differ, hence the final chi2.
+        metrics['photometry_final_chi2'] = None
+        metrics['photometry_final_ndof'] = None
+
+        caller = inspect.stack()[0].function
+        damped = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+        # ...but the damped fit must reach the same minimum.
+        self.assertFloatsAlmostEqual(damped['photometry_final_ndof'], undamped['photometry_final_ndof'],
+                                     rtol=1e-2)
+        self.assertFloatsAlmostEqual(damped['photometry_final_chi2']/damped['photometry_final_ndof'],
+                                     undamped['photometry_final_chi2']/undamped['photometry_final_ndof'],
+                                     rtol=1e-2)
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_huber(self):
+        """Down-weighting the large residuals before rejecting outliers should
+        not degrade the photometry, and should reject fewer outliers.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        caller = inspect.stack()[0].function
+        leastSquares = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+
+        self.config.robustLoss = "huber"
+        # The minimum of the reweighted fit is not the least squares one.
+        metrics['photometry_final_chi2'] = None
+        metrics['photometry_final_ndof'] = None
+        runJointcalTask = self._runJointcalTask
+        results = []
+
+        def keepResult(*args, **kwargs):
+            results.append(runJointcalTask(*args, **kwargs))
+            return results[-1]
+
+        with mock.patch.object(self, "_runJointcalTask", keepResult):
+            self._testJointcalTask(2, None, None, pa1, metrics=metrics)
+        huber = self._getMetrics(results[0])
+        self.assertGreaterEqual(huber['photometry_final_ndof'], leastSquares['photometry_final_ndof'])
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_alternating(self):
+        """Alternating star and model fits, finished by a joint step, should
+        reach the minimum of the joint fit.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        caller = inspect.stack()[0].function
+        joint = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+
+        self.config.finalFit = "alternatingThenJoint"
+        # The outliers are rejected at different points along the way, hence the final chi2.
+        metrics['photometry_final_chi2'] = None
+        metrics['photometry_final_ndof'] = None
+        alternating = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+
+        self.assertFloatsAlmostEqual(alternating['photometry_final_ndof'], joint['photometry_final_ndof'],
+                                     rtol=1e-2)
+        reducedChi2 = {name: fit['photometry_final_chi2']/fit['photometry_final_ndof']
+                       for name, fit in (('joint', joint), ('alternating', alternating))}
+        self.assertFloatsAlmostEqual(reducedChi2['alternating'], reducedChi2['joint'], rtol=1e-2)
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_alternatingOnly(self):
+        """Alternating star and model fits, without any joint step, should
+        converge to the minimum of the joint fit.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        caller = inspect.stack()[0].function
+        joint = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+
+        self.config.finalFit = "alternating"
+        self.config.alternatingTolerance = 1e-9
+        self.config.alternatingMaxIterations = 1000
+        metrics['photometry_final_chi2'] = None
+        metrics['photometry_final_ndof'] = None
+        alternating = self._getMetrics(self._runJointcalTask(2, caller, metrics=metrics))
+
+        # The outliers may be rejected at slightly different points along the way.
+        self.assertFloatsAlmostEqual(alternating['photometry_final_ndof'], joint['photometry_final_ndof'],
+                                     rtol=1e-2)
+        reducedChi2 = {name: fit['photometry_final_chi2']/fit['photometry_final_ndof']
+                       for name, fit in (('joint', joint), ('alternating', alternating))}
+        self.assertFloatsAlmostEqual(reducedChi2['alternating'], reducedChi2['joint'], rtol=1e-2)
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_scratch(self):
+        """Once a minimize() has sized the work buffers of the fitter, the
+        following ones with the same parameters must not allocate any.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        caller = inspect.stack()[0].function
+
+        minimize = lsst.jointcal.PhotometryFit.minimize
+        allocations = []
+
+        def countingMinimize(fit, whatToFit, *args, **kwargs):
+            result = minimize(fit, whatToFit, *args, **kwargs)
+            allocations.append((whatToFit, fit.getNScratchAllocations()))
+            return result
+
+        with mock.patch.object(lsst.jointcal.PhotometryFit, "minimize", countingMinimize):
+            self._runJointcalTask(2, caller, metrics=metrics)
+
+        self.assertGreater(allocations[0][1], 0)
+        steadyState = [nAllocations for (previous, _), (whatToFit, nAllocations)
+                       in zip(allocations, allocations[1:]) if whatToFit == previous]
+        self.assertGreater(len(steadyState), 0)
+        self.assertEqual(steadyState, [0]*len(steadyState))
+
+    def test_jointcalTask_2_visits_constrainedPhotometry_rollback(self):
+        """With rollbackChi2Increase, a step of the final fit that increases
+        the chi2 is undone exactly: a step that only perturbs the parameters
+        must then leave the fit results unchanged.
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.rollbackChi2Increase = True
+
+        iterate_fit = lsst.jointcal.jointcal.JointcalTask._iterate_fit
+        minimize = lsst.jointcal.PhotometryFit.minimize
+        iterating = False
+        perturbed = []
+        restored = []
+
+        def flagIterateFit(task, *args, **kwargs):
+            nonlocal iterating
+            iterating = True
+            return iterate_fit(task, *args, **kwargs)
+
+        def perturbOnceMinimize(fit, *args, **kwargs):
+            if iterating and not perturbed:
+                perturbed.append(fit.getParameters())
+                fit.offsetParams(np.full(len(perturbed[0]), 1e-3))
+                return lsst.jointcal.MinimizeResult.Chi2Increased
+            if perturbed and not restored:
+                restored.append(fit.getParameters())
+            return minimize(fit, *args, **kwargs)
+
+        with mock.patch.object(lsst.jointcal.jointcal.JointcalTask, "_iterate_fit", flagIterateFit), \
+                mock.patch.object(lsst.jointcal.PhotometryFit, "minimize", perturbOnceMinimize):
+            self._testJointcalTask(2, None, None, pa1, metrics=metrics)
+        self.assertEqual(len(restored), 1)
+        np.testing.assert_array_equal(restored[0], perturbed[0])
+
     def test_jointcalTask_2_visits_constrainedPhotometry_flagged(self):
         """Test the use of the FlaggedSourceSelector."""
         pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
@@ -240,6 +757,33 @@ class JointcalTestCFHT(jointcalTestBase.JointcalTestBase, lsst.utils.tests.TestC
 
         self._testJointcalTask(2, None, None, pa1, metrics=metrics)
 
+    def test_jointcalTask_2_visits_constrainedMagnitude_reuseHessian(self):
+        """The Hessian of the linear constrainedMagnitude fit, and its factor,
+        are kept from one minimize() to the next with the same parameters:
+        this must factorize less often than rebuilding them at each call, for
+        the same results (the metrics of both runs are tested).
+        """
+        pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
+        self.config.photometryModel = "constrainedMagnitude"
+        metrics['photometry_final_chi2'] = 3332.76
+        caller = inspect.stack()[0].function
+
+        result = self._runJointcalTask(2, caller, metrics=metrics)
+        reused = result.resultList[0].result.stageMetrics['photometry_fit']
+
+        minimize = lsst.jointcal.PhotometryFit.minimize
+
+        def minimizeWithoutReuse(fit, *args, **kwargs):
+            # Setting a solver option drops the kept Hessian.
+            fit.setOrdering(fit.getOrdering())
+            return minimize(fit, *args, **kwargs)
+
+        with mock.patch.object(lsst.jointcal.PhotometryFit, "minimize", minimizeWithoutReuse):
+            result = self._runJointcalTask(2, caller, metrics=metrics)
+        rebuilt = result.resultList[0].result.stageMetrics['photometry_fit']
+
+        self.assertLess(reused.nFactorizations, rebuilt.nFactorizations)
+
     def test_jointcalTask_2_visits_constrainedFlux_pedestal(self):
         pa1, metrics = self.setup_jointcalTask_2_visits_constrainedPhotometry()
         self.config.photometryErrorPedestal = 0.02
@@ -33,6 +33,7 @@ import lsst.afw.table
 import lsst.afw.image
 import lsst.afw.image.utils
 import lsst.daf.persistence
+import lsst.pex.exceptions
 import lsst.jointcal.ccdImage
 import lsst.jointcal.photometryModels
 import lsst.jointcal.star
@@ -279,6 +280,21 @@ class ConstrainedPhotometryModelTestCase(PhotometryModelTestBase):
             # almost equal because log() may have been involved in the math
             self.assertFloatsAlmostEqual(result, expect, msg=ccdImage.getName())
 
+    def test_setChipParameters(self):
+        """setChipParameters should set every chip, and raise if one is
+        missing.
+        """
+        chipParameters = self.model2.getChipParameters()
+        self.assertEqual(len(chipParameters), 2)
+        shifted = {ccd: parameters*1.1 for ccd, parameters in chipParameters.items()}
+        self.assertEqual(self.model2.setChipParameters(shifted), 2)
+        for ccd, parameters in self.model2.getChipParameters().items():
+            self.assertFloatsAlmostEqual(parameters, shifted[ccd], msg=str(ccd))
+
+        del shifted[12]
+        with self.assertRaises(lsst.pex.exceptions.InvalidParameterError):
+            self.model2.setChipParameters(shifted)
+
     def test_photoCalibMean(self):
         """The mean of the photoCalib should match the mean over a calibrated image."""
         image = lsst.afw.image.MaskedImageF(self.ccdImageList[0].getDetector().getBBox())
@@ -89,6 +89,11 @@ class SpatiallyInvariantTestBase(PhotometryTransformTestBase):
         self.assertEqual(self.transform2.getParameters(), clone2.getParameters())
         self.assertNotEqual(clone1.getParameters(), clone2.getParameters())
 
+    def test_setParameters(self):
+        parameters = self.transform2.getParameters()
+        self.transform1.setParameters(parameters)
+        self.assertEqual(self.transform1.getParameters(), parameters)
+
     def _test_computeParameterDerivatives(self, expect):
         """The derivative of a spatially invariant transform is always the same.
         Should be indepdendent of position
@@ -221,6 +226,12 @@ class PhotometryTransformChebyshevTestCase(PhotometryTransformTestBase, abc.ABC)
         self.assertEqual(self.transform2.getOrder(), clone2.getOrder())
         self.assertEqual(self.transform2.getBBox(), clone2.getBBox())
 
+    def test_setParameters(self):
+        parameters = self.transform1.getParameters()
+        self.transform1.offsetParams(self.delta)
+        self.transform1.setParameters(parameters)
+        self.assertFloatsEqual(self.transform1.getParameters(), parameters)
+
     @abc.abstractmethod
     def _computeChebyshevDerivative(self, Tx, Ty, value):
         """Return the derivative of chebyshev component Tx, Ty."""
@@ -0,0 +1,68 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_problemSize
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include "Eigen/Core"
+
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/FitterBase.h"
+
+namespace jointcal = lsst::jointcal;
+
+BOOST_AUTO_TEST_SUITE(test_problemSize)
+
+/* The memory estimates are those of the storage of the Jacobian, Hessian and factor. */
+BOOST_AUTO_TEST_CASE(test_bytes) {
+    jointcal::ProblemSize problemSize;
+    BOOST_CHECK_EQUAL(problemSize.getJacobianBytes(), 0u);
+    BOOST_CHECK_EQUAL(problemSize.getFactorBytes(), 0u);
+
+    Eigen::MatrixXd dense = Eigen::MatrixXd::Identity(5, 5);
+    dense(3, 1) = dense(4, 0) = 1;
+    SparseMatrixD lower = dense.sparseView();
+    lower.makeCompressed();
+    problemSize.nParameters = lower.cols();
+    problemSize.nHessianNonZeros = lower.nonZeros();
+    std::size_t const storageBytes =
+            lower.nonZeros() * (sizeof(double) + sizeof(SparseMatrixD::StorageIndex)) +
+            (lower.outerSize() + 1) * sizeof(SparseMatrixD::StorageIndex);
+    BOOST_CHECK_EQUAL(problemSize.getHessianBytes(), storageBytes);
+
+    jointcal::TripletList jacobian(0);
+    for (unsigned col = 0; col < 7; ++col) jacobian.addTriplet(col % 5, col, 1.);
+    problemSize.nJacobianNonZeros = jacobian.size();
+    BOOST_CHECK_EQUAL(problemSize.getJacobianBytes(), jacobian.size() * sizeof(jointcal::Trip));
+
+    problemSize.nFactorNonZeros = 9;
+    std::size_t const factorBytes = 9 * (sizeof(double) + sizeof(SparseMatrixD::StorageIndex));
+    BOOST_CHECK_EQUAL(problemSize.getFactorBytes(), factorBytes);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,147 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_schurComplement
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "Eigen/Cholesky"
+#include "Eigen/Core"
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/jointcal/Eigenstuff.h"
+#include "lsst/jointcal/SchurComplement.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+// 3 model parameters, then the 2 position parameters of each star, then 3 more model parameters.
+unsigned const nStars = 12;
+unsigned const nParTot = 3 + 2 * nStars + 3;
+
+std::vector<std::pair<unsigned, unsigned>> makeStarBlocks() {
+    std::vector<std::pair<unsigned, unsigned>> blocks;
+    for (unsigned star = 0; star < nStars; ++star) blocks.emplace_back(3 + 2 * star, 2);
+    return blocks;
+}
+
+/*
+ * The dense Hessian J*J^T of measurements that each involve one star and a few model parameters, plus a
+ * reference term per star: the stars are coupled to the model, but not to each other.
+ */
+Eigen::MatrixXd makeHessian(unsigned seed) {
+    std::mt19937 generator(seed);
+    std::uniform_real_distribution<double> value(-1, 1);
+    std::uniform_int_distribution<unsigned> model(0, 5);
+    unsigned const nColumns = 5 * nStars + nStars;
+    Eigen::MatrixXd jacobian = Eigen::MatrixXd::Zero(nParTot, nColumns);
+    unsigned col = 0;
+    for (unsigned star = 0; star < nStars; ++star) {
+        for (unsigned measurement = 0; measurement < 5; ++measurement, ++col) {
+            for (unsigned k = 0; k < 2; ++k) {
+                unsigned const index = model(generator);
+                jacobian(index < 3 ? index : nParTot - 6 + index, col) = value(generator);
+            }
+            jacobian(3 + 2 * star, col) = value(generator);
+            jacobian(3 + 2 * star + 1, col) = value(generator);
+        }
+        jacobian(3 + 2 * star, col) = 1;
+        jacobian(3 + 2 * star + 1, col++) = 1;
+    }
+    return jacobian * jacobian.transpose() + 0.1 * Eigen::MatrixXd::Identity(nParTot, nParTot);
+}
+
+SparseMatrixD lowerTriangle(Eigen::MatrixXd const &dense) {
+    SparseMatrixD lower = dense.sparseView();
+    lower = lower.triangularView<Eigen::Lower>();
+    lower.makeCompressed();
+    return lower;
+}
+
+Eigen::MatrixXd denseFromLower(SparseMatrixD const &lower) {
+    Eigen::MatrixXd dense(lower);
+    return dense.selfadjointView<Eigen::Lower>();
+}
+
+void checkClose(Eigen::MatrixXd const &result, Eigen::MatrixXd const &expect) {
+    BOOST_CHECK_SMALL((result - expect).lpNorm<Eigen::Infinity>(), 1e-10 * expect.lpNorm<Eigen::Infinity>());
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_schurComplement)
+
+/* The reduced matrix is the dense Schur complement of the star blocks. */
+BOOST_AUTO_TEST_CASE(test_reducedMatrix) {
+    Eigen::MatrixXd hessian = makeHessian(1);
+    std::vector<unsigned> model = {0, 1, 2, nParTot - 3, nParTot - 2, nParTot - 1};
+    std::vector<unsigned> stars;
+    for (unsigned i = 3; i < nParTot - 3; ++i) stars.push_back(i);
+    Eigen::MatrixXd hMM = hessian(model, model);
+    Eigen::MatrixXd hMS = hessian(model, stars);
+    Eigen::MatrixXd hSS = hessian(stars, stars);
+    Eigen::MatrixXd expect = hMM - hMS * hSS.ldlt().solve(hMS.transpose());
+
+    jointcal::SchurComplement schur;
+    schur.setBlocks(nParTot, makeStarBlocks());
+    BOOST_CHECK_EQUAL(schur.getNParReduced(), model.size());
+    SparseMatrixD reduced;
+    BOOST_REQUIRE(schur.compute(lowerTriangle(hessian), 1, reduced));
+    checkClose(denseFromLower(reduced), expect);
+}
+
+/* Solving the reduced system and back-substituting gives the solution of the full system. */
+BOOST_AUTO_TEST_CASE(test_solve) {
+    Eigen::MatrixXd hessian = makeHessian(2);
+    Eigen::VectorXd grad = Eigen::VectorXd::LinSpaced(nParTot, -1, 2);
+    Eigen::VectorXd expect = hessian.ldlt().solve(grad);
+
+    jointcal::SchurComplement schur;
+    schur.setBlocks(nParTot, makeStarBlocks());
+    for (unsigned nThreads : {1, 3}) {
+        SparseMatrixD reduced;
+        BOOST_REQUIRE(schur.compute(lowerTriangle(hessian), nThreads, reduced));
+        Eigen::VectorXd reducedDelta = denseFromLower(reduced).ldlt().solve(schur.reduceGradient(grad));
+        checkClose(schur.backSubstitute(grad, reducedDelta), expect);
+    }
+}
+
+/* Blocks that the Hessian couples cannot be eliminated independently. */
+BOOST_AUTO_TEST_CASE(test_coupledBlocks) {
+    Eigen::MatrixXd hessian = makeHessian(3);
+    hessian(5, 3) = hessian(3, 5) = 0.5;  // couples the first two stars
+
+    jointcal::SchurComplement schur;
+    schur.setBlocks(nParTot, makeStarBlocks());
+    SparseMatrixD reduced;
+    BOOST_CHECK_THROW(schur.compute(lowerTriangle(hessian), 1, reduced), lsst::pex::exceptions::LogicError);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,53 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_stageMetrics
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <chrono>
+#include <thread>
+
+#include "lsst/jointcal/StageMetrics.h"
+
+namespace jointcal = lsst::jointcal;
+
+BOOST_AUTO_TEST_SUITE(test_stageMetrics)
+
+/* A StageTimer counts its call and the wall time of its scope. */
+BOOST_AUTO_TEST_CASE(test_stageTimer) {
+    jointcal::StageMetrics metrics;
+    for (int i = 0; i < 2; ++i) {
+        jointcal::StageTimer timer(metrics);
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    BOOST_CHECK_EQUAL(metrics.nCalls, 2u);
+    BOOST_CHECK_GE(metrics.wallSeconds, 0.02);
+    BOOST_CHECK_GE(metrics.cpuSeconds, 0.);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
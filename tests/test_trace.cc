@@ -0,0 +1,94 @@
+// -*- LSST-C++ -*-
+/*
+ * This file is part of jointcal.
+ *
+ * Developed for the LSST Data Management System.
+ * This product includes software developed by the LSST Project
+ * (https://www.lsst.org).
+ * See the COPYRIGHT file at the top-level directory of this distribution
+ * for details of code ownership.
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <https://www.gnu.org/licenses/>.
+ */
+
+#define BOOST_TEST_DYN_LINK
+
+#define BOOST_TEST_MODULE test_trace
+
+// The boost unit test header
+#include "boost/test/unit_test.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+#include "lsst/pex/exceptions.h"
+#include "lsst/jointcal/Trace.h"
+
+namespace jointcal = lsst::jointcal;
+
+namespace {
+/// Stop the trace into a file, and return its content.
+std::string stopAndRead() {
+    std::string const path = "test_trace.json";
+    jointcal::Trace::stop(path);
+    std::ifstream in(path);
+    std::stringstream content;
+    content << in.rdbuf();
+    std::remove(path.c_str());
+    return content.str();
+}
+
+std::size_t count(std::string const &text, std::string const &pattern) {
+    std::size_t n = 0;
+    for (auto pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1)) ++n;
+    return n;
+}
+}  // namespace
+
+BOOST_AUTO_TEST_SUITE(test_trace)
+
+/* Only the spans opened while recording are written, with their details escaped. */
+BOOST_AUTO_TEST_CASE(test_spans) {
+    { JOINTCAL_TRACE_SPAN("beforeStart"); }
+    jointcal::Trace::start();
+    BOOST_CHECK(jointcal::Trace::isEnabled());
+    { JOINTCAL_TRACE_SPAN("plain"); }
+    for (int i = 0; i < 2; ++i) {
+        JOINTCAL_TRACE_SPAN_DETAIL("detailed", "ccd \"" + std::to_string(i) + "\"");
+    }
+    std::string content = stopAndRead();
+    BOOST_CHECK(!jointcal::Trace::isEnabled());
+
+    BOOST_CHECK_EQUAL(count(content, "\"ph\": \"X\""), 3u);
+    BOOST_CHECK_EQUAL(count(content, "beforeStart"), 0u);
+    BOOST_CHECK_EQUAL(count(content, "\"name\": \"plain\""), 1u);
+    BOOST_CHECK_EQUAL(count(content, "\"args\": {\"detail\": \"ccd \\\"1\\\"\"}"), 1u);
+
+    // nothing is recorded once stopped, nor kept from the last recording.
+    { JOINTCAL_TRACE_SPAN("afterStop"); }
+    jointcal::Trace::start();
+    BOOST_CHECK_EQUAL(count(stopAndRead(), "\"ph\": \"X\""), 0u);
+}
+
+/* A trace that cannot be written raises. */
+BOOST_AUTO_TEST_CASE(test_unwritable) {
+    jointcal::Trace::start();
+    BOOST_CHECK_THROW(jointcal::Trace::stop("/nonexistent/directory/trace.json"),
+                      lsst::pex::exceptions::IoError);
+    BOOST_CHECK(!jointcal::Trace::isEnabled());
+}
+
+BOOST_AUTO_TEST_SUITE_END()